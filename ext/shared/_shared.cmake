@@ -10,6 +10,11 @@ set(SOURCEPP_USE_VPKPP          ON  CACHE INTERNAL "" FORCE)
 set(SOURCEPP_USE_VTFPP          ON  CACHE INTERNAL "" FORCE)
 add_subdirectory("${CMAKE_CURRENT_LIST_DIR}/sourcepp")
 
+# xxHash (header-only, used for Respawn VPK content hashing)
+add_library(xxhash INTERFACE)
+add_library(xxhash::xxhash ALIAS xxhash)
+target_include_directories(xxhash INTERFACE "${CMAKE_CURRENT_LIST_DIR}/xxhash")
+
 # lzham (used for Respawn VPK compression)
 # We vendor headers + a prebuilt lib from `.tmp/TFVPKTool-main` into `ext/shared/lzham`.
 set(_VPKEDIT_LZHAM_HEADER "${CMAKE_CURRENT_LIST_DIR}/lzham/include/lzham.h")
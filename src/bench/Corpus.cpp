@@ -0,0 +1,172 @@
+// ReSharper disable CppRedundantQualifier
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+
+#include <argparse/argparse.hpp>
+
+#include <Config.h>
+
+#include "../shared/RespawnVPKPack.h"
+
+#define ARG_L(name, long_) \
+	constexpr std::string_view ARG_##name##_LONG  = long_
+
+ARG_L(SEED,           "--seed");
+ARG_L(ENTRIES,        "--entries");
+ARG_L(DEPTH,          "--depth");
+ARG_L(MEAN_SIZE,      "--mean-size");
+ARG_L(MAX_SIZE,       "--max-size");
+ARG_L(COMPRESSIBLE,   "--compressible");
+ARG_L(DUPLICATES,     "--duplicates");
+ARG_L(WAVS,           "--wavs");
+ARG_L(PRELOAD,        "--preload");
+ARG_L(MAX_PRELOAD,    "--max-preload");
+ARG_L(ARCHIVE_SIZE,   "--archive-size");
+ARG_L(PART_SIZE,      "--part-size");
+ARG_L(NO_COMPRESS,    "--no-compress");
+ARG_L(THREADS,        "--threads");
+
+#define ARG_P(name) ARG_##name##_LONG
+
+namespace {
+
+class vpkedit_corpus_error : public std::runtime_error { public: using runtime_error::runtime_error; };
+
+[[nodiscard]] double getRatio(const argparse::ArgumentParser& cli, std::string_view name) {
+	return std::clamp(std::stod(cli.get(name)), 0.0, 1.0);
+}
+
+} // namespace
+
+int main(int argc, const char* const* argv) {
+	argparse::ArgumentParser cli{std::string{PROJECT_NAME} + "_corpus", PROJECT_VERSION_PRETTY.data(), argparse::default_arguments::help};
+
+	cli.add_description("Generates a Respawn VPK with made-up contents for tests and benchmarks, so no game files are\n"
+	                    "needed. The same seed and options always generate the same archives. Entries are written\n"
+	                    "straight into the pack: deep directory trees, lognormal file sizes, multi-part files,\n"
+	                    "preload bytes, .wav files with .cam records and duplicated contents for dedup.");
+
+	cli.add_argument("path")
+		.help("The _dir.vpk to write, its archives are written next to it.")
+		.required();
+
+	cli.add_argument(ARG_P(SEED))
+		.help("Seed everything is generated from.")
+		.default_value("1")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(ENTRIES))
+		.help("Number of entries in the pack.")
+		.default_value("10000")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(DEPTH))
+		.help("Deepest directory nesting.")
+		.default_value("8")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(MEAN_SIZE))
+		.help("Mean file size in bytes.")
+		.default_value("16384")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(MAX_SIZE))
+		.help("Largest file size in bytes, sizes drawn above it are clamped.")
+		.default_value("67108864")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(COMPRESSIBLE))
+		.help("Fraction (0 to 1) of files with compressible contents, the rest are random bytes.")
+		.default_value("0.7")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(DUPLICATES))
+		.help("Fraction (0 to 1) of files that repeat the contents of an earlier file.")
+		.default_value("0.05")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(WAVS))
+		.help("Fraction (0 to 1) of files that are .wav sounds.")
+		.default_value("0.02")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(PRELOAD))
+		.help("Fraction (0 to 1) of files with preload bytes in the dir tree.")
+		.default_value("0.05")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(MAX_PRELOAD))
+		.help("Most preload bytes a file can have.")
+		.default_value("1024")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(ARCHIVE_SIZE))
+		.help("Start a new archive (_000.vpk, _001.vpk, ...) once one reaches this many bytes. If unspecified,\n"
+		      "everything goes into a single _999.vpk archive.")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(PART_SIZE))
+		.help("Largest part in bytes, larger files are split into several parts.")
+		.default_value("1048576")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(NO_COMPRESS))
+		.help("Store every part uncompressed.")
+		.flag();
+
+	cli.add_argument(ARG_P(THREADS))
+		.help("Worker threads used to encode the entries (0 = one per hardware thread).")
+		.default_value("0")
+		.nargs(1);
+
+	try {
+		cli.parse_args(argc, argv);
+
+		respawn_vpk::SyntheticPackOptions options;
+		options.seed = std::stoull(cli.get(ARG_P(SEED)));
+		options.entryCount = std::stoull(cli.get(ARG_P(ENTRIES)));
+		options.maxDirectoryDepth = static_cast<std::uint32_t>(std::max<unsigned long long>(std::stoull(cli.get(ARG_P(DEPTH))), 1));
+		options.meanFileSize = std::stoull(cli.get(ARG_P(MEAN_SIZE)));
+		options.maxFileSize = std::stoull(cli.get(ARG_P(MAX_SIZE)));
+		options.compressibleRatio = getRatio(cli, ARG_P(COMPRESSIBLE));
+		options.duplicateRatio = getRatio(cli, ARG_P(DUPLICATES));
+		options.wavRatio = getRatio(cli, ARG_P(WAVS));
+		options.preloadRatio = getRatio(cli, ARG_P(PRELOAD));
+		options.maxPreloadBytes = static_cast<std::uint16_t>(std::min<unsigned long long>(std::stoull(cli.get(ARG_P(MAX_PRELOAD))), std::numeric_limits<std::uint16_t>::max()));
+
+		respawn_vpk::PackOptions packOptions;
+		if (cli.is_used(ARG_P(ARCHIVE_SIZE))) {
+			packOptions.archiveIndex = 0;
+			packOptions.maxArchiveBytes = std::stoull(cli.get(ARG_P(ARCHIVE_SIZE)));
+		}
+		packOptions.maxPartSize = std::max<std::size_t>(std::stoull(cli.get(ARG_P(PART_SIZE))), 1);
+		if (cli.get<bool>(ARG_P(NO_COMPRESS))) {
+			packOptions.compressionThreshold = std::numeric_limits<std::size_t>::max();
+		}
+		packOptions.threadCount = static_cast<std::size_t>(std::stoull(cli.get(ARG_P(THREADS))));
+
+		const auto outputPath = cli.get("path");
+		if (const auto parent = std::filesystem::path{outputPath}.parent_path(); !parent.empty()) {
+			std::filesystem::create_directories(parent);
+		}
+
+		std::string error;
+		respawn_vpk::PackStats stats;
+		const auto start = std::chrono::steady_clock::now();
+		if (!respawn_vpk::generateSyntheticRespawnVPK(outputPath, options, packOptions, &error, &stats)) {
+			throw vpkedit_corpus_error{"Failed to generate the pack: " + error};
+		}
+		const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Generated " << options.entryCount << " entries in \"" << outputPath << "\" in " << seconds << " s" << std::endl;
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,864 @@
+// ReSharper disable CppRedundantQualifier
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include <argparse/argparse.hpp>
+#include <sourcepp/crypto/CRC32.h>
+#include <vpkpp/vpkpp.h>
+
+#include <Config.h>
+
+#include "../shared/RespawnVPKHash.h"
+#include "../shared/RespawnVPKPack.h"
+#include "../shared/RespawnVPK.h"
+
+using namespace std::literals::string_literals;
+
+#define ARG_L(name, long_) \
+	constexpr std::string_view ARG_##name##_LONG  = long_
+
+ARG_L(OUT,            "--out");
+ARG_L(WORK_DIR,       "--work-dir");
+ARG_L(KEEP_FILES,     "--keep-files");
+ARG_L(FILTER,         "--filter");
+ARG_L(REPETITIONS,    "--repetitions");
+ARG_L(SEED,           "--seed");
+ARG_L(ENTRIES,        "--entries");
+ARG_L(SIZE_DIST,      "--size-dist");
+ARG_L(MEAN_SIZE,      "--mean-size");
+ARG_L(MAX_SIZE,       "--max-size");
+ARG_L(COMPRESSIBLE,   "--compressible");
+ARG_L(THREADS,        "--threads");
+ARG_L(RANDOM_READS,   "--random-reads");
+ARG_L(BAKE_FILES,     "--bake-files");
+ARG_L(SOURCE,         "--source");
+ARG_L(BASELINE,       "--baseline");
+ARG_L(TOLERANCE,      "--tolerance");
+ARG_L(WRITE_BASELINE, "--write-baseline");
+
+#define ARG_P(name) ARG_##name##_LONG
+
+namespace {
+
+class vpkedit_bench_error : public std::runtime_error { public: using runtime_error::runtime_error; };
+
+enum class SizeDistribution {
+	FIXED,
+	UNIFORM,
+	LOGNORMAL,
+};
+
+struct CorpusOptions {
+	// Synthetic corpora are packed straight from generated data with generateSyntheticRespawnVPK, nothing is written
+	// to the input directory; they are much quicker to set up for large entry counts
+	bool synthetic = false;
+	std::uint64_t seed = 0;
+	std::size_t entryCount = 0;
+	SizeDistribution sizeDistribution = SizeDistribution::LOGNORMAL;
+	std::uint64_t meanSize = 0;
+	std::uint64_t maxSize = 0;
+	// Fraction of files filled with text-like data, the rest get random bytes that do not compress
+	double compressibleRatio = 0.0;
+};
+
+struct CorpusFile {
+	std::string path;
+	std::uint64_t size = 0;
+};
+
+struct Timing {
+	double realSeconds = 0.0;
+	// CPU time of the whole process, so it includes worker threads
+	double cpuSeconds = 0.0;
+};
+
+// Timings of one benchmark, one per repetition
+struct BenchResult {
+	std::string name;
+	std::vector<Timing> timings;
+	// Work done by a single repetition, used for the throughput counters
+	std::uint64_t bytes = 0;
+	std::uint64_t items = 0;
+};
+
+// Expected throughput of one benchmark, see readBaselines
+struct Baseline {
+	std::string name;
+	// bytes_per_second or items_per_second
+	std::string metric;
+	double value = 0.0;
+	// Allowed slowdown as a fraction of value, negative to use --tolerance
+	double tolerance = -1.0;
+};
+
+// Fast and good enough for filling files, seeded per file so the corpus does not depend on generation order
+[[nodiscard]] std::uint64_t splitmix64(std::uint64_t& state) {
+	std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1); the standard distributions are not guaranteed to give the same values with every standard library
+[[nodiscard]] double uniform01(std::uint64_t& state) {
+	return static_cast<double>(splitmix64(state) >> 11) * 0x1.0p-53;
+}
+
+[[nodiscard]] std::uint64_t pickFileSize(const CorpusOptions& options, std::uint64_t& state) {
+	double size = 0.0;
+	switch (options.sizeDistribution) {
+		case SizeDistribution::FIXED:
+			size = static_cast<double>(options.meanSize);
+			break;
+		case SizeDistribution::UNIFORM:
+			size = 1.0 + uniform01(state) * (2.0 * static_cast<double>(options.meanSize) - 1.0);
+			break;
+		case SizeDistribution::LOGNORMAL: {
+			// Most game files are small with a long tail of large ones; pick mu so the mean is meanSize
+			constexpr double SIGMA = 1.5;
+			const double mu = std::log(static_cast<double>(options.meanSize)) - SIGMA * SIGMA / 2.0;
+			// Box-Muller, like generateSyntheticRespawnVPK
+			const double normal = std::sqrt(-2.0 * std::log(1.0 - uniform01(state))) * std::cos(2.0 * 3.14159265358979323846 * uniform01(state));
+			size = std::exp(mu + SIGMA * normal);
+			break;
+		}
+	}
+	return std::clamp<std::uint64_t>(static_cast<std::uint64_t>(size), 1, options.maxSize);
+}
+
+[[nodiscard]] std::vector<std::byte> makeFileContents(std::uint64_t seed, std::uint64_t size, bool compressible) {
+	static constexpr std::string_view WORDS[] = {
+		"vertex ", "normal ", "texcoord ", "material ", "\"$basetexture\" ", "model ", "origin ", "angles ",
+		"0.000000 ", "1.000000 ", "-1.000000 ", "{\n", "}\n", "\t", "weapon_", "script ",
+	};
+	std::vector<std::byte> out(static_cast<std::size_t>(size));
+	std::uint64_t state = seed;
+	if (compressible) {
+		for (std::size_t i = 0; i < out.size(); ) {
+			const auto word = WORDS[splitmix64(state) % std::size(WORDS)];
+			const auto n = std::min(word.size(), out.size() - i);
+			std::memcpy(out.data() + i, word.data(), n);
+			i += n;
+		}
+	} else {
+		for (std::size_t i = 0; i < out.size(); i += sizeof(std::uint64_t)) {
+			const auto v = splitmix64(state);
+			std::memcpy(out.data() + i, &v, std::min(sizeof(v), out.size() - i));
+		}
+	}
+	return out;
+}
+
+[[nodiscard]] std::uint64_t fileSeed(std::uint64_t corpusSeed, std::size_t index) {
+	std::uint64_t state = corpusSeed ^ (static_cast<std::uint64_t>(index) * 0xD1B54A32D192ED03ull);
+	return splitmix64(state);
+}
+
+// Writes a directory tree of entryCount files under root; the same options always produce the same files, whatever the
+// platform or standard library
+[[nodiscard]] std::vector<CorpusFile> generateCorpus(const CorpusOptions& options, const std::filesystem::path& root) {
+	static constexpr std::string_view DIRS[] = {
+		"models", "materials", "sound", "scripts", "maps", "resource",
+		"props", "weapons", "characters", "vehicles", "ui", "effects",
+	};
+	static constexpr std::string_view EXTENSIONS[] = {
+		".mdl", ".vtx", ".vvd", ".phy", ".vmt", ".vtf", ".nut", ".txt", ".cfg", ".rson", ".bin",
+	};
+
+	std::uint64_t rng = options.seed;
+	std::vector<CorpusFile> files;
+	files.reserve(options.entryCount);
+	for (std::size_t i = 0; i < options.entryCount; i++) {
+		std::string path;
+		const auto depth = 1 + splitmix64(rng) % 4;
+		for (std::uint64_t d = 0; d < depth; d++) {
+			path += DIRS[splitmix64(rng) % std::size(DIRS)];
+			path += '_' + std::to_string(splitmix64(rng) % 8) + '/';
+		}
+		path += "file_" + std::to_string(i);
+		path += EXTENSIONS[splitmix64(rng) % std::size(EXTENSIONS)];
+
+		const auto size = pickFileSize(options, rng);
+		const bool compressible = uniform01(rng) < options.compressibleRatio;
+		const auto contents = makeFileContents(fileSeed(options.seed, i), size, compressible);
+
+		const auto fullPath = root / path;
+		std::filesystem::create_directories(fullPath.parent_path());
+		std::ofstream f{fullPath, std::ios::binary | std::ios::trunc};
+		f.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+		if (!f) {
+			throw vpkedit_bench_error{"Failed to write corpus file \"" + fullPath.string() + "\""};
+		}
+		files.push_back({std::move(path), size});
+	}
+	return files;
+}
+
+[[nodiscard]] std::unique_ptr<vpkpp::PackFile> openRespawnVPK(const std::string& dirVpkPath) {
+	auto packFile = RespawnVPK::open(dirVpkPath);
+	if (!packFile) {
+		throw vpkedit_bench_error{"Could not open the packed Respawn VPK at \"" + dirVpkPath + "\""};
+	}
+	return packFile;
+}
+
+template<typename F>
+[[nodiscard]] Timing measure(F&& f) {
+	const auto cpuStart = std::clock();
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	const auto realSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return {realSeconds, static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC};
+}
+
+[[nodiscard]] std::string escapeJson(std::string_view s) {
+	std::string out;
+	out.reserve(s.size());
+	for (const char c : s) {
+		switch (c) {
+			case '"':  out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n";  break;
+			case '\t': out += "\\t";  break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					std::ostringstream hex;
+					hex << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+					out += hex.str();
+				} else {
+					out += c;
+				}
+				break;
+		}
+	}
+	return out;
+}
+
+[[nodiscard]] std::string_view sizeDistributionName(SizeDistribution distribution) {
+	switch (distribution) {
+		case SizeDistribution::FIXED:     return "fixed";
+		case SizeDistribution::UNIFORM:   return "uniform";
+		case SizeDistribution::LOGNORMAL: return "lognormal";
+	}
+	return "";
+}
+
+void writeRunJson(std::ostream& out, const BenchResult& result, std::string_view name, std::string_view runType, std::string_view aggregateName, const Timing& timing, std::size_t repetitionIndex, bool first) {
+	const double seconds = timing.realSeconds;
+	out << (first ? "" : ",\n") << "    {\n"
+	    << "      \"name\": \"" << escapeJson(name) << "\",\n"
+	    << "      \"run_name\": \"" << escapeJson(result.name) << "\",\n"
+	    << "      \"run_type\": \"" << runType << "\",\n"
+	    << "      \"repetitions\": " << result.timings.size() << ",\n";
+	if (runType == "aggregate") {
+		out << "      \"aggregate_name\": \"" << aggregateName << "\",\n";
+	} else {
+		out << "      \"repetition_index\": " << repetitionIndex << ",\n";
+	}
+	out << "      \"iterations\": 1,\n"
+	    << "      \"real_time\": " << timing.realSeconds * 1000.0 << ",\n"
+	    << "      \"cpu_time\": " << timing.cpuSeconds * 1000.0 << ",\n"
+	    << "      \"time_unit\": \"ms\"";
+	// A throughput of the standard deviation means nothing
+	if (aggregateName == "stddev") {
+		out << "\n    }";
+		return;
+	}
+	if (result.bytes && seconds > 0.0) {
+		out << ",\n      \"bytes_per_second\": " << static_cast<double>(result.bytes) / seconds;
+	}
+	if (result.items && seconds > 0.0) {
+		out << ",\n      \"items_per_second\": " << static_cast<double>(result.items) / seconds;
+	}
+	out << "\n    }";
+}
+
+// Same layout as Google Benchmark's --benchmark_format=json, so its compare.py and other tooling can read it
+void writeResultsJson(std::ostream& out, const std::vector<BenchResult>& results, const CorpusOptions& corpus, std::uint64_t corpusBytes, const char* executable) {
+	const auto now = std::time(nullptr);
+	std::tm localTime{};
+#ifdef _WIN32
+	localtime_s(&localTime, &now);
+#else
+	localtime_r(&now, &localTime);
+#endif
+
+	out << std::setprecision(10);
+	out << "{\n"
+	    << "  \"context\": {\n"
+	    << "    \"date\": \"" << std::put_time(&localTime, "%Y-%m-%dT%H:%M:%S%z") << "\",\n"
+	    << "    \"executable\": \"" << escapeJson(executable) << "\",\n"
+	    << "    \"version\": \"" << escapeJson(PROJECT_VERSION_PRETTY) << "\",\n"
+	    << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+#ifdef NDEBUG
+	    << "    \"library_build_type\": \"release\",\n"
+#else
+	    << "    \"library_build_type\": \"debug\",\n"
+#endif
+#ifdef VPKEDIT_HAVE_LZHAM
+	    << "    \"lzham\": true,\n"
+#else
+	    << "    \"lzham\": false,\n"
+#endif
+	    << "    \"corpus_source\": \"" << (corpus.synthetic ? "synthetic" : "disk") << "\",\n"
+	    << "    \"corpus_seed\": " << corpus.seed << ",\n"
+	    << "    \"corpus_entries\": " << corpus.entryCount << ",\n"
+	    << "    \"corpus_bytes\": " << corpusBytes << ",\n"
+	    << "    \"corpus_size_distribution\": \"" << sizeDistributionName(corpus.sizeDistribution) << "\",\n"
+	    << "    \"corpus_mean_size\": " << corpus.meanSize << ",\n"
+	    << "    \"corpus_max_size\": " << corpus.maxSize << ",\n"
+	    << "    \"corpus_compressible\": " << corpus.compressibleRatio << "\n"
+	    << "  },\n"
+	    << "  \"benchmarks\": [\n";
+
+	bool first = true;
+	for (const auto& result : results) {
+		for (std::size_t i = 0; i < result.timings.size(); i++) {
+			writeRunJson(out, result, result.name, "iteration", "", result.timings[i], i, first);
+			first = false;
+		}
+		if (result.timings.size() < 2) {
+			continue;
+		}
+		auto aggregate = [&result](double Timing::* member) {
+			std::vector<double> values;
+			for (const auto& timing : result.timings) {
+				values.push_back(timing.*member);
+			}
+			std::sort(values.begin(), values.end());
+			const auto n = static_cast<double>(values.size());
+			const double mean = std::accumulate(values.begin(), values.end(), 0.0) / n;
+			const double median = values.size() % 2 ? values[values.size() / 2] : (values[values.size() / 2 - 1] + values[values.size() / 2]) / 2.0;
+			double variance = 0.0;
+			for (const auto v : values) {
+				variance += (v - mean) * (v - mean);
+			}
+			return std::array<double, 3>{mean, median, std::sqrt(variance / (n - 1.0))};
+		};
+		const auto real = aggregate(&Timing::realSeconds);
+		const auto cpu = aggregate(&Timing::cpuSeconds);
+		writeRunJson(out, result, result.name + "_mean", "aggregate", "mean", {real[0], cpu[0]}, 0, false);
+		writeRunJson(out, result, result.name + "_median", "aggregate", "median", {real[1], cpu[1]}, 0, false);
+		writeRunJson(out, result, result.name + "_stddev", "aggregate", "stddev", {real[2], cpu[2]}, 0, false);
+	}
+	out << "\n  ]\n}\n";
+}
+
+[[nodiscard]] double medianSeconds(const BenchResult& result) {
+	std::vector<double> values;
+	for (const auto& timing : result.timings) {
+		values.push_back(timing.realSeconds);
+	}
+	std::sort(values.begin(), values.end());
+	return values.size() % 2 ? values[values.size() / 2] : (values[values.size() / 2 - 1] + values[values.size() / 2]) / 2.0;
+}
+
+[[nodiscard]] std::optional<double> getThroughput(const BenchResult& result, std::string_view metric) {
+	const auto seconds = medianSeconds(result);
+	if (seconds <= 0.0) {
+		return std::nullopt;
+	}
+	if (metric == "bytes_per_second" && result.bytes) {
+		return static_cast<double>(result.bytes) / seconds;
+	}
+	if (metric == "items_per_second" && result.items) {
+		return static_cast<double>(result.items) / seconds;
+	}
+	return std::nullopt;
+}
+
+// One "<benchmark> <metric> <value> [tolerance]" per line, # starts a comment
+[[nodiscard]] std::vector<Baseline> readBaselines(const std::string& path) {
+	std::ifstream in{path};
+	if (!in) {
+		throw vpkedit_bench_error{"Failed to open the baseline file \"" + path + "\""};
+	}
+	std::vector<Baseline> baselines;
+	std::size_t lineNumber = 0;
+	for (std::string line; std::getline(in, line); ) {
+		lineNumber++;
+		if (const auto comment = line.find('#'); comment != std::string::npos) {
+			line.erase(comment);
+		}
+		std::istringstream fields{line};
+		Baseline baseline;
+		if (!(fields >> baseline.name)) {
+			continue;
+		}
+		if (!(fields >> baseline.metric >> baseline.value) || (baseline.metric != "bytes_per_second" && baseline.metric != "items_per_second")) {
+			throw vpkedit_bench_error{path + ":" + std::to_string(lineNumber) + ": expected \"<benchmark> bytes_per_second|items_per_second <value> [tolerance]\""};
+		}
+		if (!(fields >> baseline.tolerance)) {
+			baseline.tolerance = -1.0;
+		}
+		baselines.push_back(std::move(baseline));
+	}
+	return baselines;
+}
+
+void writeBaselines(std::ostream& out, const std::vector<BenchResult>& results, const CorpusOptions& corpus) {
+	out << std::setprecision(6);
+	out << "# Median throughput recorded by " << PROJECT_NAME << "_bench --write-baseline\n"
+	    << "# Corpus: " << (corpus.synthetic ? "synthetic" : "disk") << ", seed " << corpus.seed << ", " << corpus.entryCount
+	    << " entries, mean size " << corpus.meanSize << ", max size " << corpus.maxSize << "\n";
+	for (const auto& result : results) {
+		const auto* metric = result.bytes ? "bytes_per_second" : "items_per_second";
+		if (const auto value = getThroughput(result, metric)) {
+			out << result.name << ' ' << metric << ' ' << *value << '\n';
+		}
+	}
+}
+
+// Prints one line per baseline, returns false if any benchmark is slower than its baseline allows or did not run
+[[nodiscard]] bool checkBaselines(const std::vector<BenchResult>& results, const std::vector<Baseline>& baselines, double defaultTolerance) {
+	bool ok = true;
+	for (const auto& baseline : baselines) {
+		const auto result = std::find_if(results.begin(), results.end(), [&baseline](const BenchResult& r) {
+			return r.name == baseline.name;
+		});
+		const auto value = result != results.end() ? getThroughput(*result, baseline.metric) : std::nullopt;
+		if (!value) {
+			std::cerr << baseline.name << " " << baseline.metric << ": FAILED, the benchmark did not run" << std::endl;
+			ok = false;
+			continue;
+		}
+		const auto tolerance = baseline.tolerance >= 0.0 ? baseline.tolerance : defaultTolerance;
+		const auto change = (*value - baseline.value) / baseline.value;
+		const bool regressed = *value < baseline.value * (1.0 - tolerance);
+		std::cerr << baseline.name << " " << baseline.metric << ": " << *value << " (baseline " << baseline.value << ", "
+		          << std::showpos << std::fixed << std::setprecision(1) << change * 100.0 << "%" << std::noshowpos << std::defaultfloat
+		          << std::setprecision(6) << ", tolerance " << tolerance * 100.0 << "%) " << (regressed ? "REGRESSED" : "ok") << std::endl;
+		ok = ok && !regressed;
+	}
+	return ok;
+}
+
+} // namespace
+
+int main(int argc, const char* const* argv) {
+	argparse::ArgumentParser cli{std::string{PROJECT_NAME} + "_bench", PROJECT_VERSION_PRETTY.data(), argparse::default_arguments::help};
+
+	cli.add_description("Benchmarks the Respawn VPK code on a synthetic corpus, so no game files are needed.\n"
+	                    "The corpus is generated from the seed, packed, then the pack is opened, read, extracted\n"
+	                    "and baked. The benchmarks that run are:\n"
+	                    " - pack:               Packs the corpus directory into a new Respawn VPK.\n"
+	                    " - open:               Opens the packed _dir.vpk.\n"
+	                    " - read_random:        Reads randomly chosen entries with readEntry.\n"
+	                    " - extract_sequential: Extracts every entry to disk in dir tree order.\n"
+	                    " - bake_modified:      Replaces some entries and bakes a copy of the pack, the last bake is\n"
+	                    "                       reopened and read back afterwards (untimed).\n"
+	                    " - hash_*:             Hashes random data in 4 KiB and 1 MiB parts with XXH3-128 (the dedup\n"
+	                    "                       key) and CRC32 (the entry checksum).\n"
+	                    "Results are written as Google Benchmark style JSON. With --baseline the median throughput of\n"
+	                    "each benchmark is also checked against stored values, and the exit code is nonzero if one\n"
+	                    "regressed by more than the tolerance (this is what the perf CTest label runs).");
+
+	cli.add_argument(ARG_P(OUT))
+		.help("The path to write the JSON results to. If unspecified, they are written to stdout.")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(WORK_DIR))
+		.help("The directory to generate the corpus and packs in. If unspecified, a new directory in the\n"
+		      "system temp directory is used.")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(KEEP_FILES))
+		.help("Keep the work directory after the run instead of removing it.")
+		.flag();
+
+	cli.add_argument(ARG_P(FILTER))
+		.help("Only report benchmarks whose name contains this string. The pack is still built (untimed)\n"
+		      "when the others need it.")
+		.default_value("")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(REPETITIONS))
+		.help("How many times to run each benchmark.")
+		.default_value("3")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(SEED))
+		.help("Seed of the synthetic corpus. The same seed and corpus options always generate the same files.")
+		.default_value("1")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(ENTRIES))
+		.help("Number of files in the corpus.")
+		.default_value("10000")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(SIZE_DIST))
+		.help("Distribution of file sizes in the corpus.")
+		.default_value("lognormal")
+		.choices("fixed", "uniform", "lognormal")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(MEAN_SIZE))
+		.help("Mean file size in bytes.")
+		.default_value("16384")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(MAX_SIZE))
+		.help("Largest file size in bytes, sizes drawn above it are clamped.")
+		.default_value("16777216")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(COMPRESSIBLE))
+		.help("Fraction (0 to 1) of files with compressible contents, the rest are random bytes.")
+		.default_value("0.7")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(THREADS))
+		.help("Worker threads used to pack and bake (0 = one per hardware thread).")
+		.default_value("0")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(RANDOM_READS))
+		.help("Number of entries read by read_random.")
+		.default_value("1000")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(BAKE_FILES))
+		.help("Number of entries replaced before each bake_modified run.")
+		.default_value("100")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(SOURCE))
+		.help("Where the pack benchmark packs from: files generated on disk, or a synthetic corpus packed\n"
+		      "straight from generated data (no input files, only the lognormal size distribution).")
+		.default_value("disk")
+		.choices("disk", "synthetic")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(BASELINE))
+		.help("Compare the median throughput of each benchmark with the values in this file, and fail if\n"
+		      "one is slower than its tolerance allows. Every benchmark listed there must run.")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(TOLERANCE))
+		.help("Allowed slowdown against --baseline as a fraction, for baselines that do not set their own.")
+		.default_value("0.25")
+		.nargs(1);
+
+	cli.add_argument(ARG_P(WRITE_BASELINE))
+		.help("Write the median throughput of this run to a baseline file, for use with --baseline.")
+		.nargs(1);
+
+	// A work directory given on the command line may hold other files, only what the benchmark created is removed
+	std::filesystem::path workDir;
+	bool ownsWorkDir = false;
+	bool keepFiles = false;
+	auto cleanUp = [&] {
+		if (keepFiles || workDir.empty()) {
+			return;
+		}
+		std::error_code ec;
+		if (ownsWorkDir) {
+			std::filesystem::remove_all(workDir, ec);
+		} else {
+			for (const auto* subdir : {"input", "pack", "extract", "bake"}) {
+				std::filesystem::remove_all(workDir / subdir, ec);
+			}
+		}
+	};
+	try {
+		cli.parse_args(argc, argv);
+
+		CorpusOptions corpus;
+		corpus.synthetic = cli.get(ARG_P(SOURCE)) == "synthetic";
+		corpus.seed = std::stoull(cli.get(ARG_P(SEED)));
+		corpus.entryCount = std::stoull(cli.get(ARG_P(ENTRIES)));
+		corpus.meanSize = std::max<std::uint64_t>(std::stoull(cli.get(ARG_P(MEAN_SIZE))), 1);
+		corpus.maxSize = std::max<std::uint64_t>(std::stoull(cli.get(ARG_P(MAX_SIZE))), 1);
+		corpus.compressibleRatio = std::clamp(std::stod(cli.get(ARG_P(COMPRESSIBLE))), 0.0, 1.0);
+		if (const auto dist = cli.get(ARG_P(SIZE_DIST)); dist == "fixed") {
+			corpus.sizeDistribution = SizeDistribution::FIXED;
+		} else if (dist == "uniform") {
+			corpus.sizeDistribution = SizeDistribution::UNIFORM;
+		}
+		if (corpus.entryCount == 0) {
+			throw vpkedit_bench_error{"The corpus needs at least one entry"};
+		}
+		if (corpus.synthetic && corpus.sizeDistribution != SizeDistribution::LOGNORMAL) {
+			throw vpkedit_bench_error{"Synthetic corpora only support the lognormal size distribution"};
+		}
+
+		// Read up front, a typo in the file should not cost a whole run
+		std::vector<Baseline> baselines;
+		if (cli.is_used(ARG_P(BASELINE))) {
+			baselines = readBaselines(cli.get(ARG_P(BASELINE)));
+		}
+		const auto tolerance = std::max(std::stod(cli.get(ARG_P(TOLERANCE))), 0.0);
+
+		const auto repetitions = std::max<std::size_t>(std::stoull(cli.get(ARG_P(REPETITIONS))), 1);
+		const auto threadCount = static_cast<std::size_t>(std::stoull(cli.get(ARG_P(THREADS))));
+		const auto randomReads = static_cast<std::size_t>(std::stoull(cli.get(ARG_P(RANDOM_READS))));
+		const auto bakeFiles = std::min<std::size_t>(std::stoull(cli.get(ARG_P(BAKE_FILES))), corpus.entryCount);
+		const auto filter = cli.get(ARG_P(FILTER));
+		keepFiles = cli.get<bool>(ARG_P(KEEP_FILES));
+
+		if (cli.is_used(ARG_P(WORK_DIR))) {
+			workDir = cli.get(ARG_P(WORK_DIR));
+		} else {
+			workDir = std::filesystem::temp_directory_path() / ("vpkedit_bench_" + std::to_string(std::random_device{}()));
+			ownsWorkDir = true;
+		}
+		const auto inputDir = workDir / "input";
+		const auto packDir = workDir / "pack";
+		const auto extractDir = workDir / "extract";
+		const auto bakeDir = workDir / "bake";
+		const auto dirVpkPath = (packDir / "bench_pak000_dir.vpk").string();
+		std::filesystem::remove_all(inputDir);
+
+		std::vector<CorpusFile> files;
+		std::uint64_t corpusBytes = 0;
+		if (!corpus.synthetic) {
+			std::cerr << "Generating " << corpus.entryCount << " files in \"" << inputDir.string() << "\"..." << std::endl;
+			const auto generateSeconds = measure([&] { files = generateCorpus(corpus, inputDir); }).realSeconds;
+			corpusBytes = std::accumulate(files.begin(), files.end(), std::uint64_t{0}, [](std::uint64_t sum, const CorpusFile& f) {
+				return sum + f.size;
+			});
+			std::cerr << "Generated " << corpusBytes << " bytes in " << generateSeconds << " s" << std::endl;
+		}
+
+		std::vector<BenchResult> results;
+		auto selected = [&filter](std::string_view name) {
+			return filter.empty() || name.find(filter) != std::string_view::npos;
+		};
+		auto run = [&](const std::string& name, std::uint64_t bytes, std::uint64_t items, const std::function<void()>& setup, const std::function<void()>& body) {
+			if (!selected(name)) {
+				return;
+			}
+			BenchResult result{name, {}, bytes, items};
+			for (std::size_t i = 0; i < repetitions; i++) {
+				if (setup) {
+					setup();
+				}
+				result.timings.push_back(measure(body));
+				std::cerr << name << " #" << i << ": " << result.timings.back().realSeconds << " s" << std::endl;
+			}
+			results.push_back(std::move(result));
+		};
+
+		respawn_vpk::PackOptions packOptions;
+		packOptions.archiveIndex = 0;
+		packOptions.threadCount = threadCount;
+		respawn_vpk::SyntheticPackOptions syntheticOptions;
+		syntheticOptions.seed = corpus.seed;
+		syntheticOptions.entryCount = corpus.entryCount;
+		syntheticOptions.meanFileSize = corpus.meanSize;
+		syntheticOptions.maxFileSize = corpus.maxSize;
+		syntheticOptions.compressibleRatio = corpus.compressibleRatio;
+		auto packCorpus = [&] {
+			std::string error;
+			const bool ok = corpus.synthetic
+				? respawn_vpk::generateSyntheticRespawnVPK(dirVpkPath, syntheticOptions, packOptions, &error)
+				: respawn_vpk::packDirectoryToRespawnVPK(inputDir.string(), dirVpkPath, packOptions, &error);
+			if (!ok) {
+				throw vpkedit_bench_error{"Failed to pack the corpus: " + error};
+			}
+		};
+		auto clearPackDir = [&] {
+			std::filesystem::remove_all(packDir);
+			std::filesystem::create_directories(packDir);
+		};
+
+		run("pack", corpusBytes, corpus.entryCount, clearPackDir, packCorpus);
+		if (!std::filesystem::exists(dirVpkPath)) {
+			clearPackDir();
+			packCorpus();
+		}
+		if (corpus.synthetic) {
+			// The generator picks the paths and sizes, so the corpus is only known once it has been packed
+			const auto packFile = openRespawnVPK(dirVpkPath);
+			packFile->runForAllEntries([&](const std::string& path, const vpkpp::Entry& entry) {
+				files.push_back({path, entry.length});
+				corpusBytes += entry.length;
+			});
+			for (auto& result : results) {
+				if (result.name == "pack") {
+					result.bytes = corpusBytes;
+				}
+			}
+			std::cerr << "Synthetic corpus has " << files.size() << " entries, " << corpusBytes << " bytes" << std::endl;
+		}
+
+		run("open", 0, files.size(), nullptr, [&] {
+			(void) openRespawnVPK(dirVpkPath);
+		});
+
+		if (selected("read_random")) {
+			const auto packFile = openRespawnVPK(dirVpkPath);
+			std::mt19937_64 rng{corpus.seed};
+			std::vector<std::size_t> picks(randomReads);
+			std::uint64_t readBytes = 0;
+			for (auto& pick : picks) {
+				pick = rng() % files.size();
+				readBytes += files[pick].size;
+			}
+			run("read_random", readBytes, picks.size(), nullptr, [&] {
+				for (const auto pick : picks) {
+					if (!packFile->readEntry(files[pick].path)) {
+						throw vpkedit_bench_error{"Failed to read \"" + files[pick].path + "\""};
+					}
+				}
+			});
+		}
+
+		if (selected("extract_sequential")) {
+			const auto packFile = openRespawnVPK(dirVpkPath);
+			const auto* respawnVPK = dynamic_cast<const RespawnVPK*>(packFile.get());
+			std::vector<std::string> paths;
+			paths.reserve(files.size());
+			packFile->runForAllEntries([&paths](const std::string& path, const vpkpp::Entry&) {
+				paths.push_back(path);
+			});
+			run("extract_sequential", corpusBytes, paths.size(), [&] {
+				std::filesystem::remove_all(extractDir);
+			}, [&] {
+				for (const auto& path : paths) {
+					const auto outPath = extractDir / path;
+					std::filesystem::create_directories(outPath.parent_path());
+					std::string error;
+					if (!respawnVPK->extractEntryToFile(path, outPath.string(), &error)) {
+						throw vpkedit_bench_error{"Failed to extract \"" + path + "\": " + error};
+					}
+				}
+			});
+			std::filesystem::remove_all(extractDir);
+		}
+
+		if (selected("bake_modified")) {
+			// Each run bakes a fresh copy of the pack, so earlier runs do not grow the patch archive for later ones
+			std::unique_ptr<vpkpp::PackFile> packFile;
+			std::uint64_t round = 0;
+			std::uint64_t modifiedBytes = 0;
+			std::mt19937_64 rng{corpus.seed ^ 0xBA4Eull};
+			std::vector<std::size_t> picks(bakeFiles);
+			for (auto& pick : picks) {
+				pick = rng() % files.size();
+			}
+			for (const auto pick : picks) {
+				modifiedBytes += files[pick].size;
+			}
+			run("bake_modified", modifiedBytes, picks.size(), [&] {
+				packFile.reset();
+				std::filesystem::remove_all(bakeDir);
+				std::filesystem::copy(packDir, bakeDir, std::filesystem::copy_options::recursive);
+				packFile = openRespawnVPK((bakeDir / std::filesystem::path{dirVpkPath}.filename()).string());
+				round++;
+				for (const auto pick : picks) {
+					packFile->addEntry(files[pick].path, makeFileContents(fileSeed(corpus.seed + round, pick), files[pick].size, true), {});
+				}
+			}, [&] {
+				if (!packFile->bake("", {}, nullptr)) {
+					throw vpkedit_bench_error{"Failed to bake: "s + std::string{dynamic_cast<RespawnVPK&>(*packFile).getLastError()}};
+				}
+			});
+			packFile.reset();
+
+			// The timed runs never look at their output, so check the last bake reopens and reads back (untimed)
+			{
+				const auto baked = openRespawnVPK((bakeDir / std::filesystem::path{dirVpkPath}.filename()).string());
+				if (baked->getEntryCount() != files.size()) {
+					throw vpkedit_bench_error{"The baked pack has " + std::to_string(baked->getEntryCount()) + " entries, expected " + std::to_string(files.size())};
+				}
+				for (const auto& file : files) {
+					const auto data = baked->readEntry(file.path);
+					if (!data || data->size() != file.size) {
+						throw vpkedit_bench_error{"The baked pack does not read back \"" + file.path + "\""};
+					}
+				}
+				for (const auto pick : picks) {
+					auto expected = makeFileContents(fileSeed(corpus.seed + round, pick), files[pick].size, true);
+					// Respawn stores .wav data with the RIFF header blanked out, it goes to the .cam file instead
+					if (files[pick].path.ends_with(".wav") && expected.size() >= 44) {
+						std::fill_n(expected.begin(), 44, std::byte{0xCB});
+					}
+					if (baked->readEntry(files[pick].path) != expected) {
+						throw vpkedit_bench_error{"The baked pack has the wrong contents for \"" + files[pick].path + "\""};
+					}
+				}
+			}
+			std::filesystem::remove_all(bakeDir);
+		}
+
+		{
+			// Independent of the corpus, the same 64 MiB is hashed in parts the size the packer and bake hash
+			constexpr std::uint64_t HASH_BYTES = 64 * 1024 * 1024;
+			std::vector<std::byte> hashData;
+			std::uint64_t sink = 0;
+			for (const std::size_t partSize : {std::size_t{4 * 1024}, std::size_t{1024 * 1024}}) {
+				const auto suffix = "/" + std::to_string(partSize);
+				if (!selected("hash_xxh3_128" + suffix) && !selected("hash_crc32" + suffix)) {
+					continue;
+				}
+				if (hashData.empty()) {
+					hashData = makeFileContents(fileSeed(corpus.seed, 0x4A54), HASH_BYTES, false);
+				}
+				const auto partCount = HASH_BYTES / partSize;
+				run("hash_xxh3_128" + suffix, HASH_BYTES, partCount, nullptr, [&] {
+					for (std::uint64_t i = 0; i < partCount; i++) {
+						sink += respawn_vpk::computeContentHash(std::span<const std::byte>{hashData.data() + i * partSize, partSize}).low;
+					}
+				});
+				run("hash_crc32" + suffix, HASH_BYTES, partCount, nullptr, [&] {
+					for (std::uint64_t i = 0; i < partCount; i++) {
+						sink += sourcepp::crypto::computeCRC32(std::span<const std::byte>{hashData.data() + i * partSize, partSize});
+					}
+				});
+			}
+			// Keeps the hashing from being optimized away
+			if (sink == 1) {
+				std::cerr << std::endl;
+			}
+		}
+
+		if (cli.is_used(ARG_P(OUT))) {
+			std::ofstream out{cli.get(ARG_P(OUT)), std::ios::trunc};
+			writeResultsJson(out, results, corpus, corpusBytes, argv[0]);
+			if (!out) {
+				throw vpkedit_bench_error{"Failed to write the results to \"" + cli.get(ARG_P(OUT)) + "\""};
+			}
+		} else {
+			writeResultsJson(std::cout, results, corpus, corpusBytes, argv[0]);
+		}
+
+		if (cli.is_used(ARG_P(WRITE_BASELINE))) {
+			std::ofstream out{cli.get(ARG_P(WRITE_BASELINE)), std::ios::trunc};
+			writeBaselines(out, results, corpus);
+			if (!out) {
+				throw vpkedit_bench_error{"Failed to write the baseline to \"" + cli.get(ARG_P(WRITE_BASELINE)) + "\""};
+			}
+		}
+		if (!baselines.empty() && !checkBaselines(results, baselines, tolerance)) {
+			std::cerr << "Throughput regressed against \"" << cli.get(ARG_P(BASELINE)) << "\"" << std::endl;
+			cleanUp();
+			return EXIT_FAILURE;
+		}
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		cleanUp();
+		return EXIT_FAILURE;
+	}
+
+	cleanUp();
+	return EXIT_SUCCESS;
+}
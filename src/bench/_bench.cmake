@@ -0,0 +1,82 @@
+# Both executables build the Respawn VPK code directly, like the CLI and GUI do
+set(VPKEDIT_BENCH_SHARED_SOURCES
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPK.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPK.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKPack.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKPack.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKCopy.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKCopy.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKCompressionCache.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKCompressionCache.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKManifest.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKManifest.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKMemory.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKMemory.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKHash.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKHash.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKJournal.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKJournal.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKParallel.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKScan.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKScan.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKSort.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKStats.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKStats.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKTrace.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKTrace.h")
+
+# Create executables
+add_executable(${PROJECT_NAME}_bench
+        "${CMAKE_CURRENT_LIST_DIR}/Main.cpp"
+        ${VPKEDIT_BENCH_SHARED_SOURCES})
+
+add_executable(${PROJECT_NAME}_corpus
+        "${CMAKE_CURRENT_LIST_DIR}/Corpus.cpp"
+        ${VPKEDIT_BENCH_SHARED_SOURCES})
+
+foreach(BENCH_TARGET ${PROJECT_NAME}_bench ${PROJECT_NAME}_corpus)
+    vpkedit_configure_target(${BENCH_TARGET})
+
+    target_link_libraries(
+            ${BENCH_TARGET} PUBLIC
+            argparse::argparse
+            sourcepp::vpkpp
+            xxhash::xxhash)
+
+    if(TARGET lzham::bridge)
+        target_link_libraries(${BENCH_TARGET} PRIVATE lzham::bridge)
+        target_compile_definitions(${BENCH_TARGET} PRIVATE VPKEDIT_HAVE_LZHAM=1)
+
+        add_custom_command(TARGET ${BENCH_TARGET} POST_BUILD
+                COMMAND ${CMAKE_COMMAND} -E copy_if_different
+                "$<TARGET_FILE:lzham_bridge>"
+                "$<TARGET_FILE_DIR:${BENCH_TARGET}>")
+    endif()
+
+    if(VPKEDIT_ENABLE_TRACING)
+        target_compile_definitions(${BENCH_TARGET} PRIVATE VPKEDIT_HAVE_TRACING=1)
+    endif()
+
+    target_include_directories(
+            ${BENCH_TARGET} PUBLIC
+            "${CMAKE_CURRENT_SOURCE_DIR}/src/shared")
+endforeach()
+
+# Reduced benchmark runs checked against the baselines in baselines/, run with `ctest -L perf`
+# They pack synthetic corpora, so they run anywhere without game files. Throughput depends on the machine: re-record a
+# baseline on the machine that runs these by adding `--write-baseline <file>` to the test's command line
+enable_testing()
+function(vpkedit_add_perf_test NAME)
+    add_test(NAME ${PROJECT_NAME}_perf_${NAME}
+            COMMAND ${PROJECT_NAME}_bench --source synthetic --seed 1 --repetitions 3 --tolerance 0.25 ${ARGN}
+            --baseline "${CMAKE_CURRENT_LIST_DIR}/baselines/${NAME}.txt")
+    set_tests_properties(${PROJECT_NAME}_perf_${NAME} PROPERTIES
+            LABELS perf
+            RUN_SERIAL TRUE
+            TIMEOUT 3600)
+endfunction()
+
+vpkedit_add_perf_test(open --filter open --entries 100000 --mean-size 1024 --max-size 65536)
+# About 1 GiB of data
+vpkedit_add_perf_test(pack --filter pack --entries 65536 --mean-size 16384)
+vpkedit_add_perf_test(extract --filter extract_sequential --entries 50000 --mean-size 8192)
@@ -0,0 +1,195 @@
+#include "List.h"
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../shared/RespawnVPK.h"
+
+using namespace vpkpp;
+
+namespace {
+
+// Same set of values for every pack type; Respawn VPKs fill in the real parts, other formats get a single part
+struct ListedPart {
+	std::uint32_t archiveIndex = 0;
+	std::uint64_t offset = 0;
+	std::uint64_t length = 0;
+	std::uint64_t uncompressedLength = 0;
+	std::uint32_t loadFlags = 0;
+	std::uint32_t textureFlags = 0;
+};
+
+void appendNumber(std::string& out, std::uint64_t value) {
+	char buf[24];
+	const auto result = std::to_chars(buf, buf + sizeof(buf), value);
+	out.append(buf, result.ptr);
+}
+
+void appendHex32(std::string& out, std::uint32_t value) {
+	static constexpr std::string_view DIGITS = "0123456789abcdef";
+	for (int shift = 28; shift >= 0; shift -= 4) {
+		out.push_back(DIGITS[(value >> shift) & 0xf]);
+	}
+}
+
+void appendJsonString(std::string& out, std::string_view s) {
+	out.push_back('"');
+	for (const char c : s) {
+		if (c == '"' || c == '\\') {
+			out.push_back('\\');
+			out.push_back(c);
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			out.append("\\u00");
+			out.push_back("0123456789abcdef"[(c >> 4) & 0xf]);
+			out.push_back("0123456789abcdef"[c & 0xf]);
+		} else {
+			out.push_back(c);
+		}
+	}
+	out.push_back('"');
+}
+
+void appendCsvField(std::string& out, std::string_view s) {
+	if (s.find_first_of(",\"\r\n") == std::string_view::npos) {
+		out.append(s);
+		return;
+	}
+	out.push_back('"');
+	for (const char c : s) {
+		if (c == '"') {
+			out.push_back('"');
+		}
+		out.push_back(c);
+	}
+	out.push_back('"');
+}
+
+void appendJsonLine(std::string& out, const std::string& path, const Entry& entry, std::uint64_t preloadBytes, const std::vector<ListedPart>& parts) {
+	std::uint64_t storedLength = 0;
+	bool compressed = false;
+	for (const auto& part : parts) {
+		storedLength += part.length;
+		compressed |= part.length != part.uncompressedLength;
+	}
+
+	out.append("{\"path\":");
+	appendJsonString(out, path);
+	out.append(",\"length\":");
+	appendNumber(out, entry.length);
+	out.append(",\"crc32\":\"");
+	appendHex32(out, entry.crc32);
+	out.append("\",\"preload_bytes\":");
+	appendNumber(out, preloadBytes);
+	out.append(",\"archive_index\":");
+	appendNumber(out, parts.empty() ? entry.archiveIndex : parts.front().archiveIndex);
+	out.append(",\"offset\":");
+	appendNumber(out, parts.empty() ? entry.offset : parts.front().offset);
+	out.append(",\"stored_length\":");
+	appendNumber(out, storedLength);
+	out.append(",\"part_count\":");
+	appendNumber(out, parts.size());
+	out.append(",\"compressed\":").append(compressed ? "true" : "false");
+	out.append(",\"parts\":[");
+	for (std::size_t i = 0; i < parts.size(); i++) {
+		const auto& part = parts[i];
+		out.append(i ? ",{\"archive_index\":" : "{\"archive_index\":");
+		appendNumber(out, part.archiveIndex);
+		out.append(",\"offset\":");
+		appendNumber(out, part.offset);
+		out.append(",\"length\":");
+		appendNumber(out, part.length);
+		out.append(",\"uncompressed_length\":");
+		appendNumber(out, part.uncompressedLength);
+		out.append(",\"load_flags\":");
+		appendNumber(out, part.loadFlags);
+		out.append(",\"texture_flags\":");
+		appendNumber(out, part.textureFlags);
+		out.push_back('}');
+	}
+	out.append("]}\n");
+}
+
+// One row per entry, the location and flags columns describe the first part
+void appendCsvLine(std::string& out, const std::string& path, const Entry& entry, std::uint64_t preloadBytes, const std::vector<ListedPart>& parts) {
+	std::uint64_t storedLength = 0;
+	bool compressed = false;
+	for (const auto& part : parts) {
+		storedLength += part.length;
+		compressed |= part.length != part.uncompressedLength;
+	}
+	const ListedPart first = parts.empty() ? ListedPart{} : parts.front();
+
+	appendCsvField(out, path);
+	out.push_back(',');
+	appendNumber(out, entry.length);
+	out.push_back(',');
+	appendHex32(out, entry.crc32);
+	out.push_back(',');
+	appendNumber(out, preloadBytes);
+	out.push_back(',');
+	appendNumber(out, first.archiveIndex);
+	out.push_back(',');
+	appendNumber(out, first.offset);
+	out.push_back(',');
+	appendNumber(out, storedLength);
+	out.push_back(',');
+	appendNumber(out, parts.size());
+	out.append(compressed ? ",1," : ",0,");
+	appendNumber(out, first.loadFlags);
+	out.push_back(',');
+	appendNumber(out, first.textureFlags);
+	out.push_back('\n');
+}
+
+} // namespace
+
+void listPackFile(const PackFile& packFile, ListFormat format, std::ostream& out) {
+	const auto* respawnVPK = dynamic_cast<const RespawnVPK*>(&packFile);
+	const bool hasPreloadData = static_cast<bool>(packFile.getSupportedEntryAttributes() & Attribute::VPK_PRELOADED_DATA);
+
+	if (format == ListFormat::CSV) {
+		out << "path,length,crc32,preload_bytes,archive_index,offset,stored_length,part_count,compressed,load_flags,texture_flags\n";
+	}
+
+	// Reused for every entry, flushed to the stream in large blocks
+	static constexpr std::size_t FLUSH_THRESHOLD = 1024 * 1024;
+	std::string buffer;
+	buffer.reserve(FLUSH_THRESHOLD + 4096);
+	std::vector<ListedPart> parts;
+
+	// Unbaked entries have no location on disk yet
+	packFile.runForAllEntries([&](const std::string& path, const Entry& entry) {
+		parts.clear();
+		std::uint64_t preloadBytes = 0;
+		if (respawnVPK) {
+			if (const auto stored = respawnVPK->getStoredEntry(path, false)) {
+				preloadBytes = stored->preloadBytes;
+				for (const auto& part : stored->parts) {
+					parts.push_back({part.archiveIndex, part.offset, part.length, part.uncompressedLength, part.loadFlags, part.textureFlags});
+				}
+			}
+		} else {
+			if (hasPreloadData) {
+				preloadBytes = entry.extraData.size();
+			}
+			const auto stored = entry.compressedLength ? entry.compressedLength : entry.length - preloadBytes;
+			parts.push_back({entry.archiveIndex, entry.offset, stored, entry.length - preloadBytes, 0, 0});
+		}
+
+		if (format == ListFormat::JSONL) {
+			appendJsonLine(buffer, path, entry, preloadBytes, parts);
+		} else {
+			appendCsvLine(buffer, path, entry, preloadBytes, parts);
+		}
+		if (buffer.size() >= FLUSH_THRESHOLD) {
+			out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+			buffer.clear();
+		}
+	}, false);
+
+	out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	out.flush();
+}
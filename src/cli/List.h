@@ -0,0 +1,13 @@
+#pragma once
+
+#include <ostream>
+
+#include <vpkpp/PackFile.h>
+
+enum class ListFormat {
+	JSONL,
+	CSV,
+};
+
+// Writes one record per entry as it is visited, without building a tree, so it stays flat in memory for huge packs
+void listPackFile(const vpkpp::PackFile& packFile, ListFormat format, std::ostream& out);
@@ -16,7 +16,11 @@
 
 #include "../shared/RespawnVPKPack.h"
 #include "../shared/RespawnVPK.h"
+#include "../shared/RespawnVPKMemory.h"
+#include "../shared/RespawnVPKStats.h"
+#include "../shared/RespawnVPKTrace.h"
 
+#include "List.h"
 #include "Tree.h"
 
 #ifdef _WIN32
@@ -42,19 +46,32 @@ ARG_S(CHUNKSIZE,          "-c", "--chunksize");
 ARG_S(COMPRESSION_METHOD, "-m", "--compression-method");
 ARG_S(COMPRESSION_LEVEL,  "-x", "--compression-level");
 ARG_L(GEN_MD5_ENTRIES,          "--gen-md5-entries");
+ARG_L(COMPRESSION_CACHE,        "--compression-cache");
+ARG_L(COMPRESSION_CACHE_SIZE,   "--compression-cache-size");
+ARG_L(INCREMENTAL,              "--incremental");
+ARG_L(PLACEMENT,                "--placement");
+ARG_L(LOAD_ORDER,               "--load-order");
 ARG_L(ADD_FILE,                 "--add-file");
 ARG_L(ADD_DIR,                  "--add-dir");
 ARG_L(REMOVE_FILE,              "--remove-file");
 ARG_L(REMOVE_DIR,               "--remove-dir");
+ARG_L(HARDLINK_ARCHIVES,        "--hardlink-archives");
+ARG_L(COMPACT,                  "--compact");
+ARG_L(NO_REORDER,               "--no-reorder");
+ARG_L(CONVERT,                  "--convert");
 ARG_S(PRELOAD,            "-p", "--preload");
 ARG_S(SINGLE_FILE,        "-s", "--single-file");
 ARG_S(EXTRACT,            "-e", "--extract");
 ARG_L(GEN_KEYPAIR,              "--gen-keypair");
 ARG_L(FILE_TREE,                "--file-tree");
+ARG_L(LIST,                     "--list");
 ARG_S(SIGN,               "-k", "--sign");
 ARG_L(VERIFY_CHECKSUMS,         "--verify-checksums");
 ARG_L(VERIFY_SIGNATURE,         "--verify-signature");
 ARG_L(DECRYPTION_KEY,           "--decryption-key");
+ARG_L(TRACE,                    "--trace");
+ARG_L(STATS,                    "--stats");
+ARG_L(MEMORY_BUDGET,            "--memory-budget");
 
 #undef ARG_S
 #undef ARG_L
@@ -194,6 +211,22 @@ void fileTree(const argparse::ArgumentParser& cli, const std::string& inputPath)
 	::prettyPrintPackFile(packFile);
 }
 
+/// Stream a machine-readable listing of an existing pack file to stdout
+void list(const argparse::ArgumentParser& cli, const std::string& inputPath) {
+	std::unique_ptr<PackFile> packFile;
+	if (inputPath.ends_with("_dir.vpk")) {
+		packFile = RespawnVPK::open(inputPath);
+	}
+	if (!packFile) {
+		packFile = PackFile::open(inputPath, nullptr, ::getOpenPropertyRequestor(cli));
+	}
+	if (!packFile) {
+		throw vpkedit_load_error{"Could not open the pack file at \"" + inputPath + "\": it failed to load!"};
+	}
+	const auto format = cli.get(ARG_L(LIST)) == "csv" ? ListFormat::CSV : ListFormat::JSONL;
+	::listPackFile(*packFile, format, std::cout);
+}
+
 /// Generate private/public key files
 void generateKeyPair(const std::string& inputPath) {
 	if (!VPK::generateKeyPairFiles(inputPath)) {
@@ -228,6 +261,10 @@ void edit(const argparse::ArgumentParser& cli, const std::string& inputPath) {
 	const auto compressionLevel = static_cast<int8_t>(std::stoi(cli.get<std::string>(ARG_S(COMPRESSION_LEVEL))));
 	const auto generateMD5Entries = cli.get<bool>(ARG_L(GEN_MD5_ENTRIES));
 
+	if (auto* respawnVPK = dynamic_cast<RespawnVPK*>(packFile.get())) {
+		respawnVPK->setBakeHardlinkArchives(cli.get<bool>(ARG_L(HARDLINK_ARCHIVES)));
+	}
+
 	if (cli.is_used(ARG_L(REMOVE_FILE))) {
 		for (const auto paths = cli.get<std::vector<std::string>>(ARG_L(REMOVE_FILE)); const auto& path : paths) {
 			if (!packFile->removeEntry(path)) {
@@ -285,6 +322,42 @@ void edit(const argparse::ArgumentParser& cli, const std::string& inputPath) {
 		.zip_compressionStrength = compressionLevel,
 		.vpk_generateMD5Entries = generateMD5Entries,
 	}, nullptr);
+
+	if (const auto* respawnVPK = dynamic_cast<RespawnVPK*>(packFile.get())) {
+		const auto& stats = respawnVPK->getLastBakeStats();
+		if (stats.metadataOnly) {
+			std::cout << "No file contents changed, only the directory tree was rewritten." << std::endl;
+		} else {
+			std::cout << "Wrote " << stats.bytesWritten << " bytes of new data for " << stats.unbakedEntries << " file(s)." << std::endl;
+		}
+		if (stats.bytesSaved()) {
+			std::cout << "Deduplication saved " << stats.bytesSaved() << " bytes ("
+			          << stats.bytesDedupedInBake << " within this bake, "
+			          << stats.bytesReusedFromArchives << " reused from " << stats.entriesReusedFromArchives << " file(s) already in the archives)." << std::endl;
+		}
+		if (stats.carriedOverFiles) {
+			std::cout << "Carried over " << stats.carriedOverFiles << " existing archive file(s) (" << stats.carriedOverBytes << " bytes) using "
+			          << respawn_vpk::carryOverStrategyName(stats.carryOverStrategy) << " in " << stats.carryOverSeconds << "s." << std::endl;
+		}
+	}
+}
+
+/// Reclaim dead space in the patch archive of an existing Respawn VPK
+void compact(const argparse::ArgumentParser& cli, const std::string& inputPath) {
+	std::unique_ptr<PackFile> packFile;
+	if (inputPath.ends_with("_dir.vpk")) {
+		packFile = RespawnVPK::open(inputPath);
+	}
+	auto* respawnVPK = dynamic_cast<RespawnVPK*>(packFile.get());
+	if (!respawnVPK) {
+		throw vpkedit_load_error{"Could not open \"" + inputPath + "\" as a Respawn VPK! Only Respawn VPKs have a patch archive to compact."};
+	}
+	if (!respawnVPK->compactPatchArchive(!cli.get<bool>(ARG_L(NO_REORDER)))) {
+		throw vpkedit_runtime_error{"Failed to compact the patch archive: " + std::string{respawnVPK->getLastError()}};
+	}
+	const auto& stats = respawnVPK->getLastCompactStats();
+	std::cout << "Compacted the patch archive from " << stats.bytesBefore << " to " << stats.bytesAfter << " bytes ("
+	          << stats.bytesReclaimed() << " bytes reclaimed)." << std::endl;
 }
 
 /// Sign an existing VPK
@@ -350,6 +423,53 @@ void verify(const argparse::ArgumentParser& cli, const std::string& inputPath) {
 	}
 }
 
+/// Respawn VPK pack options shared by Pack and Convert modes
+[[nodiscard]] respawn_vpk::PackOptions respawnPackOptions(const argparse::ArgumentParser& cli) {
+	respawn_vpk::PackOptions opts{};
+	opts.archiveIndex = 999;
+	if (cli.is_used(ARG_L(COMPRESSION_CACHE))) {
+		opts.compressionCacheDir = cli.get(ARG_L(COMPRESSION_CACHE));
+		opts.compressionCacheMaxBytes = std::stoull(cli.get(ARG_L(COMPRESSION_CACHE_SIZE))) * 1024 * 1024;
+	}
+	opts.incremental = cli.get<bool>(ARG_L(INCREMENTAL));
+	if (cli.is_used(ARG_S(CHUNKSIZE))) {
+		// Split archives are numbered from _000 instead of going into the _999 patch archive
+		opts.archiveIndex = 0;
+		opts.maxArchiveBytes = std::stoull(cli.get(ARG_S(CHUNKSIZE))) * 1024 * 1024;
+	}
+	if (cli.get(ARG_L(PLACEMENT)) == "dir") {
+		opts.placement = respawn_vpk::PackPlacement::DIRECTORY;
+	}
+	if (cli.is_used(ARG_L(LOAD_ORDER))) {
+		const auto loadOrderPath = cli.get(ARG_L(LOAD_ORDER));
+		std::ifstream loadOrderFile{loadOrderPath};
+		if (!loadOrderFile) {
+			throw vpkedit_runtime_error{"Failed to open load order file at \"" + loadOrderPath + "\"!"};
+		}
+		for (std::string line; std::getline(loadOrderFile, line); ) {
+			if (!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			if (!line.empty()) {
+				opts.loadOrder.push_back(std::move(line));
+			}
+		}
+	}
+	return opts;
+}
+
+/// Summary of a Respawn VPK pack, for the options that have something to report
+void printRespawnPackStats(const respawn_vpk::PackOptions& opts, const respawn_vpk::PackStats& stats) {
+	if (!opts.compressionCacheDir.empty()) {
+		std::cout << "Compression cache: " << stats.compressionCacheHits << " part(s) reused, "
+		          << stats.compressionCacheMisses << " part(s) compressed." << std::endl;
+	}
+	if (opts.incremental) {
+		std::cout << "Incremental pack: " << stats.incrementalReusedEntries << " unchanged file(s) copied from the previous pack ("
+		          << stats.incrementalReusedBytes << " bytes)." << std::endl;
+	}
+}
+
 /// Pack contents of a directory or response file into a new pack file
 void pack(const argparse::ArgumentParser& cli, std::string inputPath) {
 	const auto type = cli.get<std::string>(ARG_S(TYPE));
@@ -419,11 +539,11 @@ void pack(const argparse::ArgumentParser& cli, std::string inputPath) {
 			outputPath += ".vpk";
 		}
 
-		respawn_vpk::PackOptions opts{};
-		opts.archiveIndex = 999;
+		const auto opts = ::respawnPackOptions(cli);
 
 		std::string err;
-		if (!respawn_vpk::packDirectoryToRespawnVPK(inputPath, outputPath, opts, &err)) {
+		respawn_vpk::PackStats stats;
+		if (!respawn_vpk::packDirectoryToRespawnVPK(inputPath, outputPath, opts, &err, &stats)) {
 			if (!noProgressBar) {
 				bar->mark_as_completed();
 			}
@@ -434,6 +554,8 @@ void pack(const argparse::ArgumentParser& cli, std::string inputPath) {
 			bar->mark_as_completed();
 		}
 
+		::printRespawnPackStats(opts, stats);
+
 		if (fileTree) {
 			::fileTree(cli, outputPath);
 		}
@@ -537,6 +659,133 @@ void pack(const argparse::ArgumentParser& cli, std::string inputPath) {
 	std::cout << "Successfully created pack file at \"" << packFile->getFilepath() << "\"." << std::endl;
 }
 
+/// Repack an existing pack file into a new Respawn VPK without extracting it first
+void convert(const argparse::ArgumentParser& cli, const std::string& inputPath) {
+	if (cli.get<std::string>(ARG_S(TYPE)) != "rvpk") {
+		throw vpkedit_invalid_argument_error{"Pack files can only be converted to Respawn VPKs! Add \"" + std::string{ARG_S(TYPE)} + " rvpk\"."};
+	}
+
+	std::unique_ptr<PackFile> packFile;
+	if (inputPath.ends_with("_dir.vpk")) {
+		packFile = RespawnVPK::open(inputPath);
+	}
+	if (!packFile) {
+		packFile = PackFile::open(inputPath, nullptr, ::getOpenPropertyRequestor(cli));
+	}
+	if (!packFile) {
+		throw vpkedit_load_error{"Could not open the pack file at \"" + inputPath + "\": it failed to load!"};
+	}
+
+	const auto fsInputPath = std::filesystem::path{inputPath};
+	std::string outputPath;
+	if (cli.is_used(ARG_S(OUTPUT))) {
+		outputPath = cli.get(ARG_S(OUTPUT));
+	} else {
+		// A *_dir.vpk input would otherwise map onto itself
+		auto stem = fsInputPath.stem().string();
+		if (stem.ends_with("_dir")) {
+			stem.resize(stem.size() - 4);
+			stem += "_rvpk";
+		}
+		outputPath = (fsInputPath.parent_path() / stem).string();
+	}
+	if (!outputPath.ends_with("_dir.vpk")) {
+		if (outputPath.ends_with(".vpk")) {
+			outputPath.resize(outputPath.size() - 4);
+		}
+		if (!outputPath.ends_with("_dir")) {
+			outputPath += "_dir";
+		}
+		outputPath += ".vpk";
+	}
+	if (std::error_code ec; std::filesystem::equivalent(inputPath, outputPath, ec) && !ec) {
+		throw vpkedit_invalid_argument_error{"The output path \"" + outputPath + "\" is the pack file being converted, choose a different one with \"" + std::string{ARG_S(OUTPUT)} + "\"!"};
+	}
+
+	const auto opts = ::respawnPackOptions(cli);
+	if (const auto collision = respawn_vpk::findCollidingSourceArchive(*packFile, outputPath, opts); !collision.empty()) {
+		throw vpkedit_invalid_argument_error{"The output path \"" + outputPath + "\" would overwrite \"" + collision + "\" of the pack file being converted, choose a different one with \"" + std::string{ARG_S(OUTPUT)} + "\"!"};
+	}
+
+	const auto noProgressBar = cli.get<bool>(ARG_L(NO_PROGRESS));
+	std::unique_ptr<indicators::IndeterminateProgressBar> bar;
+	if (!noProgressBar) {
+		bar = std::make_unique<indicators::IndeterminateProgressBar>(
+			indicators::option::BarWidth{40},
+			indicators::option::Start{"["},
+			indicators::option::Fill{"·"},
+			indicators::option::Lead{"<==>"},
+			indicators::option::End{"]"},
+			indicators::option::PostfixText{"Converting files..."}
+		);
+	}
+
+	std::string err;
+	respawn_vpk::PackStats stats;
+	const bool ok = respawn_vpk::packPackFileToRespawnVPK(*packFile, outputPath, opts, &err, &stats);
+	if (!noProgressBar) {
+		bar->mark_as_completed();
+	}
+	if (!ok) {
+		throw vpkedit_runtime_error{"Failed to convert to a Respawn VPK: " + err};
+	}
+
+	std::cout << "Converted \"" << inputPath << "\" to \"" << outputPath << "\"." << std::endl;
+	if (dynamic_cast<RespawnVPK*>(packFile.get())) {
+		std::cout << "Copied " << stats.sourceCopiedEntries << " file(s) without recompressing them ("
+		          << stats.sourceCopiedBytes << " bytes)." << std::endl;
+	}
+	::printRespawnPackStats(opts, stats);
+
+	if (cli.get<bool>(ARG_L(FILE_TREE))) {
+		::fileTree(cli, outputPath);
+	}
+}
+
+/// Writes the trace recorded since start() when the program exits, including when it fails
+class TraceSession {
+public:
+	void start(std::string outputPath) {
+		if (!respawn_vpk::trace::isAvailable()) {
+			throw vpkedit_invalid_argument_error{"Tracing is not available in this build! Configure it with VPKEDIT_ENABLE_TRACING."};
+		}
+		this->outputPath = std::move(outputPath);
+		respawn_vpk::trace::start();
+	}
+
+	~TraceSession() {
+		if (this->outputPath.empty()) {
+			return;
+		}
+		if (std::string error; !respawn_vpk::trace::stop(this->outputPath, &error)) {
+			std::cerr << error << std::endl;
+		} else {
+			std::cerr << "Wrote trace to \"" << this->outputPath << "\"." << std::endl;
+		}
+	}
+
+private:
+	std::string outputPath;
+};
+
+// Prints the Respawn VPK counters once the command is done, whether it succeeded or not
+class StatsReport {
+public:
+	void enable() {
+		respawn_vpk::stats::reset();
+		this->enabled = true;
+	}
+
+	~StatsReport() {
+		if (this->enabled) {
+			std::cerr << "\nStatistics:\n" << respawn_vpk::stats::formatReport(respawn_vpk::stats::snapshot()) << std::flush;
+		}
+	}
+
+private:
+	bool enabled = false;
+};
+
 } // namespace
 
 int main(int argc, const char* const* argv) {
@@ -553,8 +802,10 @@ int main(int argc, const char* const* argv) {
 	cli.set_assign_chars("=:");
 #endif
 
-	cli.add_description("This program currently has seven modes:\n"
+	cli.add_description("This program currently has nine modes:\n"
 	                    " - Pack:     Packs the contents of a given directory into a new pack file.\n"
+	                    " - Compact:  Reclaims unused space in the patch archive of a Respawn VPK.\n"
+	                    " - Convert:  Repacks an existing pack file into a new Respawn VPK without extracting it.\n"
 	                    " - Extract:  Extracts files from the given pack file.\n"
 	                    " - Generate: Generates files related to VPK creation, such as a public/private keypair.\n"
 	                    " - Modify:   Edits the contents of the given pack file.\n"
@@ -569,6 +820,8 @@ int main(int argc, const char* const* argv) {
 
 	cli.add_argument("path")
 		.help("(Pack)     The directory or response file to pack the contents of into a new pack file.\n"
+		      "(Compact)  The path to the Respawn _dir.vpk whose patch archive should be compacted.\n"
+		      "(Convert)  The path to the pack file to repack into a Respawn VPK.\n"
 		      "(Extract)  The path to the pack file to extract the contents of.\n"
 		      "(Generate) The name of the file(s) to generate.\n"
 		      "(Modify)   The path to the pack file to edit the contents of.\n"
@@ -597,7 +850,8 @@ int main(int argc, const char* const* argv) {
 		.nargs(1);
 
 	cli.add_argument(ARG_P(CHUNKSIZE))
-		.help("(Pack) The size of each archive in mb.")
+		.help("(Pack) The size of each archive in mb. Respawn VPKs are only split into several archives\n"
+		      "(numbered from _000) if this is given.")
 		.default_value("200")
 		.nargs(1);
 
@@ -617,6 +871,35 @@ int main(int argc, const char* const* argv) {
 		.help("(Pack) Generate MD5 hashes for each file (VPK v2, v54 only).")
 		.flag();
 
+	cli.add_argument(ARG_L(COMPRESSION_CACHE))
+		.help("(Pack) Keep compressed file parts in the given directory and reuse them on later runs,\n"
+		      "so only changed files are compressed again (Respawn VPK only). The directory can be\n"
+		      "shared by several packs running at the same time. Parts are kept in an \"rvpk-cc-v1\"\n"
+		      "subdirectory, other files in the directory are never touched.")
+		.nargs(1);
+
+	cli.add_argument(ARG_L(COMPRESSION_CACHE_SIZE))
+		.help("(Pack) The size limit of the compression cache in mb. Least recently used parts are removed first.")
+		.default_value("4096")
+		.nargs(1);
+
+	cli.add_argument(ARG_L(INCREMENTAL))
+		.help("(Pack) If the output already exists, copy files that did not change (same path, size and CRC)\n"
+		      "from it instead of compressing them again (Respawn VPK only).")
+		.flag();
+
+	cli.add_argument(ARG_L(PLACEMENT))
+		.help("(Pack) How file data is grouped in the archives: by extension (the same order as the\n"
+		      "directory tree), or by directory so files loaded together are stored together (Respawn VPK only).")
+		.default_value("ext")
+		.choices("ext", "dir")
+		.nargs(1);
+
+	cli.add_argument(ARG_L(LOAD_ORDER))
+		.help("(Pack) A text file listing file paths (one per line) in the order they are loaded. These files\n"
+		      "are stored first and in that order, the rest follow per --placement (Respawn VPK only).")
+		.nargs(1);
+
 	cli.add_argument(ARG_L(ADD_FILE))
 		.help("(Modify) Add the specified file to the pack file with the given path.")
 		.nargs(2)
@@ -637,6 +920,28 @@ int main(int argc, const char* const* argv) {
 		.nargs(1)
 		.append();
 
+	cli.add_argument(ARG_L(HARDLINK_ARCHIVES))
+		.help("(Modify) When writing a Respawn VPK to a different output directory, hard link unchanged\n"
+		      "archives instead of copying them (if a reflink is not possible). Only use this if the output\n"
+		      "will not be modified in place, since both locations then share the same data.")
+		.flag();
+
+	cli.add_argument(ARG_L(COMPACT))
+		.help("(Compact) Rewrite the patch archive (_999.vpk) of a Respawn VPK so it only contains data\n"
+		      "that is still in use, reclaiming the space of files that were replaced or removed.")
+		.flag();
+
+	cli.add_argument(ARG_L(NO_REORDER))
+		.help("(Compact) Keep the existing order of data in the patch archive instead of grouping it by directory.")
+		.flag();
+
+	cli.add_argument(ARG_L(CONVERT))
+		.help("(Convert) Repack the given pack file into a new Respawn VPK (with \"--type rvpk\") without extracting\n"
+		      "it to disk first. Files of a Respawn VPK source are copied as they are when their layout allows it.\n"
+		      "Takes the same options as packing a Respawn VPK. Without \"-o\", \"<name>_dir.vpk\" inputs are\n"
+		      "converted to \"<name>_rvpk_dir.vpk\" next to them, other inputs to \"<name>_dir.vpk\".")
+		.flag();
+
 	cli.add_argument(ARG_P(PRELOAD))
 		.help("(Pack) If a file's extension is in this list, the first kilobyte will be\n"
 		      "preloaded in the directory FPX/VPK. Full file names are also supported here\n"
@@ -670,6 +975,12 @@ int main(int argc, const char* const* argv) {
 		.help("(Preview) Prints the file tree of the given pack file to the console.")
 		.flag();
 
+	cli.add_argument(ARG_L(LIST))
+		.help("(Preview) Prints one line per entry for scripts, as JSON Lines or CSV. Can be \"jsonl\" or \"csv\" (without quotes).\n"
+		      "Respawn VPKs also list each entry's parts (archive index, offset, stored and uncompressed size, flags).")
+		.choices("jsonl", "csv")
+		.nargs(1);
+
 	cli.add_argument(ARG_P(SIGN))
 		.help("(Pack) Sign the output VPK with the key in the given private key file (v2 only).\n"
 		      "(Sign) Sign the VPK with the key in the given private key file (v2 only).");
@@ -686,6 +997,21 @@ int main(int argc, const char* const* argv) {
 	cli.add_argument(ARG_L(DECRYPTION_KEY))
 		.help("Use the specified hex sequence to decrypt a pack file. Ignored if unnecessary.");
 
+	cli.add_argument(ARG_L(TRACE))
+		.help("Record a timeline of the Respawn VPK work (scanning, reading, CRC, compression, dedup, writes)\n"
+		      "and write it to the given JSON file. Open it in chrome://tracing or ui.perfetto.dev.")
+		.nargs(1);
+
+	cli.add_argument(ARG_L(STATS))
+		.help("Print Respawn VPK I/O and codec statistics (bytes read per archive, LZHAM time, cache and dedup hits)\n"
+		      "when the command finishes.")
+		.flag();
+
+	cli.add_argument(ARG_L(MEMORY_BUDGET))
+		.help("Limit the memory the Respawn VPK code holds in large buffers, in mb. Packing and baking then keep\n"
+		      "fewer parts in flight and flush to disk sooner instead. Peaks are reported by --stats.")
+		.nargs(1);
+
 	cli.add_epilog(R"(Program details:                                               )"        "\n"
 	               R"(                    /$$                       /$$ /$$   /$$    )"        "\n"
 	               R"(                   | $$                      | $$|__/  | $$    )"        "\n"
@@ -702,9 +1028,21 @@ int main(int argc, const char* const* argv) {
 	               "Created by craftablescience. Contributors and libraries used are"          "\n"
 	               "listed in CREDITS.md. " + PROJECT_NAME_PRETTY.data() + " is licensed under the MIT License.");
 
+	TraceSession traceSession;
+	StatsReport statsReport;
 	try {
 		cli.parse_args(argc, argv);
 
+		if (cli.is_used(ARG_L(TRACE))) {
+			traceSession.start(cli.get(ARG_L(TRACE)));
+		}
+		if (cli.get<bool>(ARG_L(STATS))) {
+			statsReport.enable();
+		}
+		if (cli.is_used(ARG_L(MEMORY_BUDGET))) {
+			respawn_vpk::memory::setBudget(std::stoull(cli.get(ARG_L(MEMORY_BUDGET))) * 1024 * 1024);
+		}
+
 		std::string inputPath{cli.get("path")};
 		if (inputPath.ends_with('/') || inputPath.ends_with('\\')) {
 			inputPath.pop_back();
@@ -723,10 +1061,22 @@ int main(int argc, const char* const* argv) {
 					foundAction = true;
 					::fileTree(cli, inputPath);
 				}
+				if (cli.is_used(ARG_L(LIST))) {
+					foundAction = true;
+					::list(cli, inputPath);
+				}
 				if (cli.is_used(ARG_L(ADD_FILE)) || cli.is_used(ARG_L(ADD_DIR)) || cli.is_used(ARG_L(REMOVE_FILE)) || cli.is_used(ARG_L(REMOVE_DIR))) {
 					foundAction = true;
 					::edit(cli, inputPath);
 				}
+				if (cli.is_used(ARG_L(COMPACT))) {
+					foundAction = true;
+					::compact(cli, inputPath);
+				}
+				if (cli.is_used(ARG_L(CONVERT))) {
+					foundAction = true;
+					::convert(cli, inputPath);
+				}
 				if (cli.is_used(ARG_S(SIGN))) {
 					foundAction = true;
 					::sign(cli, inputPath);
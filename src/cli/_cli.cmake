@@ -1,14 +1,34 @@
 # Create executable
 add_executable(${PROJECT_NAME}cli
         "${CMAKE_CURRENT_LIST_DIR}/Main.cpp"
+        "${CMAKE_CURRENT_LIST_DIR}/List.cpp"
+        "${CMAKE_CURRENT_LIST_DIR}/List.h"
         "${CMAKE_CURRENT_LIST_DIR}/Tree.cpp"
         "${CMAKE_CURRENT_LIST_DIR}/Tree.h"
         "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPK.cpp"
         "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPK.h"
         "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKPack.cpp"
         "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKPack.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKCopy.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKCopy.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKCompressionCache.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKCompressionCache.h"
         "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKManifest.cpp"
-        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKManifest.h")
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKManifest.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKMemory.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKMemory.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKHash.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKHash.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKJournal.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKJournal.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKParallel.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKScan.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKScan.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKSort.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKStats.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKStats.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKTrace.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKTrace.h")
 
 vpkedit_configure_target(${PROJECT_NAME}cli)
 
@@ -20,7 +40,8 @@ target_link_libraries(
         argparse::argparse
         indicators::indicators
         sourcepp::bsppp
-        sourcepp::vpkpp)
+        sourcepp::vpkpp
+        xxhash::xxhash)
 
 if(TARGET lzham::bridge)
     target_link_libraries(${PROJECT_NAME}cli PRIVATE lzham::bridge)
@@ -32,6 +53,10 @@ if(TARGET lzham::bridge)
             "$<TARGET_FILE_DIR:${PROJECT_NAME}cli>")
 endif()
 
+if(VPKEDIT_ENABLE_TRACING)
+    target_compile_definitions(${PROJECT_NAME}cli PRIVATE VPKEDIT_HAVE_TRACING=1)
+endif()
+
 target_include_directories(
         ${PROJECT_NAME}cli PUBLIC
         "${CMAKE_CURRENT_SOURCE_DIR}/src/shared")
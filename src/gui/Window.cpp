@@ -45,9 +45,11 @@
 #include <Config.h>
 #include <RespawnVPKPack.h>
 #include <RespawnVPK.h>
+#include <RespawnVPKTrace.h>
 
 #include "dialogs/ControlsDialog.h"
 #include "dialogs/CreditsDialog.h"
+#include "dialogs/DiagnosticsDialog.h"
 #include "dialogs/EntryOptionsDialog.h"
 #include "dialogs/RevpkLogDialog.h"
 #include "dialogs/VerifyChecksumsDialog.h"
@@ -460,6 +462,27 @@ Window::Window(QWidget* parent)
 	openInEnableAction->setCheckable(true);
 	openInEnableAction->setChecked(Options::get<bool>(OPT_DISABLE_STEAM_SCANNER));
 
+	// Not saved as an option, a trace only covers what happens while it is checked
+	if (respawn_vpk::trace::isAvailable()) {
+		generalMenu->addSeparator();
+		auto* recordTraceAction = generalMenu->addAction(tr("Record Respawn VPK Trace"));
+		recordTraceAction->setCheckable(true);
+		QObject::connect(recordTraceAction, &QAction::toggled, this, [this](bool checked) {
+			if (checked) {
+				respawn_vpk::trace::start();
+				return;
+			}
+			const auto tracePath = QFileDialog::getSaveFileName(this, tr("Save Trace"), "trace.json", "Chrome Trace (*.json)");
+			if (tracePath.isEmpty()) {
+				respawn_vpk::trace::cancel();
+				return;
+			}
+			if (std::string error; !respawn_vpk::trace::stop(tracePath.toLocal8Bit().constData(), &error)) {
+				QMessageBox::critical(this, tr("Error"), QString::fromStdString(error));
+			}
+		});
+	}
+
 	auto* languageMenu = optionsMenu->addMenu(this->style()->standardIcon(QStyle::SP_DialogHelpButton), tr("Language..."));
 	auto* languageMenuGroup = new QActionGroup(languageMenu);
 	languageMenuGroup->setExclusive(true);
@@ -619,6 +642,9 @@ Window::Window(QWidget* parent)
 	helpMenu->addAction(this->style()->standardIcon(QStyle::SP_FileDialogListView), tr("Controls"), Qt::Key_F2, [this] {
 		ControlsDialog::showDialog(this);
 	});
+	helpMenu->addAction(this->style()->standardIcon(QStyle::SP_FileDialogInfoView), tr("Diagnostics..."), [this] {
+		DiagnosticsDialog::showDialog(this);
+	});
 
 #ifdef DEBUG
 	// Debug menu
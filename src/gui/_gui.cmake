@@ -4,6 +4,8 @@ add_executable(${PROJECT_NAME} WIN32 MACOSX_BUNDLE
 		"${CMAKE_CURRENT_LIST_DIR}/dialogs/ControlsDialog.h"
 		"${CMAKE_CURRENT_LIST_DIR}/dialogs/CreditsDialog.cpp"
 		"${CMAKE_CURRENT_LIST_DIR}/dialogs/CreditsDialog.h"
+		"${CMAKE_CURRENT_LIST_DIR}/dialogs/DiagnosticsDialog.cpp"
+		"${CMAKE_CURRENT_LIST_DIR}/dialogs/DiagnosticsDialog.h"
 		"${CMAKE_CURRENT_LIST_DIR}/dialogs/RevpkLogDialog.cpp"
 		"${CMAKE_CURRENT_LIST_DIR}/dialogs/RevpkLogDialog.h"
 		"${CMAKE_CURRENT_LIST_DIR}/dialogs/EntryOptionsDialog.cpp"
@@ -24,8 +26,26 @@ add_executable(${PROJECT_NAME} WIN32 MACOSX_BUNDLE
         "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPK.h"
         "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKPack.cpp"
         "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKPack.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKCopy.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKCopy.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKCompressionCache.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKCompressionCache.h"
         "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKManifest.cpp"
         "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKManifest.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKMemory.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKMemory.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKHash.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKHash.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKJournal.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKJournal.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKParallel.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKScan.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKScan.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKSort.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKStats.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKStats.h"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKTrace.cpp"
+        "${CMAKE_CURRENT_SOURCE_DIR}/src/shared/RespawnVPKTrace.h"
 
 		"${CMAKE_CURRENT_LIST_DIR}/plugins/previews/IVPKEditPreviewPlugin.cpp"
 		"${CMAKE_CURRENT_LIST_DIR}/plugins/previews/IVPKEditPreviewPlugin.h"
@@ -111,7 +131,8 @@ target_link_libraries(
         sourcepp::steampp
         sourcepp::vcryptpp
         sourcepp::vpkpp
-        sourcepp::vtfpp)
+        sourcepp::vtfpp
+        xxhash::xxhash)
 
 if(WIN32)
     # In-app audio preview via miniaudio, no Qt Multimedia dependency.
@@ -119,6 +140,10 @@ if(WIN32)
     target_link_libraries(${PROJECT_NAME} PRIVATE winmm ole32 avrt)
 endif()
 
+if(VPKEDIT_ENABLE_TRACING)
+    target_compile_definitions(${PROJECT_NAME} PRIVATE VPKEDIT_HAVE_TRACING=1)
+endif()
+
 if(TARGET lzham::bridge)
     target_link_libraries(${PROJECT_NAME} PRIVATE lzham::bridge)
     target_compile_definitions(${PROJECT_NAME} PRIVATE VPKEDIT_HAVE_LZHAM=1)
@@ -0,0 +1,62 @@
+#include "DiagnosticsDialog.h"
+
+#include <QFontDatabase>
+#include <QHBoxLayout>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+#include <RespawnVPKStats.h>
+
+DiagnosticsDialog::DiagnosticsDialog(QWidget* parent)
+		: QDialog(parent)
+		, report(new QPlainTextEdit(this)) {
+	this->setModal(true);
+	this->setWindowTitle(tr("Diagnostics"));
+	this->resize(700, 300);
+
+	this->report->setReadOnly(true);
+	this->report->setWordWrapMode(QTextOption::NoWrap);
+	this->report->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+	auto* refreshButton = new QPushButton(tr("Refresh"), this);
+	auto* resetButton = new QPushButton(tr("Reset"), this);
+	auto* copyButton = new QPushButton(tr("Copy"), this);
+	auto* closeButton = new QPushButton(tr("Close"), this);
+
+	QObject::connect(refreshButton, &QPushButton::clicked, this, [this] {
+		this->refresh();
+	});
+	QObject::connect(resetButton, &QPushButton::clicked, this, [this] {
+		respawn_vpk::stats::reset();
+		this->refresh();
+	});
+	QObject::connect(copyButton, &QPushButton::clicked, this, [this] {
+		this->report->selectAll();
+		this->report->copy();
+	});
+	QObject::connect(closeButton, &QPushButton::clicked, this, &QDialog::accept);
+
+	auto* buttonRow = new QHBoxLayout();
+	buttonRow->addWidget(refreshButton);
+	buttonRow->addWidget(resetButton);
+	buttonRow->addWidget(copyButton);
+	buttonRow->addStretch(1);
+	buttonRow->addWidget(closeButton);
+
+	auto* layout = new QVBoxLayout(this);
+	layout->addWidget(this->report, 1);
+	layout->addLayout(buttonRow);
+
+	this->refresh();
+}
+
+void DiagnosticsDialog::showDialog(QWidget* parent) {
+	auto* dialog = new DiagnosticsDialog(parent);
+	dialog->exec();
+	dialog->deleteLater();
+}
+
+void DiagnosticsDialog::refresh() {
+	this->report->setPlainText(QString::fromStdString(respawn_vpk::stats::formatReport(respawn_vpk::stats::snapshot())));
+}
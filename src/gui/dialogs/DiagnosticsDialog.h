@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QDialog>
+
+class QPlainTextEdit;
+
+// Shows the Respawn VPK I/O and codec counters, the same report the CLI prints with --stats
+class DiagnosticsDialog : public QDialog {
+	Q_OBJECT;
+
+public:
+	explicit DiagnosticsDialog(QWidget* parent = nullptr);
+
+	static void showDialog(QWidget* parent = nullptr);
+
+private:
+	void refresh();
+
+	QPlainTextEdit* report;
+};
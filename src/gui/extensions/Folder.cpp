@@ -3,20 +3,34 @@
 #include <algorithm>
 #include <cctype>
 #include <filesystem>
+#include <string_view>
+#include <unordered_set>
 
 #include <sourcepp/FS.h>
 
+#include <RespawnVPKScan.h>
+
 using namespace sourcepp;
 using namespace vpkpp;
 
-static bool shouldHideVpkInFolderView(const std::filesystem::path& p)
+static std::string toLowerCopy(std::string_view s)
+{
+    std::string out{s};
+    std::transform(out.begin(), out.end(), out.begin(),
+        [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+    return out;
+}
+
+// dirVpkPaths: lowercase relative paths of every `_dir.vpk` in the folder, so siblings are looked up instead of stat'ed
+static bool shouldHideVpkInFolderView(const respawn_vpk::ScannedFile& file, const std::unordered_set<std::string>& dirVpkPaths)
 {
-    if (p.extension() != ".vpk")
+    const std::string relativePath = toLowerCopy(file.relativePath);
+    if (!relativePath.ends_with(".vpk"))
         return false;
 
-    std::string name = p.filename().string();
-    std::transform(name.begin(), name.end(), name.begin(),
-        [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+    const auto slash = relativePath.find_last_of('/');
+    const std::string parent = slash == std::string::npos ? std::string{} : relativePath.substr(0, slash + 1);
+    const std::string name = relativePath.substr(parent.size());
 
     // Source-engine "multi-part" VPKs: `pak01_dir.vpk` + `pak01_000.vpk`, `pak01_001.vpk`
     // Hide the numbered part files when the corresponding `_dir.vpk` exists beside them
@@ -30,9 +44,7 @@ static bool shouldHideVpkInFolderView(const std::filesystem::path& p)
                 const bool allDigits = !suffix.empty() && std::all_of(suffix.begin(), suffix.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
                 if (allDigits && suffix.size() == 3) {
                     const std::string baseStem = stem.substr(0, us);
-                    std::error_code ec;
-                    const auto siblingDir = p.parent_path() / (baseStem + "_dir.vpk");
-                    if (std::filesystem::exists(siblingDir, ec) && !ec) {
+                    if (dirVpkPaths.contains(parent + baseStem + "_dir.vpk")) {
                         return true;
                     }
                 }
@@ -60,26 +72,23 @@ std::unique_ptr<PackFile> Folder::open(const std::string& path, const EntryCallb
 	auto* folder = new Folder{path};
 	std::unique_ptr<PackFile> packFile{folder};
 
-	std::error_code ec;
-	for (const auto& dirEntry : std::filesystem::recursive_directory_iterator{ path, std::filesystem::directory_options::skip_permission_denied, ec })
-	{
-		if (!dirEntry.is_regular_file(ec)) {
-			continue;
-		}
-		ec.clear();
-
-		if (shouldHideVpkInFolderView(dirEntry.path())) {
-			continue;
+	// One parallel pass collects paths and sizes; the `_dir.vpk` set replaces a stat per numbered archive
+	const auto files = respawn_vpk::scanDirectory(path);
+	std::unordered_set<std::string> dirVpkPaths;
+	for (const auto& file : files) {
+		if (auto relativePath = toLowerCopy(file.relativePath); relativePath.ends_with("_dir.vpk")) {
+			dirVpkPaths.insert(std::move(relativePath));
 		}
+	}
 
-		auto entryPath = std::filesystem::relative(dirEntry.path(), path, ec).string();
-		if (ec || entryPath.empty()) {
+	for (const auto& file : files) {
+		if (file.relativePath.empty() || shouldHideVpkInFolderView(file, dirVpkPaths)) {
 			continue;
 		}
 
 		Entry entry = createNewEntry();
-		entry.length = std::filesystem::file_size(dirEntry.path(), ec);
-		folder->entries.insert(folder->cleanEntryPath(entryPath), entry);
+		entry.length = file.size;
+		folder->entries.insert(folder->cleanEntryPath(file.relativePath), entry);
 	}
 
 	return packFile;
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <array>
 #include <cctype>
+#include <chrono>
 #include <cstdio>
 #include <cstddef>
 #include <cstring>
@@ -19,7 +20,14 @@
 #include <sourcepp/String.h>
 #include <sourcepp/crypto/CRC32.h>
 
+#include "RespawnVPKHash.h"
+#include "RespawnVPKJournal.h"
 #include "RespawnVPKManifest.h"
+#include "RespawnVPKMemory.h"
+#include "RespawnVPKParallel.h"
+#include "RespawnVPKSort.h"
+#include "RespawnVPKStats.h"
+#include "RespawnVPKTrace.h"
 
 #ifdef VPKEDIT_HAVE_LZHAM
 #include <lzham_bridge.h>
@@ -105,6 +113,120 @@ struct WriteBuffer {
 	}
 };
 
+// Streams new part data into the patch archive while baking
+// Writes are staged in a buffer bounded by the bake memory budget, so written data never has to stay in memory
+class PatchArchiveWriter {
+public:
+	PatchArchiveWriter(std::string path_, bool append_, std::size_t stagingLimit_)
+			: path(std::move(path_))
+			, append(append_)
+			, stagingLimit(std::max<std::size_t>(stagingLimit_, 64 * 1024)) {}
+
+	PatchArchiveWriter(const PatchArchiveWriter&) = delete;
+	PatchArchiveWriter& operator=(const PatchArchiveWriter&) = delete;
+
+	[[nodiscard]] bool open(std::uint64_t expectedSize) {
+		auto mode = std::ios::binary | std::ios::in | std::ios::out;
+		if (!this->append) {
+			mode |= std::ios::trunc;
+		} else {
+			std::error_code ec;
+			if (!std::filesystem::is_regular_file(this->path, ec)) {
+				// std::fstream will not create a file in in|out mode without trunc
+				std::ofstream create{this->path, std::ios::binary};
+				if (!create) {
+					return false;
+				}
+			}
+		}
+		this->f.open(this->path, mode);
+		if (!this->f) {
+			return false;
+		}
+		this->f.seekp(0, std::ios::end);
+		const auto endPos = this->f.tellp();
+		if (endPos < 0) {
+			return false;
+		}
+		this->flushedSize = static_cast<std::uint64_t>(endPos);
+		// The caller computed offsets from the file size it saw, so they must agree
+		return !this->append || this->flushedSize == expectedSize;
+	}
+
+	[[nodiscard]] bool isOpen() const {
+		return this->f.is_open();
+	}
+
+	[[nodiscard]] std::uint64_t size() const {
+		return this->flushedSize + this->staging.size();
+	}
+
+	[[nodiscard]] std::uint64_t bytesAppended() const {
+		return this->appended;
+	}
+
+	[[nodiscard]] bool write(std::span<const std::byte> data) {
+		// Also flush early when the process-wide memory budget is tight, instead of growing the staging buffer
+		if ((this->staging.size() + data.size() > this->stagingLimit || !respawn_vpk::memory::fits(data.size())) && !this->flush()) {
+			return false;
+		}
+		if (data.size() >= this->stagingLimit) {
+			// Large parts bypass the staging buffer entirely
+			this->f.seekp(static_cast<std::streamoff>(this->flushedSize), std::ios::beg);
+			this->f.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+			if (!this->f) {
+				return false;
+			}
+			respawn_vpk::stats::addWrite(data.size(), 2);
+			this->flushedSize += data.size();
+		} else {
+			this->staging.insert(this->staging.end(), data.begin(), data.end());
+			this->stagingCharge.set(this->staging.size());
+		}
+		this->appended += data.size();
+		return true;
+	}
+
+	[[nodiscard]] bool flush() {
+		if (this->staging.empty()) {
+			return true;
+		}
+		this->f.seekp(static_cast<std::streamoff>(this->flushedSize), std::ios::beg);
+		this->f.write(reinterpret_cast<const char*>(this->staging.data()), static_cast<std::streamsize>(this->staging.size()));
+		if (!this->f) {
+			return false;
+		}
+		respawn_vpk::stats::addWrite(this->staging.size(), 2);
+		this->flushedSize += this->staging.size();
+		this->staging.clear();
+		this->stagingCharge.set(0);
+		return true;
+	}
+
+	[[nodiscard]] bool close() {
+		if (!this->f.is_open()) {
+			return true;
+		}
+		const bool ok = this->flush() && static_cast<bool>(this->f.flush());
+		this->f.close();
+		return ok;
+	}
+
+	[[nodiscard]] const std::string& getPath() const {
+		return this->path;
+	}
+
+private:
+	std::string path;
+	bool append;
+	std::size_t stagingLimit;
+	std::fstream f;
+	std::uint64_t flushedSize = 0;
+	std::uint64_t appended = 0;
+	std::vector<std::byte> staging;
+	respawn_vpk::memory::Charge stagingCharge;
+};
+
 static std::optional<CamEntry> tryMakeCamEntry(const std::vector<std::byte>& wavFile, const std::string& path) {
 	if (wavFile.size() < 44) {
 		return std::nullopt;
@@ -161,7 +283,15 @@ static void stripWavHeaderInPlace(std::vector<std::byte>& file) {
 } // namespace
 
 std::unique_ptr<PackFile> RespawnVPK::open(const std::string& path, const EntryCallback& callback) {
+	RESPAWN_VPK_TRACE_SCOPE("open");
+	const respawn_vpk::memory::OperationScope memoryScope{respawn_vpk::memory::Operation::OPEN};
 	(void) callback;
+
+	// Finish or undo an interrupted bake first, otherwise the dir tree may not match its archives
+	if (!respawn_vpk::recoverInterruptedBake(path)) {
+		return nullptr;
+	}
+
 	std::error_code ec;
 	if (!std::filesystem::is_regular_file(path, ec)) {
 		return nullptr;
@@ -284,11 +414,14 @@ std::unique_ptr<PackFile> RespawnVPK::open(const std::string& path, const EntryC
 			}
 		}
 	}
+	vpk->updateMetaEntriesCharge();
 
 	return packFile;
 }
 
 std::optional<std::vector<std::byte>> RespawnVPK::readEntry(const std::string& path_) const {
+	RESPAWN_VPK_TRACE_SCOPE("readEntry");
+	const respawn_vpk::memory::OperationScope memoryScope{respawn_vpk::memory::Operation::READ};
 	this->lastError.clear();
 
 	const auto cleanPath = this->cleanEntryPath(path_);
@@ -314,6 +447,8 @@ std::optional<std::vector<std::byte>> RespawnVPK::readEntry(const std::string& p
 	constexpr std::uint64_t MAX_PART_UNCOMPRESSED = 512ull * 1024ull * 1024ull;
 
 	std::vector<std::byte> out;
+	// Only while it is filled, the caller owns it afterwards
+	respawn_vpk::memory::Charge outCharge;
 	{
 		std::uint64_t total = 0;
 		total += meta.preloadBytes;
@@ -338,6 +473,7 @@ std::optional<std::vector<std::byte>> RespawnVPK::readEntry(const std::string& p
 			this->lastError = "failed to allocate output buffer for entry";
 			return std::nullopt;
 		}
+		outCharge.set(total);
 	}
 
 	// Preload bytes are stored inline in the directory VPK.
@@ -347,6 +483,7 @@ std::optional<std::vector<std::byte>> RespawnVPK::readEntry(const std::string& p
 			this->lastError = "failed to read preload bytes from directory VPK";
 			return std::nullopt;
 		}
+		respawn_vpk::stats::addArchiveRead(respawn_vpk::stats::DIR_VPK_INDEX, preload->size());
 		out.insert(out.end(), preload->begin(), preload->end());
 	}
 
@@ -357,6 +494,7 @@ std::optional<std::vector<std::byte>> RespawnVPK::readEntry(const std::string& p
 			this->lastError = "failed to read archive part from: " + archivePath;
 			return std::nullopt;
 		}
+		respawn_vpk::stats::addArchiveRead(part.archiveIndex, compressed->size());
 
 		if (!part.isCompressed()) {
 			out.insert(out.end(), compressed->begin(), compressed->end());
@@ -381,6 +519,8 @@ std::optional<std::vector<std::byte>> RespawnVPK::readEntry(const std::string& p
 }
 
 bool RespawnVPK::extractEntryToFile(const std::string& entryPath, const std::string& filepath, std::string* outError) const {
+	RESPAWN_VPK_TRACE_SCOPE("extract");
+	const respawn_vpk::memory::OperationScope memoryScope{respawn_vpk::memory::Operation::READ};
 	this->lastError.clear();
 
 	const auto cleanPath = this->cleanEntryPath(entryPath);
@@ -418,7 +558,7 @@ bool RespawnVPK::extractEntryToFile(const std::string& entryPath, const std::str
 		return false;
 	}
 
-	auto streamCopyRange = [&](const std::string& srcPath, std::uint64_t offset, std::uint64_t length) -> bool {
+	auto streamCopyRange = [&](const std::string& srcPath, std::size_t archiveIndex, std::uint64_t offset, std::uint64_t length) -> bool {
 		std::ifstream f{srcPath, std::ios::binary};
 		if (!f) {
 			this->lastError = "failed to open archive file: " + srcPath;
@@ -440,6 +580,8 @@ bool RespawnVPK::extractEntryToFile(const std::string& entryPath, const std::str
 			this->lastError = "failed to seek archive file: " + srcPath;
 			return false;
 		}
+		// Open and the two seeks
+		respawn_vpk::stats::addRead(0, 3);
 
 		// do NOT use a large stack buffer here; this runs on a QT worker thread
 		// A big stack allocation will hard-crash with stack overflow
@@ -453,6 +595,9 @@ bool RespawnVPK::extractEntryToFile(const std::string& entryPath, const std::str
 				this->lastError = "failed to read archive bytes from: " + srcPath;
 				return false;
 			}
+			respawn_vpk::stats::addRead(chunk);
+			respawn_vpk::stats::addArchiveRead(archiveIndex, chunk);
+			respawn_vpk::stats::addWrite(chunk);
 			out.write(std::span<const std::byte>{reinterpret_cast<const std::byte*>(buf.data()), chunk});
 			remaining -= chunk;
 		}
@@ -461,7 +606,7 @@ bool RespawnVPK::extractEntryToFile(const std::string& entryPath, const std::str
 
 	// Preload bytes (if any) are stored inline in the directory VPK and must be written first.
 	if (meta.preloadBytes) {
-		if (!streamCopyRange(std::string{this->fullFilePath}, meta.preloadOffset, meta.preloadBytes)) {
+		if (!streamCopyRange(std::string{this->fullFilePath}, respawn_vpk::stats::DIR_VPK_INDEX, meta.preloadOffset, meta.preloadBytes)) {
 			if (outError) *outError = this->lastError;
 			return false;
 		}
@@ -471,7 +616,7 @@ bool RespawnVPK::extractEntryToFile(const std::string& entryPath, const std::str
 		const auto archivePath = RespawnVPK::buildArchivePath(std::string{this->fullFilePath}, part.archiveIndex);
 
 		if (!part.isCompressed()) {
-			if (!streamCopyRange(archivePath, part.entryOffset, part.entryLength)) {
+			if (!streamCopyRange(archivePath, part.archiveIndex, part.entryOffset, part.entryLength)) {
 				if (outError) *outError = this->lastError;
 				return false;
 			}
@@ -481,12 +626,14 @@ bool RespawnVPK::extractEntryToFile(const std::string& entryPath, const std::str
 #ifdef VPKEDIT_HAVE_LZHAM
 		// For compressed parts we still need a contiguous input/output buffer for LZHAM
 		// This is usually fine because parts are typically small; this avoids allocating the full entry
+		const respawn_vpk::memory::Charge partCharge{part.entryLength + part.entryLengthUncompressed};
 		const auto compressed = RespawnVPK::readFileRange(archivePath, part.entryOffset, static_cast<std::size_t>(part.entryLength));
 		if (!compressed) {
 			this->lastError = "failed to read archive part from: " + archivePath;
 			if (outError) *outError = this->lastError;
 			return false;
 		}
+		respawn_vpk::stats::addArchiveRead(part.archiveIndex, compressed->size());
 
 		const auto decompressed = RespawnVPK::lzhamDecompress(compressed->data(), compressed->size(), static_cast<std::size_t>(part.entryLengthUncompressed));
 		if (!decompressed) {
@@ -495,6 +642,7 @@ bool RespawnVPK::extractEntryToFile(const std::string& entryPath, const std::str
 			return false;
 		}
 
+		respawn_vpk::stats::addWrite(decompressed->size());
 		out.write(std::span<const std::byte>{decompressed->data(), decompressed->size()});
 #else
 		this->lastError = "this entry is LZHAM compressed, but vpkedit was built without LZHAM support";
@@ -506,6 +654,46 @@ bool RespawnVPK::extractEntryToFile(const std::string& entryPath, const std::str
 	return true;
 }
 
+std::optional<RespawnVPK::StoredEntry> RespawnVPK::getStoredEntry(const std::string& path_, bool withArchivePaths) const {
+	const auto cleanPath = this->cleanEntryPath(path_);
+	if (const auto entry = this->findEntry(cleanPath, true); !entry || entry->unbaked) {
+		return std::nullopt;
+	}
+	const auto metaIt = this->metaEntries.find(cleanPath);
+	if (metaIt == this->metaEntries.end()) {
+		return std::nullopt;
+	}
+
+	StoredEntry out;
+	out.crc32 = metaIt->second.crc32;
+	out.preloadBytes = metaIt->second.preloadBytes;
+	out.parts.reserve(metaIt->second.parts.size());
+	for (const auto& part : metaIt->second.parts) {
+		out.parts.push_back({
+			withArchivePaths ? this->getStoredArchivePath(part.archiveIndex) : std::string{},
+			part.entryOffset,
+			part.entryLength,
+			part.entryLengthUncompressed,
+			part.archiveIndex,
+			part.loadFlags,
+			part.textureFlags,
+		});
+	}
+	return out;
+}
+
+std::map<std::uint16_t, std::string> RespawnVPK::getStoredArchivePaths() const {
+	std::map<std::uint16_t, std::string> out;
+	for (const auto& [path, meta] : this->metaEntries) {
+		for (const auto& part : meta.parts) {
+			if (!out.contains(part.archiveIndex)) {
+				out.emplace(part.archiveIndex, this->getStoredArchivePath(part.archiveIndex));
+			}
+		}
+	}
+	return out;
+}
+
 Attribute RespawnVPK::getSupportedEntryAttributes() const {
 	using enum Attribute;
 	return LENGTH | VPK_PRELOADED_DATA | ARCHIVE_INDEX | CRC32;
@@ -707,7 +895,10 @@ std::string RespawnVPK::makeArchivePathForWrite(const std::string& dirVpkPath, s
 }
 
 std::vector<std::byte> RespawnVPK::lzhamCompress(const std::byte* src, std::size_t srcLen) {
+	RESPAWN_VPK_TRACE_SCOPE("lzham.compress");
 #ifdef VPKEDIT_HAVE_LZHAM
+	auto& counters = respawn_vpk::stats::get();
+	const respawn_vpk::stats::Timer timer{counters.compressNs};
 	std::vector<std::byte> out(std::max<std::size_t>(srcLen, 1));
 	for (int tries = 0; tries < 6; tries++) {
 		size_t outLen = out.size();
@@ -717,6 +908,9 @@ std::vector<std::byte> RespawnVPK::lzhamCompress(const std::byte* src, std::size
 
 		if (rc == 0) {
 			out.resize(outLen);
+			respawn_vpk::stats::add(counters.partsCompressed);
+			respawn_vpk::stats::add(counters.compressInputBytes, srcLen);
+			respawn_vpk::stats::add(counters.compressOutputBytes, outLen);
 			return out;
 		}
 		if (rc == 3) {
@@ -736,15 +930,34 @@ std::vector<std::byte> RespawnVPK::lzhamCompress(const std::byte* src, std::size
 }
 
 bool RespawnVPK::bake(const std::string& outputDir_, vpkpp::BakeOptions, const EntryCallback& callback) {
+	RESPAWN_VPK_TRACE_SCOPE("bake");
+	const respawn_vpk::memory::OperationScope memoryScope{respawn_vpk::memory::Operation::BAKE};
 	this->lastError.clear();
+	this->lastBakeStats = {};
 
 	// Respawn VPKs write updated *_dir.vpk and (optionally) a patch archive *_999.vpk with modified/new files
 	const std::string outputDir = this->getBakeOutputDir(outputDir_);
 	const std::string outDirVpkPath = outputDir + '/' + this->getFilename();
 
+	// Held until the bake returns, so no other writer (or a reader's recovery) touches these files meanwhile
+	respawn_vpk::BakeLock bakeLock;
+	if (!bakeLock.tryLock(outDirVpkPath, &this->lastError)) {
+		return false;
+	}
+
+	// A previous bake into the same location may have been interrupted, finish or undo it before reading anything
+	if (!respawn_vpk::recoverInterruptedBake(bakeLock, &this->lastError)) {
+		return false;
+	}
+
 	// Load manifest (optional); used to determine flags and packing knobs per entry
 	const auto manifestOpt = respawn_vpk::readManifestForDirVpkPath(std::filesystem::path{outDirVpkPath});
-	const respawn_vpk::ManifestMap* manifest = manifestOpt ? &*manifestOpt : nullptr;
+	const respawn_vpk::Manifest* manifest = manifestOpt ? &*manifestOpt : nullptr;
+
+	// Renames, removals and manifest flag edits leave every stored byte where it is, only the dir tree changes
+	if (this->unbakedEntries.empty()) {
+		return this->bakeMetadataOnly(outputDir, outDirVpkPath, bakeLock, manifest, callback);
+	}
 
 	// Collect entries: baked first, then unbaked overrides if same key
 	struct Item {
@@ -765,26 +978,17 @@ bool RespawnVPK::bake(const std::string& outputDir_, vpkpp::BakeOptions, const E
 		}
 	}
 
-	struct TreeItem {
-		std::string path;
-		std::string ext;
-		std::string dir;
-		std::string fileStem;
-		MetaEntry meta;
-		bool inPatchArchive = false;
-	};
-
 	std::vector<TreeItem> treeItems;
 	treeItems.reserve(items.size());
 
 	constexpr std::uint16_t PATCH_ARCHIVE_INDEX = 999;
 
-	std::vector<std::byte> patchArchive;
 	std::vector<CamEntry> patchCams;
 
 	// Deduplicate new patch data globally across this bake, matching revpk behavior at a coarse level
-	// Key is (crc32 << 32) | size, values are absolute file offsets into the patch archive
-	std::unordered_map<std::uint64_t, std::vector<std::uint64_t>> patchDedup;
+	// Key is the 128-bit hash of the stored part bytes, values are absolute file offsets into the patch archive
+	// Nothing has to be read back or kept in memory to confirm a match
+	std::unordered_map<respawn_vpk::ContentHash, std::uint64_t, respawn_vpk::ContentHashHasher> patchDedup;
 	patchDedup.reserve(1024);
 
 	std::unordered_set<std::uint16_t> referencedArchives;
@@ -801,7 +1005,8 @@ bool RespawnVPK::bake(const std::string& outputDir_, vpkpp::BakeOptions, const E
 		if (metaIt == this->metaEntries.end()) {
 			continue;
 		}
-		if (metaIt->second.archiveIndex == PATCH_ARCHIVE_INDEX) {
+		// MetaEntry::archiveIndex is not populated by open(), the parts are authoritative
+		if (std::any_of(metaIt->second.parts.begin(), metaIt->second.parts.end(), [](const FilePart& p) { return p.archiveIndex == PATCH_ARCHIVE_INDEX; })) {
 			preserveExistingPatchArchive = true;
 			break;
 		}
@@ -819,15 +1024,10 @@ bool RespawnVPK::bake(const std::string& outputDir_, vpkpp::BakeOptions, const E
 		std::filesystem::create_directories(std::filesystem::path{dstPatchArchivePath}.parent_path(), ec);
 
 		if (!outputDir.empty()) {
-			ec.clear();
-			if (std::filesystem::is_regular_file(srcPatchArchivePath, ec)) {
-				ec.clear();
-				std::filesystem::copy_file(srcPatchArchivePath, dstPatchArchivePath, std::filesystem::copy_options::overwrite_existing, ec);
-			}
-			ec.clear();
-			if (std::filesystem::is_regular_file(srcPatchCamPath, ec)) {
-				ec.clear();
-				std::filesystem::copy_file(srcPatchCamPath, dstPatchCamPath, std::filesystem::copy_options::overwrite_existing, ec);
+			// Never hard link these: new data and cam records are appended to them below
+			// Nothing is journaled yet and a failed carry-over leaves the destination as it was, so just stop
+			if (!this->carryOverArchiveFile(srcPatchArchivePath, dstPatchArchivePath, false) || !this->carryOverArchiveFile(srcPatchCamPath, dstPatchCamPath, false)) {
+				return false;
 			}
 		}
 
@@ -837,91 +1037,231 @@ bool RespawnVPK::bake(const std::string& outputDir_, vpkpp::BakeOptions, const E
 		}
 	}
 
+	// Crash safety: a preserved patch archive (and its .cam) is appended to in place, with its current length recorded
+	// in the journal; everything else is written to a temp file that replaces the real one only once all data is synced
+	const auto journalPath = respawn_vpk::getBakeJournalPath(outDirVpkPath);
+	const auto tmpPatchArchivePath = dstPatchArchivePath + ".tmp";
+	const auto tmpPatchCamPath = dstPatchCamPath + ".tmp";
+	const auto tmpDirVpkPath = outDirVpkPath + ".tmp";
+	const auto& patchWritePath = preserveExistingPatchArchive ? dstPatchArchivePath : tmpPatchArchivePath;
+	const auto& patchCamWritePath = preserveExistingPatchArchive ? dstPatchCamPath : tmpPatchCamPath;
+
+	respawn_vpk::BakeJournal journal;
+	if (preserveExistingPatchArchive) {
+		// A file that isn't there yet is removed on rollback, truncating it would leave an empty file behind
+		for (const auto& path : {dstPatchArchivePath, dstPatchCamPath}) {
+			std::error_code ec;
+			if (const auto size = std::filesystem::file_size(path, ec); !ec) {
+				journal.appends.emplace_back(path, size);
+			} else {
+				journal.creates.push_back(path);
+			}
+		}
+	} else {
+		journal.renames.emplace_back(tmpPatchArchivePath, dstPatchArchivePath);
+		journal.renames.emplace_back(tmpPatchCamPath, dstPatchCamPath);
+	}
+	// The dir VPK goes last, it is what makes the new data reachable
+	journal.renames.emplace_back(tmpDirVpkPath, outDirVpkPath);
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(std::filesystem::path{outDirVpkPath}.parent_path(), ec);
+		for (const auto& [tmpPath, finalPath] : journal.renames) {
+			std::filesystem::remove(tmpPath, ec);
+		}
+	}
+	if (!respawn_vpk::writeBakeJournal(journalPath, journal, &this->lastError)) {
+		return false;
+	}
+	respawn_vpk::BakeRollbackGuard rollbackGuard{journalPath, journal};
+
+	// New part data is streamed straight to the patch archive; the file is only opened (and possibly created)
+	// once the first unbaked part is actually written
+	PatchArchiveWriter patchWriter{patchWritePath, preserveExistingPatchArchive, this->bakeMemoryBudget};
+	auto writePatchPart = [&](std::span<const std::byte> partData, std::uint64_t& outOffset) -> bool {
+		if (!patchWriter.isOpen()) {
+			std::error_code ec;
+			std::filesystem::create_directories(std::filesystem::path{patchWritePath}.parent_path(), ec);
+			if (!patchWriter.open(patchOffset)) {
+				this->lastError = "failed to open patch archive for write: " + patchWritePath;
+				return false;
+			}
+		}
+		outOffset = patchWriter.size();
+		if (!patchWriter.write(partData)) {
+			this->lastError = "failed to write patch archive: " + patchWritePath;
+			return false;
+		}
+		return true;
+	};
+
+	std::vector<std::pair<const std::string*, const vpkpp::Entry*>> unbakedItems;
 	for (auto& [path, item] : items) {
 		if (!item.entry) {
 			continue;
 		}
+		if (item.unbaked) {
+			unbakedItems.emplace_back(&path, item.entry);
+			continue;
+		}
 
-		TreeItem out;
-		out.path = path;
+		TreeItem out = makeTreeItem(path);
 
-		const auto fsPath = std::filesystem::path{path};
-		const auto extLower = ::getExtensionLower(path);
-		const auto filename = fsPath.filename().string();
-		std::string dir = fsPath.parent_path().string();
-		sourcepp::string::normalizeSlashes(dir, true, true);
+		const auto metaIt = this->metaEntries.find(path);
+		if (metaIt == this->metaEntries.end()) {
+			this->lastError = "missing Respawn metadata for baked entry: " + path;
+			return false;
+		}
+		out.meta = metaIt->second;
 
-		out.ext = extLower.empty() ? " " : extLower;
-		out.dir = dir.empty() ? " " : dir;
-		if (out.ext == " ") {
-			out.fileStem = filename;
-		} else {
-			out.fileStem = fsPath.stem().string();
+		// If a manifest exists, it is authoritative for flags
+		// Its preloadSize is not applied: the parts already hold the data after the stored preload bytes, a different
+		// count would need the data moved between the dir VPK and the archives
+		if (manifest) {
+			if (const auto* values = manifest->find(respawn_vpk::normalizeManifestPath(path))) {
+				for (auto& p : out.meta.parts) {
+					p.loadFlags = values->loadFlags;
+					p.textureFlags = values->textureFlags;
+				}
+			}
 		}
 
-		if (!item.unbaked) {
-			const auto metaIt = this->metaEntries.find(path);
-			if (metaIt == this->metaEntries.end()) {
-				this->lastError = "missing Respawn metadata for baked entry: " + path;
-				return false;
+		for (const auto& p : out.meta.parts) {
+			referencedArchives.insert(p.archiveIndex);
+		}
+		treeItems.push_back(std::move(out));
+	}
+
+	// Unbaked entries are encoded in two stages:
+	// - encode (parallel): read, WAV/cam handling, CRC, part splitting and compression
+	// - layout (serial): dedup and patch archive writes in sorted path order
+	// Only the layout stage assigns offsets, so the output is identical regardless of thread count
+	std::sort(unbakedItems.begin(), unbakedItems.end(), [](const auto& a, const auto& b) {
+		return *a.first < *b.first;
+	});
+
+	struct EncodedPart {
+		FilePart part;
+		respawn_vpk::ContentHash dedupKey;
+		// Stored parts point into EncodedEntry::file, compressed parts own their bytes
+		std::size_t fileOffset = 0;
+		std::vector<std::byte> compressed;
+	};
+	struct EncodedEntry {
+		TreeItem item;
+		std::vector<std::byte> file;
+		std::vector<EncodedPart> parts;
+		std::optional<CamEntry> cam;
+		bool deDuplicate = true;
+		// Content already exists in one of the archives we keep, parts point at it instead of new data
+		bool reusesExistingData = false;
+
+		[[nodiscard]] std::span<const std::byte> partBytes(const EncodedPart& p) const {
+			if (p.part.entryLength != p.part.entryLengthUncompressed) {
+				return p.compressed;
 			}
-			out.meta = metaIt->second;
-
-			// If a manifest exists, it is authoritative for flags and preloadSize
-			if (manifest) {
-				const auto mkey = respawn_vpk::normalizeManifestPath(path);
-				if (const auto it = manifest->find(mkey); it != manifest->end()) {
-					out.meta.preloadBytes = it->second.preloadSize;
-					for (auto& p : out.meta.parts) {
-						p.loadFlags = it->second.loadFlags;
-						p.textureFlags = it->second.textureFlags;
-					}
+			return std::span<const std::byte>{this->file}.subspan(p.fileOffset, static_cast<std::size_t>(p.part.entryLength));
+		}
+	};
+
+	// Content index of the data already stored in the archives that survive this bake, keyed by (crc32 << 32) | size
+	// The entry CRC and length are already known from the dir tree, so building it needs no archive I/O
+	// Candidates are verified against the stored bytes before being reused
+	std::unordered_map<std::uint64_t, std::vector<std::pair<const std::string*, const MetaEntry*>>> existingContent;
+	if (!unbakedItems.empty()) {
+		existingContent.reserve(this->metaEntries.size());
+		for (const auto& [path, meta] : this->metaEntries) {
+			if (meta.preloadBytes || meta.parts.empty()) {
+				continue;
+			}
+			std::uint64_t size = 0;
+			bool usable = true;
+			for (const auto& p : meta.parts) {
+				// Without a preserved patch archive, its current contents are about to be replaced
+				if (p.archiveIndex == PATCH_ARCHIVE_INDEX && !preserveExistingPatchArchive) {
+					usable = false;
+					break;
 				}
+				size += p.entryLengthUncompressed;
 			}
+			if (!usable || !size) {
+				continue;
+			}
+			existingContent[(static_cast<std::uint64_t>(meta.crc32) << 32) | (size & 0xFFFFFFFFu)].emplace_back(&path, &meta);
+		}
+	}
 
-			for (const auto& p : out.meta.parts) {
-				referencedArchives.insert(p.archiveIndex);
+	auto existingDataMatches = [this](const MetaEntry& meta, std::span<const std::byte> file) -> bool {
+		RESPAWN_VPK_TRACE_SCOPE("bake.verifyExisting");
+		std::uint64_t fileOff = 0;
+		for (const auto& p : meta.parts) {
+			if (fileOff + p.entryLengthUncompressed > file.size()) {
+				return false;
 			}
-			treeItems.push_back(std::move(out));
-			continue;
+			const auto archivePath = RespawnVPK::buildArchivePath(std::string{this->fullFilePath}, p.archiveIndex);
+			const auto stored = RespawnVPK::readFileRange(archivePath, p.entryOffset, static_cast<std::size_t>(p.entryLength));
+			if (!stored) {
+				return false;
+			}
+			const auto expected = file.subspan(static_cast<std::size_t>(fileOff), static_cast<std::size_t>(p.entryLengthUncompressed));
+			if (!p.isCompressed()) {
+				if (stored->size() != expected.size() || std::memcmp(stored->data(), expected.data(), expected.size()) != 0) {
+					return false;
+				}
+			} else {
+				const auto decompressed = RespawnVPK::lzhamDecompress(stored->data(), stored->size(), static_cast<std::size_t>(p.entryLengthUncompressed));
+				if (!decompressed || decompressed->size() != expected.size() || std::memcmp(decompressed->data(), expected.data(), expected.size()) != 0) {
+					return false;
+				}
+			}
+			fileOff += p.entryLengthUncompressed;
 		}
+		return fileOff == file.size();
+	};
+
+	auto encodeUnbaked = [&](const std::string& path, const vpkpp::Entry& entry, EncodedEntry& enc, std::string& err) -> bool {
+		RESPAWN_VPK_TRACE_SCOPE("bake.encode");
+		enc.item = makeTreeItem(path);
+		auto& out = enc.item;
 
-		// Unbaked entry: encode into patch archive
-		const auto data = readUnbakedEntry(*item.entry);
+		// The returned buffer is owned by us, so edit it in place rather than copying it again
+		std::optional<std::vector<std::byte>> data;
+		{
+			RESPAWN_VPK_TRACE_SCOPE("bake.readUnbaked");
+			data = readUnbakedEntry(entry);
+		}
 		if (!data) {
-			this->lastError = "failed to read unbaked entry data: " + path;
+			err = "failed to read unbaked entry data: " + path;
 			return false;
 		}
-
-		auto file = *data;
+		enc.file = std::move(*data);
+		auto& file = enc.file;
 
 		// WAV handling: generate cam metadata and overwrite RIFF header
 		if (out.ext == "wav") {
-			if (auto cam = ::tryMakeCamEntry(file, out.path)) {
-				patchCams.push_back(*cam);
-			}
+			enc.cam = ::tryMakeCamEntry(file, out.path);
 			::stripWavHeaderInPlace(file);
 		}
 
-		out.meta.crc32 = crypto::computeCRC32(std::span<const std::byte>{file.data(), file.size()});
+		{
+			RESPAWN_VPK_TRACE_SCOPE("bake.crc32");
+			out.meta.crc32 = crypto::computeCRC32(std::span<const std::byte>{file.data(), file.size()});
+		}
 		out.inPatchArchive = true;
 
 		// Choose per-entry values (manifest > explicitly tracked flags > preserve > defaults)
 		std::uint32_t loadFlags = static_cast<std::uint32_t>(LOAD_VISIBLE | LOAD_CACHE);
 		std::uint32_t textureFlags = 0;
-		std::uint16_t preloadSize = 0;
 		bool useCompression = true;
 		bool deDuplicate = true;
 		bool manifestMatched = false;
 
 		if (manifest) {
-			const auto mkey = respawn_vpk::normalizeManifestPath(path);
-			if (const auto it = manifest->find(mkey); it != manifest->end()) {
-				loadFlags = it->second.loadFlags;
-				textureFlags = it->second.textureFlags;
-				preloadSize = it->second.preloadSize;
-				useCompression = it->second.useCompression;
-				deDuplicate = it->second.deDuplicate;
+			if (const auto* values = manifest->find(respawn_vpk::normalizeManifestPath(path))) {
+				loadFlags = values->loadFlags;
+				textureFlags = values->textureFlags;
+				useCompression = values->useCompression;
+				deDuplicate = values->deDuplicate;
 				manifestMatched = true;
 			}
 		}
@@ -945,7 +1285,37 @@ bool RespawnVPK::bake(const std::string& outputDir_, vpkpp::BakeOptions, const E
 			}
 		}
 
-		out.meta.preloadBytes = preloadSize;
+		// The manifest's preloadSize is not applied: the whole file goes into the parts, and a preload count without the
+		// preload bytes behind it would make readers skip over the next entry
+		out.meta.preloadBytes = 0;
+		enc.deDuplicate = deDuplicate;
+
+		// If identical content is already stored in an archive we keep, point at it and skip compression entirely
+		if (deDuplicate && !file.empty()) {
+			const std::uint64_t key = (static_cast<std::uint64_t>(out.meta.crc32) << 32) | (static_cast<std::uint64_t>(file.size()) & 0xFFFFFFFFu);
+			if (const auto it = existingContent.find(key); it != existingContent.end()) {
+				for (const auto& [candPath, candMeta] : it->second) {
+					// .cam records are keyed by archive offset, so WAV data can only be shared with other WAVs
+					if ((::getExtensionLower(*candPath) == "wav") != (out.ext == "wav")) {
+						continue;
+					}
+					if (!existingDataMatches(*candMeta, file)) {
+						continue;
+					}
+					for (auto p : candMeta->parts) {
+						p.loadFlags = loadFlags;
+						p.textureFlags = textureFlags;
+						EncodedPart ep;
+						ep.part = p;
+						enc.parts.push_back(std::move(ep));
+					}
+					enc.reusesExistingData = true;
+					enc.cam.reset();
+					out.inPatchArchive = false;
+					return true;
+				}
+			}
+		}
 
 		// Split into parts (and optionally compress)
 		std::size_t fileOff = 0;
@@ -953,72 +1323,135 @@ bool RespawnVPK::bake(const std::string& outputDir_, vpkpp::BakeOptions, const E
 			const auto partLen = std::min<std::size_t>(DEFAULT_MAX_PART_SIZE, file.size() - fileOff);
 			const auto partSpan = std::span<const std::byte>{file.data() + fileOff, partLen};
 
-			std::vector<std::byte> partData(partSpan.begin(), partSpan.end());
+			EncodedPart ep;
+			ep.fileOffset = fileOff;
+
+			// Only compressed parts need a buffer of their own, stored parts are written straight from the entry data
+			std::span<const std::byte> partData = partSpan;
 			bool doCompress = partLen >= DEFAULT_COMPRESSION_THRESHOLD && out.ext != "wav" && out.ext != "vtf";
 			if (manifestMatched) {
 				// Manifest is authoritative. Still keep the usual exclusions
 				doCompress = useCompression && out.ext != "wav" && out.ext != "vtf";
 			}
 			if (doCompress) {
-				const auto compressed = RespawnVPK::lzhamCompress(partSpan.data(), partSpan.size());
-				if (compressed.size() < partData.size()) {
-					partData = compressed;
+				ep.compressed = RespawnVPK::lzhamCompress(partSpan.data(), partSpan.size());
+				if (ep.compressed.size() < partData.size()) {
+					partData = ep.compressed;
+				} else {
+					ep.compressed.clear();
+					ep.compressed.shrink_to_fit();
 				}
 			}
 
-			FilePart p;
-			p.archiveIndex = PATCH_ARCHIVE_INDEX;
-			p.loadFlags = loadFlags;
-			p.textureFlags = textureFlags;
-			p.entryLength = static_cast<std::uint64_t>(partData.size());
-			p.entryLengthUncompressed = static_cast<std::uint64_t>(partLen);
+			ep.part.archiveIndex = PATCH_ARCHIVE_INDEX;
+			ep.part.loadFlags = loadFlags;
+			ep.part.textureFlags = textureFlags;
+			ep.part.entryLength = static_cast<std::uint64_t>(partData.size());
+			ep.part.entryLengthUncompressed = static_cast<std::uint64_t>(partLen);
 
-			// Deduplicate stored bytes if enabled
 			if (deDuplicate && !partData.empty()) {
-				const auto crc = crypto::computeCRC32(std::span<const std::byte>{partData.data(), partData.size()});
-				const std::uint64_t h = (static_cast<std::uint64_t>(crc) << 32) | static_cast<std::uint64_t>(partData.size());
-				bool reused = false;
-				if (auto it = patchDedup.find(h); it != patchDedup.end()) {
-					const auto baseOffset = patchOffset - static_cast<std::uint64_t>(patchArchive.size());
-					for (const auto off : it->second) {
-						if (off < baseOffset) {
-							continue;
-						}
-						const auto rel = static_cast<std::size_t>(off - baseOffset);
-						if (rel + partData.size() > patchArchive.size()) {
-							continue;
-						}
-						if (std::memcmp(patchArchive.data() + rel, partData.data(), partData.size()) == 0) {
-							p.entryOffset = off;
-							reused = true;
-							break;
-						}
+				ep.dedupKey = respawn_vpk::computeContentHash(partData);
+			}
+
+			enc.parts.push_back(std::move(ep));
+			fileOff += partLen;
+		}
+		return true;
+	};
+
+	auto layoutEncoded = [&](EncodedEntry& enc) -> bool {
+		RESPAWN_VPK_TRACE_SCOPE("bake.layout");
+		auto& out = enc.item;
+		this->lastBakeStats.unbakedEntries++;
+		if (enc.reusesExistingData) {
+			for (const auto& ep : enc.parts) {
+				referencedArchives.insert(ep.part.archiveIndex);
+				out.meta.parts.push_back(ep.part);
+				this->lastBakeStats.bytesReusedFromArchives += ep.part.entryLength;
+				respawn_vpk::stats::add(respawn_vpk::stats::get().dedupBytesSaved, ep.part.entryLength);
+			}
+			this->lastBakeStats.entriesReusedFromArchives++;
+			respawn_vpk::stats::add(respawn_vpk::stats::get().dedupHits);
+			treeItems.push_back(std::move(out));
+			return true;
+		}
+		for (auto& ep : enc.parts) {
+			auto& p = ep.part;
+			const auto partData = enc.partBytes(ep);
+
+			// Deduplicate stored bytes if enabled
+			if (enc.deDuplicate && !partData.empty()) {
+				if (const auto it = patchDedup.find(ep.dedupKey); it != patchDedup.end()) {
+					p.entryOffset = it->second;
+					this->lastBakeStats.bytesDedupedInBake += partData.size();
+					respawn_vpk::stats::add(respawn_vpk::stats::get().dedupHits);
+					respawn_vpk::stats::add(respawn_vpk::stats::get().dedupBytesSaved, partData.size());
+				} else {
+					if (!writePatchPart(partData, p.entryOffset)) {
+						return false;
 					}
+					patchDedup.emplace(ep.dedupKey, p.entryOffset);
 				}
-				if (!reused) {
-					p.entryOffset = patchOffset;
-					patchDedup[h].push_back(p.entryOffset);
-					patchArchive.insert(patchArchive.end(), partData.begin(), partData.end());
-					patchOffset += static_cast<std::uint64_t>(partData.size());
-				}
-			} else {
-				p.entryOffset = patchOffset;
-				patchArchive.insert(patchArchive.end(), partData.begin(), partData.end());
-				patchOffset += static_cast<std::uint64_t>(partData.size());
+			} else if (!writePatchPart(partData, p.entryOffset)) {
+				return false;
 			}
 
 			out.meta.parts.push_back(p);
-			fileOff += partLen;
 		}
 
+		// The data is in the writer now, drop our copies instead of holding them for the rest of the window
+		// (assigning {} would only clear them and keep the allocations)
+		enc.file = std::vector<std::byte>{};
+		enc.parts = std::vector<EncodedPart>{};
+
+		if (enc.cam) {
+			patchCams.push_back(std::move(*enc.cam));
+		}
 		referencedArchives.insert(PATCH_ARCHIVE_INDEX);
 		treeItems.push_back(std::move(out));
+		return true;
+	};
+
+	// Encode in windows whose input size stays within the memory budget (always at least one entry),
+	// the window boundaries only depend on the inputs so they do not affect determinism either
+	for (std::size_t windowStart = 0; windowStart < unbakedItems.size(); ) {
+		std::size_t windowEnd = windowStart;
+		std::uint64_t windowBytes = 0;
+		while (windowEnd < unbakedItems.size()) {
+			const auto len = unbakedItems[windowEnd].second->length;
+			if (windowEnd > windowStart && (windowBytes + len > this->bakeMemoryBudget || !respawn_vpk::memory::fits(windowBytes + len))) {
+				break;
+			}
+			windowBytes += len;
+			windowEnd++;
+		}
+
+		const respawn_vpk::memory::Charge windowCharge{windowBytes};
+		std::vector<EncodedEntry> encoded(windowEnd - windowStart);
+		std::string err;
+		const bool ok = respawn_vpk::parallelFor(encoded.size(), this->bakeThreadCount, [&](std::size_t i, std::string& workerErr) {
+			const auto& [path, entry] = unbakedItems[windowStart + i];
+			return encodeUnbaked(*path, *entry, encoded[i], workerErr);
+		}, &err);
+		if (!ok) {
+			this->lastError = err.empty() ? "failed to encode unbaked entries" : err;
+			return false;
+		}
+
+		for (auto& enc : encoded) {
+			if (!layoutEncoded(enc)) {
+				return false;
+			}
+		}
+		windowStart = windowEnd;
 	}
 
 	// Copy required referenced archive vpks (and optional .cam) when baking to a different directory
 	if (!outputDir.empty()) {
+		RESPAWN_VPK_TRACE_SCOPE("bake.carryOverArchives");
 		for (const auto idx : referencedArchives) {
-			if (idx == PATCH_ARCHIVE_INDEX && preserveExistingPatchArchive) {
+			// The patch archive was either carried over above or is being written fresh right now
+			if (idx == PATCH_ARCHIVE_INDEX) {
 				continue;
 			}
 			const auto src = RespawnVPK::buildArchivePath(std::string{this->fullFilePath}, idx);
@@ -1029,33 +1462,21 @@ bool RespawnVPK::bake(const std::string& outputDir_, vpkpp::BakeOptions, const E
 			const auto dst = RespawnVPK::makeArchivePathForWrite(outDirVpkPath, idx);
 			ec.clear();
 			std::filesystem::create_directories(std::filesystem::path{dst}.parent_path(), ec);
-			ec.clear();
-			std::filesystem::copy_file(src, dst, std::filesystem::copy_options::overwrite_existing, ec);
 
-			const auto srcCam = src + ".cam";
-			ec.clear();
-			if (std::filesystem::is_regular_file(srcCam, ec)) {
-				const auto dstCam = dst + ".cam";
-				ec.clear();
-				std::filesystem::copy_file(srcCam, dstCam, std::filesystem::copy_options::overwrite_existing, ec);
+			// The rollback guard undoes the patch archive, the dir tree must not point at an archive that isn't there
+			if (!this->carryOverArchiveFile(src, dst, this->bakeHardlinkArchives) || !this->carryOverArchiveFile(src + ".cam", dst + ".cam", this->bakeHardlinkArchives)) {
+				return false;
 			}
 		}
 	}
 
-	// Write patch archive (only if we actually have patch content)
-	if (!patchArchive.empty()) {
-		{
-			const auto openMode = preserveExistingPatchArchive ? (std::ios::binary | std::ios::app) : (std::ios::binary | std::ios::trunc);
-			std::ofstream f{dstPatchArchivePath, openMode};
-			if (!f) {
-				this->lastError = "failed to open patch archive for write: " + dstPatchArchivePath;
-				return false;
-			}
-			f.write(reinterpret_cast<const char*>(patchArchive.data()), static_cast<std::streamsize>(patchArchive.size()));
-			if (!f) {
-				this->lastError = "failed to write patch archive: " + dstPatchArchivePath;
-				return false;
-			}
+	this->lastBakeStats.bytesWritten = patchWriter.bytesAppended();
+
+	// Finish the patch archive (only if we actually have patch content)
+	if (patchWriter.bytesAppended()) {
+		if (!patchWriter.close() || !respawn_vpk::syncFile(patchWritePath)) {
+			this->lastError = "failed to write patch archive: " + patchWritePath;
+			return false;
 		}
 
 		// Write patch .cam if needed (append to preserve offsets for preserved patch archives)
@@ -1087,30 +1508,489 @@ bool RespawnVPK::bake(const std::string& outputDir_, vpkpp::BakeOptions, const E
 			}
 
 			const auto camOpenMode = preserveExistingPatchArchive ? (std::ios::binary | std::ios::app) : (std::ios::binary | std::ios::trunc);
-			std::ofstream f{dstPatchCamPath, camOpenMode};
-			if (f) {
-				f.write(reinterpret_cast<const char*>(w.buf.data()), static_cast<std::streamsize>(w.buf.size()));
+			std::ofstream f{patchCamWritePath, camOpenMode};
+			f.write(reinterpret_cast<const char*>(w.buf.data()), static_cast<std::streamsize>(w.buf.size()));
+			f.close();
+			if (!f || !respawn_vpk::syncFile(patchCamWritePath)) {
+				this->lastError = "failed to write patch archive .cam: " + patchCamWritePath;
+				return false;
 			}
+			respawn_vpk::stats::addWrite(w.buf.size(), 2);
 		}
 	}
 
-	// Sort entries for deterministic tree layout
-	std::sort(treeItems.begin(), treeItems.end(), [](const TreeItem& a, const TreeItem& b) {
-		const auto ka = a.ext + '\0' + a.dir + '\0' + a.fileStem + '\0';
-		const auto kb = b.ext + '\0' + b.dir + '\0' + b.fileStem + '\0';
-		return ka < kb;
+	if (!this->writeDirVpk(tmpDirVpkPath, treeItems, callback)) {
+		return false;
+	}
+	if (!respawn_vpk::syncFile(tmpDirVpkPath)) {
+		this->lastError = "failed to sync: " + tmpDirVpkPath;
+		return false;
+	}
+
+	// Everything is on disk, make it visible. If this fails partway, recovery finishes the job
+	rollbackGuard.dismiss();
+	if (!respawn_vpk::commitBake(journalPath, journal, &this->lastError)) {
+		std::string recoverError;
+		(void) respawn_vpk::recoverInterruptedBake(bakeLock, &recoverError);
+		return false;
+	}
+
+	// Rebuild in-memory state to match output
+	this->metaEntries.clear();
+	this->entries.clear();
+	this->unbakedEntries.clear();
+	this->unbakedFlags.clear();
+
+	for (auto& ti : treeItems) {
+		std::string fullPath = ti.fileStem == " " ? std::string{} : ti.fileStem;
+		if (ti.ext != " ") {
+			fullPath += '.';
+			fullPath += ti.ext;
+		}
+		if (ti.dir != " " && !ti.dir.empty()) {
+			fullPath = ti.dir + '/' + fullPath;
+		}
+		fullPath = this->cleanEntryPath(fullPath);
+
+		Entry entry = createNewEntry();
+		entry.crc32 = ti.meta.crc32;
+
+		std::uint64_t dataLen = ti.meta.preloadBytes;
+		for (const auto& p : ti.meta.parts) {
+			dataLen += p.entryLengthUncompressed;
+		}
+		entry.length = dataLen;
+		if (!ti.meta.parts.empty()) {
+			entry.archiveIndex = ti.meta.parts.front().archiveIndex;
+		}
+
+		this->metaEntries.emplace(fullPath, ti.meta);
+		this->entries.emplace(fullPath, entry);
+	}
+	this->updateMetaEntriesCharge();
+
+	PackFile::setFullFilePath(outputDir);
+	this->clearStoredArchivePaths();
+
+	// Refresh (write) manifest next to the dir vpk, so future folder-based repacks can preserve flags
+	RespawnVPK::writeManifestForTree(outDirVpkPath, treeItems);
+
+	return true;
+}
+
+bool RespawnVPK::bakeMetadataOnly(const std::string& outputDir, const std::string& outDirVpkPath, const respawn_vpk::BakeLock& bakeLock, const respawn_vpk::Manifest* manifest, const EntryCallback& callback) {
+	RESPAWN_VPK_TRACE_SCOPE("bake.metadataOnly");
+	this->lastBakeStats.metadataOnly = true;
+
+	constexpr std::uint16_t PATCH_ARCHIVE_INDEX = 999;
+
+	std::vector<TreeItem> treeItems;
+	treeItems.reserve(this->metaEntries.size());
+
+	// The manifest only needs rewriting if it no longer lists exactly the entries in the tree
+	std::size_t manifestHits = 0;
+	std::unordered_set<std::uint16_t> referencedArchives;
+	for (const auto& [path, meta] : this->metaEntries) {
+		TreeItem out = makeTreeItem(path);
+		out.meta = meta;
+		if (manifest) {
+			// Flags only, see bake(): the stored preload bytes can't change without moving data
+			if (const auto* values = manifest->find(respawn_vpk::normalizeManifestPath(path))) {
+				manifestHits++;
+				for (auto& p : out.meta.parts) {
+					p.loadFlags = values->loadFlags;
+					p.textureFlags = values->textureFlags;
+				}
+			}
+		}
+		for (const auto& p : out.meta.parts) {
+			referencedArchives.insert(p.archiveIndex);
+		}
+		treeItems.push_back(std::move(out));
+	}
+	const bool manifestStale = !manifest || manifestHits != treeItems.size() || manifest->size() != manifestHits;
+
+	const auto journalPath = respawn_vpk::getBakeJournalPath(outDirVpkPath);
+	const auto tmpDirVpkPath = outDirVpkPath + ".tmp";
+	respawn_vpk::BakeJournal journal;
+	journal.renames.emplace_back(tmpDirVpkPath, outDirVpkPath);
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(std::filesystem::path{outDirVpkPath}.parent_path(), ec);
+		std::filesystem::remove(tmpDirVpkPath, ec);
+	}
+	if (!respawn_vpk::writeBakeJournal(journalPath, journal, &this->lastError)) {
+		return false;
+	}
+	respawn_vpk::BakeRollbackGuard rollbackGuard{journalPath, journal};
+
+	// Data stays where it is, only a different output directory needs the referenced archives
+	if (!outputDir.empty()) {
+		for (const auto idx : referencedArchives) {
+			const auto src = RespawnVPK::buildArchivePath(std::string{this->fullFilePath}, idx);
+			const auto dst = RespawnVPK::makeArchivePathForWrite(outDirVpkPath, idx);
+			std::error_code ec;
+			std::filesystem::create_directories(std::filesystem::path{dst}.parent_path(), ec);
+
+			// Later bakes append to the patch archive, so it must not share data with the source
+			const bool allowHardlink = idx != PATCH_ARCHIVE_INDEX && this->bakeHardlinkArchives;
+			if (!this->carryOverArchiveFile(src, dst, allowHardlink) || !this->carryOverArchiveFile(src + ".cam", dst + ".cam", allowHardlink)) {
+				return false;
+			}
+		}
+	}
+
+	if (!this->writeDirVpk(tmpDirVpkPath, treeItems, callback)) {
+		return false;
+	}
+	if (!respawn_vpk::syncFile(tmpDirVpkPath)) {
+		this->lastError = "failed to sync: " + tmpDirVpkPath;
+		return false;
+	}
+	rollbackGuard.dismiss();
+	if (!respawn_vpk::commitBake(journalPath, journal, &this->lastError)) {
+		std::string recoverError;
+		(void) respawn_vpk::recoverInterruptedBake(bakeLock, &recoverError);
+		return false;
+	}
+
+	// Entries keep their lengths and CRCs, only the per-part flags may have changed
+	for (auto& ti : treeItems) {
+		this->metaEntries[ti.path] = ti.meta;
+	}
+	this->updateMetaEntriesCharge();
+	this->unbakedFlags.clear();
+
+	PackFile::setFullFilePath(outputDir);
+	this->clearStoredArchivePaths();
+
+	if (manifestStale) {
+		RespawnVPK::writeManifestForTree(outDirVpkPath, treeItems);
+	}
+	return true;
+}
+
+bool RespawnVPK::carryOverArchiveFile(const std::string& src, const std::string& dst, bool allowHardlink) {
+	std::error_code ec;
+	if (!std::filesystem::is_regular_file(src, ec)) {
+		return true;
+	}
+	const auto size = std::filesystem::file_size(src, ec);
+	const auto start = std::chrono::steady_clock::now();
+	const auto strategy = respawn_vpk::carryOverFile(src, dst, allowHardlink, &this->lastError);
+	this->lastBakeStats.carryOverSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (!strategy) {
+		return false;
+	}
+	// Baking in place, nothing was actually carried over
+	if (*strategy == respawn_vpk::CarryOverStrategy::SAME_FILE) {
+		return true;
+	}
+	this->lastBakeStats.carriedOverFiles++;
+	this->lastBakeStats.carriedOverBytes += ec ? 0 : size;
+	this->lastBakeStats.carryOverStrategy = std::max(this->lastBakeStats.carryOverStrategy, *strategy);
+	return true;
+}
+
+void RespawnVPK::writeManifestForTree(const std::string& dirVpkPath, const std::vector<TreeItem>& treeItems) {
+	std::string err;
+	(void)respawn_vpk::writeManifestForDirVpkPath(std::filesystem::path{dirVpkPath}, treeItems.size(), [&treeItems](std::size_t i) {
+		const auto& ti = treeItems[i];
+		respawn_vpk::ManifestWriteItem m;
+		m.path = ti.path;
+		m.values.preloadSize = ti.meta.preloadBytes;
+		if (!ti.meta.parts.empty()) {
+			m.values.loadFlags = ti.meta.parts.front().loadFlags;
+			m.values.textureFlags = ti.meta.parts.front().textureFlags;
+			m.values.useCompression = (ti.meta.parts.front().entryLength != ti.meta.parts.front().entryLengthUncompressed);
+		}
+		m.values.deDuplicate = true;
+		return m;
+	}, &err);
+}
+
+bool RespawnVPK::compactPatchArchive(bool reorderForLocality) {
+	RESPAWN_VPK_TRACE_SCOPE("compact");
+	const respawn_vpk::memory::OperationScope memoryScope{respawn_vpk::memory::Operation::COMPACT};
+	this->lastError.clear();
+	this->lastCompactStats = {};
+
+	constexpr std::uint16_t PATCH_ARCHIVE_INDEX = 999;
+
+	if (!this->unbakedEntries.empty()) {
+		this->lastError = "there are unsaved changes, bake them before compacting the patch archive";
+		return false;
+	}
+
+	const std::string dirVpkPath{this->fullFilePath};
+	const auto patchPath = RespawnVPK::buildArchivePath(dirVpkPath, PATCH_ARCHIVE_INDEX);
+	std::error_code ec;
+	if (!std::filesystem::is_regular_file(patchPath, ec)) {
+		// Nothing to compact
+		return true;
+	}
+
+	respawn_vpk::BakeLock compactLock;
+	if (!compactLock.tryLock(dirVpkPath, &this->lastError) || !respawn_vpk::recoverInterruptedBake(compactLock, &this->lastError)) {
+		return false;
+	}
+	const auto patchSize = static_cast<std::uint64_t>(std::filesystem::file_size(patchPath, ec));
+	if (ec) {
+		this->lastError = "failed to stat patch archive: " + patchPath;
+		return false;
+	}
+	this->lastCompactStats.bytesBefore = patchSize;
+
+	std::vector<TreeItem> treeItems;
+	treeItems.reserve(this->metaEntries.size());
+	for (const auto& [path, meta] : this->metaEntries) {
+		auto item = RespawnVPK::makeTreeItem(path);
+		item.meta = meta;
+		treeItems.push_back(std::move(item));
+	}
+	RespawnVPK::sortTreeItems(treeItems, this->bakeThreadCount);
+
+	// Live byte ranges of the patch archive; rank is the position of the first entry (in tree order) using the range
+	struct LiveRange {
+		std::uint64_t start = 0;
+		std::uint64_t end = 0;
+		std::size_t rank = 0;
+		std::uint64_t newStart = 0;
+	};
+	std::vector<LiveRange> ranges;
+	for (std::size_t i = 0; i < treeItems.size(); i++) {
+		for (const auto& p : treeItems[i].meta.parts) {
+			if (p.archiveIndex != PATCH_ARCHIVE_INDEX || !p.entryLength) {
+				continue;
+			}
+			if (p.entryOffset + p.entryLength > patchSize) {
+				this->lastError = "entry data lies outside of the patch archive: " + treeItems[i].path;
+				return false;
+			}
+			ranges.push_back({p.entryOffset, p.entryOffset + p.entryLength, i});
+		}
+	}
+
+	// Merge duplicates (dedup shares ranges between entries) and any overlaps
+	std::sort(ranges.begin(), ranges.end(), [](const LiveRange& a, const LiveRange& b) {
+		return a.start < b.start || (a.start == b.start && a.end > b.end);
 	});
+	std::vector<LiveRange> merged;
+	for (const auto& r : ranges) {
+		if (!merged.empty() && r.start < merged.back().end) {
+			merged.back().end = std::max(merged.back().end, r.end);
+			merged.back().rank = std::min(merged.back().rank, r.rank);
+		} else {
+			merged.push_back(r);
+		}
+	}
+
+	// Pick the new layout: either the existing order, or dir tree order so files read together sit together
+	std::vector<std::size_t> order(merged.size());
+	for (std::size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	if (reorderForLocality) {
+		std::stable_sort(order.begin(), order.end(), [&merged](std::size_t a, std::size_t b) {
+			return merged[a].rank < merged[b].rank;
+		});
+	}
+	std::uint64_t newSize = 0;
+	for (const auto i : order) {
+		merged[i].newStart = newSize;
+		newSize += merged[i].end - merged[i].start;
+	}
+	this->lastCompactStats.liveRanges = merged.size();
+	this->lastCompactStats.bytesAfter = newSize;
+
+	// Old offset -> new offset, merged is sorted by start
+	auto remap = [&merged](std::uint64_t offset) -> std::optional<std::uint64_t> {
+		auto it = std::upper_bound(merged.begin(), merged.end(), offset, [](std::uint64_t off, const LiveRange& r) {
+			return off < r.start;
+		});
+		if (it == merged.begin()) {
+			return std::nullopt;
+		}
+		--it;
+		if (offset >= it->end) {
+			return std::nullopt;
+		}
+		return it->newStart + (offset - it->start);
+	};
+
+	// Write the compacted archive, .cam and dir VPK to temp files, then swap them in through a bake journal
+	// so an interruption leaves either the old or the new layout, never a mix
+	const auto camPath = patchPath + ".cam";
+	const auto tmpPatchPath = patchPath + ".tmp";
+	const auto tmpCamPath = camPath + ".tmp";
+	const auto tmpDirVpkPath = dirVpkPath + ".tmp";
+	const auto journalPath = respawn_vpk::getBakeJournalPath(dirVpkPath);
+
+	respawn_vpk::BakeJournal journal;
+	journal.renames.emplace_back(tmpPatchPath, patchPath);
+	journal.renames.emplace_back(tmpCamPath, camPath);
+	journal.renames.emplace_back(tmpDirVpkPath, dirVpkPath);
+	for (const auto& [tmpPath, finalPath] : journal.renames) {
+		std::filesystem::remove(tmpPath, ec);
+	}
+	if (!respawn_vpk::writeBakeJournal(journalPath, journal, &this->lastError)) {
+		return false;
+	}
+	respawn_vpk::BakeRollbackGuard rollbackGuard{journalPath, journal};
+
+	{
+		std::ifstream in{patchPath, std::ios::binary};
+		std::ofstream out{tmpPatchPath, std::ios::binary | std::ios::trunc};
+		if (!in || !out) {
+			this->lastError = "failed to open patch archive for compaction: " + patchPath;
+			return false;
+		}
+		std::vector<char> buf(1024 * 1024);
+		for (const auto i : order) {
+			const auto& r = merged[i];
+			in.seekg(static_cast<std::streamoff>(r.start), std::ios::beg);
+			for (auto remaining = r.end - r.start; remaining > 0; ) {
+				const auto chunk = static_cast<std::size_t>(std::min<std::uint64_t>(remaining, buf.size()));
+				in.read(buf.data(), static_cast<std::streamsize>(chunk));
+				out.write(buf.data(), static_cast<std::streamsize>(chunk));
+				if (!in || !out) {
+					this->lastError = "failed to copy live data while compacting: " + patchPath;
+					return false;
+				}
+				respawn_vpk::stats::addRead(chunk);
+				respawn_vpk::stats::addWrite(chunk);
+				remaining -= chunk;
+			}
+		}
+		out.close();
+		if (!out || !respawn_vpk::syncFile(tmpPatchPath)) {
+			this->lastError = "failed to write compacted patch archive: " + tmpPatchPath;
+			return false;
+		}
+	}
+
+	// .cam records are keyed by archive offset, remap them and drop the ones for data that is gone
+	if (std::filesystem::is_regular_file(camPath, ec)) {
+		const auto camSize = static_cast<std::size_t>(std::filesystem::file_size(camPath, ec));
+		auto cam = RespawnVPK::readFileRange(camPath, 0, camSize);
+		if (!cam) {
+			this->lastError = "failed to read patch archive .cam: " + camPath;
+			return false;
+		}
+		WriteBuffer w(cam->size());
+		for (std::size_t off = 0; off + 32 <= cam->size(); off += 32) {
+			std::uint64_t contentOffset = 0;
+			for (int b = 7; b >= 0; b--) {
+				contentOffset = (contentOffset << 8) | static_cast<std::uint8_t>((*cam)[off + 24 + b]);
+			}
+			const auto newOffset = remap(contentOffset);
+			if (!newOffset) {
+				continue;
+			}
+			w.writeBytes(std::span<const std::byte>{cam->data() + off, 24});
+			w.writeU64(*newOffset);
+		}
+		std::ofstream f{tmpCamPath, std::ios::binary | std::ios::trunc};
+		f.write(reinterpret_cast<const char*>(w.buf.data()), static_cast<std::streamsize>(w.buf.size()));
+		f.close();
+		if (!f || !respawn_vpk::syncFile(tmpCamPath)) {
+			this->lastError = "failed to write compacted .cam: " + tmpCamPath;
+			return false;
+		}
+		respawn_vpk::stats::addWrite(w.buf.size(), 2);
+	}
+
+	for (auto& item : treeItems) {
+		for (auto& p : item.meta.parts) {
+			if (p.archiveIndex == PATCH_ARCHIVE_INDEX && p.entryLength) {
+				p.entryOffset = *remap(p.entryOffset);
+			}
+		}
+	}
+
+	if (!this->writeDirVpk(tmpDirVpkPath, treeItems, nullptr)) {
+		return false;
+	}
+	if (!respawn_vpk::syncFile(tmpDirVpkPath)) {
+		this->lastError = "failed to sync: " + tmpDirVpkPath;
+		return false;
+	}
+
+	rollbackGuard.dismiss();
+	if (!respawn_vpk::commitBake(journalPath, journal, &this->lastError)) {
+		std::string recoverError;
+		(void) respawn_vpk::recoverInterruptedBake(compactLock, &recoverError);
+		return false;
+	}
+
+	for (const auto& item : treeItems) {
+		this->metaEntries[item.path] = item.meta;
+	}
+	this->updateMetaEntriesCharge();
+	this->clearStoredArchivePaths();
+	return true;
+}
+
+RespawnVPK::TreeItem RespawnVPK::makeTreeItem(const std::string& path) {
+	TreeItem out;
+	out.path = path;
+
+	// Entry paths are already clean (forward slashes, no leading or trailing slash), so plain string splitting
+	// gives the same result as std::filesystem::path::parent_path/stem/extension without the allocations
+	const std::string_view pathView{path};
+	const auto slash = pathView.rfind('/');
+	const auto dir = slash == std::string_view::npos ? std::string_view{} : pathView.substr(0, slash);
+	const auto filename = slash == std::string_view::npos ? pathView : pathView.substr(slash + 1);
+
+	std::string_view stem = filename;
+	std::string_view ext;
+	if (const auto dot = filename.rfind('.'); dot != std::string_view::npos && dot != 0 && filename != "..") {
+		stem = filename.substr(0, dot);
+		ext = filename.substr(dot + 1);
+	}
+
+	if (ext.empty()) {
+		out.ext = " ";
+		out.fileStem = filename;
+	} else {
+		out.ext = ext;
+		for (auto& c : out.ext) {
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		}
+		out.fileStem = stem;
+	}
+	out.dir = dir.empty() ? std::string{" "} : std::string{dir};
+	return out;
+}
+
+void RespawnVPK::sortTreeItems(std::vector<TreeItem>& treeItems, std::size_t threadCount) {
+	respawn_vpk::sortByPackedKey(treeItems, [](std::string& key, const TreeItem& item) {
+		key.append(item.ext).push_back('\0');
+		key.append(item.dir).push_back('\0');
+		key.append(item.fileStem).push_back('\0');
+	}, threadCount);
+}
+
+bool RespawnVPK::writeDirVpk(const std::string& dirVpkPath, std::vector<TreeItem>& treeItems, const EntryCallback& callback) {
+	RESPAWN_VPK_TRACE_SCOPE("writeDirVpk");
+	// Sort entries for deterministic tree layout
+	RespawnVPK::sortTreeItems(treeItems, this->bakeThreadCount);
 
 	// Build directory tree buffer
 	WriteBuffer treeBuf;
 	treeBuf.buf.reserve(treeItems.size() * 64);
-	std::string lastExt;
-	std::string lastDir;
+	// Views into treeItems, which outlive the loop
+	std::string_view lastExt;
+	std::string_view lastDir;
 
-	for (const auto& e : treeItems) {
+	// Preload bytes are stored inline after each entry's parts, copied from the dir VPK the entries were read from
+	std::ifstream preloadSource;
+	std::vector<std::byte> preloadBuf;
+
+	for (auto& e : treeItems) {
 		if (!lastExt.empty() && e.ext != lastExt) {
 			treeBuf.writeU16(0);
-			lastDir.clear();
+			lastDir = {};
 		} else if (!lastDir.empty() && e.dir != lastDir) {
 			treeBuf.writeU8(0);
 		}
@@ -1138,10 +2018,29 @@ bool RespawnVPK::bake(const std::string& outputDir_, vpkpp::BakeOptions, const E
 		}
 		treeBuf.writeU16(RESPAWN_CHUNK_END_MARKER);
 
+		if (e.meta.preloadBytes) {
+			if (!preloadSource.is_open()) {
+				preloadSource.open(std::string{this->fullFilePath}, std::ios::binary);
+			}
+			preloadBuf.resize(e.meta.preloadBytes);
+			preloadSource.seekg(static_cast<std::streamoff>(e.meta.preloadOffset), std::ios::beg);
+			preloadSource.read(reinterpret_cast<char*>(preloadBuf.data()), static_cast<std::streamsize>(preloadBuf.size()));
+			if (!preloadSource) {
+				this->lastError = "failed to read preload bytes from directory VPK: " + e.path;
+				return false;
+			}
+			respawn_vpk::stats::addRead(preloadBuf.size(), 2);
+			respawn_vpk::stats::addArchiveRead(respawn_vpk::stats::DIR_VPK_INDEX, preloadBuf.size());
+
+			// The rebuilt metadata points into the new dir VPK
+			e.meta.preloadOffset = RESPAWN_VPK_HEADER_LEN + treeBuf.buf.size();
+			treeBuf.writeBytes(preloadBuf);
+		}
+
 		if (callback) {
 			vpkpp::Entry ent = vpkpp::PackFile::createNewEntry();
 			ent.crc32 = e.meta.crc32;
-			std::uint64_t len = 0;
+			std::uint64_t len = e.meta.preloadBytes;
 			for (const auto& p : e.meta.parts) {
 				len += p.entryLengthUncompressed;
 			}
@@ -1162,77 +2061,34 @@ bool RespawnVPK::bake(const std::string& outputDir_, vpkpp::BakeOptions, const E
 	headerBuf.writeU32(static_cast<std::uint32_t>(treeBuf.buf.size()));
 	headerBuf.writeU32(0); // signature size (unused)
 
+	const respawn_vpk::memory::Charge treeCharge{treeBuf.buf.capacity()};
+
 	// Write dir VPK
 	{
-		std::ofstream f{outDirVpkPath, std::ios::binary | std::ios::trunc};
+		std::ofstream f{dirVpkPath, std::ios::binary | std::ios::trunc};
 		if (!f) {
-			this->lastError = "failed to open for write: " + outDirVpkPath;
+			this->lastError = "failed to open for write: " + dirVpkPath;
 			return false;
 		}
 		f.write(reinterpret_cast<const char*>(headerBuf.buf.data()), static_cast<std::streamsize>(headerBuf.buf.size()));
 		f.write(reinterpret_cast<const char*>(treeBuf.buf.data()), static_cast<std::streamsize>(treeBuf.buf.size()));
 		if (!f) {
-			this->lastError = "failed to write: " + outDirVpkPath;
+			this->lastError = "failed to write: " + dirVpkPath;
 			return false;
 		}
+		respawn_vpk::stats::addWrite(headerBuf.buf.size() + treeBuf.buf.size(), 3);
 	}
+	return true;
+}
 
-	// Rebuild in-memory state to match output
-	this->metaEntries.clear();
-	this->entries.clear();
-	this->unbakedEntries.clear();
-	this->unbakedFlags.clear();
-
-	for (auto& ti : treeItems) {
-		std::string fullPath = ti.fileStem == " " ? std::string{} : ti.fileStem;
-		if (ti.ext != " ") {
-			fullPath += '.';
-			fullPath += ti.ext;
-		}
-		if (ti.dir != " " && !ti.dir.empty()) {
-			fullPath = ti.dir + '/' + fullPath;
-		}
-		fullPath = this->cleanEntryPath(fullPath);
-
-		Entry entry = createNewEntry();
-		entry.crc32 = ti.meta.crc32;
-
-		std::uint64_t dataLen = 0;
-		for (const auto& p : ti.meta.parts) {
-			dataLen += p.entryLengthUncompressed;
-		}
-		entry.length = dataLen;
-		if (!ti.meta.parts.empty()) {
-			entry.archiveIndex = ti.meta.parts.front().archiveIndex;
-		}
-
-		this->metaEntries.emplace(fullPath, ti.meta);
-		this->entries.emplace(fullPath, entry);
-	}
-
-	PackFile::setFullFilePath(outputDir);
-
-	// Refresh (write) manifest next to the dir vpk, so future folder-based repacks can preserve flags
-	{
-		std::vector<respawn_vpk::ManifestWriteItem> mani;
-		mani.reserve(treeItems.size());
-		for (const auto& ti : treeItems) {
-			respawn_vpk::ManifestWriteItem m;
-			m.path = ti.path;
-			m.values.preloadSize = ti.meta.preloadBytes;
-			if (!ti.meta.parts.empty()) {
-				m.values.loadFlags = ti.meta.parts.front().loadFlags;
-				m.values.textureFlags = ti.meta.parts.front().textureFlags;
-				m.values.useCompression = (ti.meta.parts.front().entryLength != ti.meta.parts.front().entryLengthUncompressed);
-			}
-			m.values.deDuplicate = true;
-			mani.push_back(std::move(m));
-		}
-		std::string err;
-		(void)respawn_vpk::writeManifestForDirVpkPath(std::filesystem::path{outDirVpkPath}, mani, &err);
+void RespawnVPK::updateMetaEntriesCharge() {
+	// Estimate, the map nodes and the matching PackFile entries are not measured exactly
+	std::uint64_t bytes = 0;
+	for (const auto& [path, meta] : this->metaEntries) {
+		bytes += sizeof(std::pair<const std::string, MetaEntry>) + sizeof(Entry) + 2 * sizeof(void*) + path.capacity() * 2;
+		bytes += meta.parts.capacity() * sizeof(FilePart);
 	}
-
-	return true;
+	this->metaEntriesCharge.set(bytes);
 }
 
 bool RespawnVPK::isRespawnVPKDirPath(std::string_view path) {
@@ -1395,6 +2251,20 @@ std::string RespawnVPK::stripPakLangFilenamePrefix(const std::string& path) {
 	return path;
 }
 
+std::string RespawnVPK::getStoredArchivePath(std::uint16_t archiveIndex) const {
+	std::scoped_lock lock{this->storedArchivePathsMutex};
+	auto it = this->storedArchivePaths.find(archiveIndex);
+	if (it == this->storedArchivePaths.end()) {
+		it = this->storedArchivePaths.emplace(archiveIndex, RespawnVPK::buildArchivePath(std::string{this->fullFilePath}, archiveIndex)).first;
+	}
+	return it->second;
+}
+
+void RespawnVPK::clearStoredArchivePaths() {
+	std::scoped_lock lock{this->storedArchivePathsMutex};
+	this->storedArchivePaths.clear();
+}
+
 std::string RespawnVPK::buildArchivePath(const std::string& dirVpkPath, std::uint16_t archiveIndex) {
 	auto tryBuild = [archiveIndex](const std::string& base) -> std::string {
 		const std::filesystem::path p{base};
@@ -1453,6 +2323,7 @@ std::string RespawnVPK::buildArchivePath(const std::string& dirVpkPath, std::uin
 }
 
 std::optional<std::vector<std::byte>> RespawnVPK::readFileRange(const std::string& path, std::uint64_t offset, std::size_t length) {
+	RESPAWN_VPK_TRACE_SCOPE("io.readRange");
 	// Avoid huge allocations / crashes on malformed metadata
 	constexpr std::size_t MAX_READ = 512ull * 1024ull * 1024ull;
 	if (length > MAX_READ) {
@@ -1492,12 +2363,17 @@ std::optional<std::vector<std::byte>> RespawnVPK::readFileRange(const std::strin
 	if (!f) {
 		return std::nullopt;
 	}
+	// Open, the two seeks and the read
+	respawn_vpk::stats::addRead(length, 4);
 
 	return out;
 }
 
 std::optional<std::vector<std::byte>> RespawnVPK::lzhamDecompress(const std::byte* src, std::size_t srcLen, std::size_t dstLen) {
+	RESPAWN_VPK_TRACE_SCOPE("lzham.decompress");
 #ifdef VPKEDIT_HAVE_LZHAM
+	auto& counters = respawn_vpk::stats::get();
+	const respawn_vpk::stats::Timer timer{counters.decompressNs};
 	std::vector<std::byte> out(dstLen);
 	size_t outLen = dstLen;
 	const auto rc = lzham_bridge_decompress(
@@ -1508,6 +2384,9 @@ std::optional<std::vector<std::byte>> RespawnVPK::lzhamDecompress(const std::byt
 		return std::nullopt;
 	}
 	out.resize(outLen);
+	respawn_vpk::stats::add(counters.partsDecompressed);
+	respawn_vpk::stats::add(counters.decompressInputBytes, srcLen);
+	respawn_vpk::stats::add(counters.decompressOutputBytes, outLen);
 	return out;
 #else
 	(void)src;
@@ -2,6 +2,8 @@
 
 #include <cstdint>
 #include <fstream>
+#include <map>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -10,6 +12,11 @@
 
 #include <vpkpp/vpkpp.h>
 
+#include "RespawnVPKCopy.h"
+#include "RespawnVPKJournal.h"
+#include "RespawnVPKManifest.h"
+#include "RespawnVPKMemory.h"
+
 // Respawn VPK support
 // These are still .vpk files, but use header version 196610 (0x30002) and
 // per-file chunk records with 64-bit offsets/lengths, commonly LZHAM compressed
@@ -41,12 +48,99 @@ class RespawnVPK final : public vpkpp::PackFile {
 	// Stream extraction to disk. Needed for large entries where readEntry() would require huge allocations
 	[[nodiscard]] bool extractEntryToFile(const std::string& entryPath, const std::string& filepath, std::string* outError = nullptr) const;
 
+	// Where and how an entry's data is stored, so it can be copied without decompressing it (e.g. incremental repacks)
+	struct StoredPart {
+		std::string archivePath;
+		std::uint64_t offset = 0;
+		std::uint64_t length = 0;
+		std::uint64_t uncompressedLength = 0;
+		std::uint16_t archiveIndex = 0;
+		std::uint32_t loadFlags = 0;
+		std::uint32_t textureFlags = 0;
+	};
+	struct StoredEntry {
+		std::uint32_t crc32 = 0;
+		std::uint16_t preloadBytes = 0;
+		std::vector<StoredPart> parts;
+	};
+
+	// Stored layout of a baked entry, nullopt if there is no such entry or it has not been baked yet
+	// Without withArchivePaths the parts' archivePath is left empty, for callers that only need the archive index
+	[[nodiscard]] std::optional<StoredEntry> getStoredEntry(const std::string& path_, bool withArchivePaths = true) const;
+
+	// Archives that hold the data of baked entries, by archive index, with paths resolved the same way reads resolve them
+	[[nodiscard]] std::map<std::uint16_t, std::string> getStoredArchivePaths() const;
+
 	[[nodiscard]] vpkpp::Attribute getSupportedEntryAttributes() const override;
 
 	// Write support: edits are stored as unbaked entries; baking writes an updated *_dir.vpk and (optionally)
 	// a patch archive `*_999.vpk` containing changed/new files, while reusing existing archives for unchanged files
 	bool bake(const std::string& outputDir_ /*= ""*/, vpkpp::BakeOptions options /*= {}*/, const EntryCallback& callback /*= nullptr*/) override;
 
+	// Summary of the most recent bake, mainly to report how much data dedup avoided writing
+	struct BakeStats {
+		std::uint64_t unbakedEntries = 0;
+		// Nothing new had to be encoded, only the dir tree was rewritten (renames, removals, manifest flag edits)
+		bool metadataOnly = false;
+		// New bytes appended to the patch archive
+		std::uint64_t bytesWritten = 0;
+		// Bytes not written because the part matched data written earlier in the same bake
+		std::uint64_t bytesDedupedInBake = 0;
+		// Bytes not written because the whole entry already exists in an archive (e.g. `_000.vpk` or an earlier patch)
+		std::uint64_t bytesReusedFromArchives = 0;
+		std::uint64_t entriesReusedFromArchives = 0;
+
+		// Existing archives carried over to a different output directory
+		std::uint64_t carriedOverFiles = 0;
+		std::uint64_t carriedOverBytes = 0;
+		double carryOverSeconds = 0.0;
+		// Most expensive strategy any carried-over file needed
+		respawn_vpk::CarryOverStrategy carryOverStrategy = respawn_vpk::CarryOverStrategy::NONE;
+
+		[[nodiscard]] std::uint64_t bytesSaved() const noexcept {
+			return this->bytesDedupedInBake + this->bytesReusedFromArchives;
+		}
+	};
+
+	[[nodiscard]] const BakeStats& getLastBakeStats() const noexcept { return this->lastBakeStats; }
+
+	// Upper bound (bytes) for patch data staged in memory while baking; new parts are streamed to the patch archive
+	// Note that an unbaked entry is still read whole, so the peak is roughly this plus the largest unbaked entry
+	// A process-wide budget (respawn_vpk::memory::setBudget) shrinks the encode windows and flushes staged data sooner
+	void setBakeMemoryBudget(std::size_t bytes) noexcept { this->bakeMemoryBudget = bytes; }
+	[[nodiscard]] std::size_t getBakeMemoryBudget() const noexcept { return this->bakeMemoryBudget; }
+
+	// Number of threads used to compress unbaked entries while baking (0 = one per hardware thread)
+	// The baked output does not depend on this value
+	void setBakeThreadCount(std::size_t count) noexcept { this->bakeThreadCount = count; }
+	[[nodiscard]] std::size_t getBakeThreadCount() const noexcept { return this->bakeThreadCount; }
+
+	// When baking to a different directory, allow unchanged archives to be hard linked instead of copied
+	// Only enable this if the output is treated as read-only, since both paths then share the same data
+	// The patch archive is never hard linked because bakes append to it
+	void setBakeHardlinkArchives(bool hardlink) noexcept { this->bakeHardlinkArchives = hardlink; }
+	[[nodiscard]] bool getBakeHardlinkArchives() const noexcept { return this->bakeHardlinkArchives; }
+
+	// Summary of the most recent compactPatchArchive call
+	struct CompactStats {
+		std::uint64_t bytesBefore = 0;
+		std::uint64_t bytesAfter = 0;
+		// Distinct byte ranges still referenced by the dir tree
+		std::uint64_t liveRanges = 0;
+
+		[[nodiscard]] std::uint64_t bytesReclaimed() const noexcept {
+			return this->bytesBefore > this->bytesAfter ? this->bytesBefore - this->bytesAfter : 0;
+		}
+	};
+
+	// Bakes append to the patch archive (`*_999.vpk`) and never reclaim the data of replaced or removed entries
+	// This rewrites it with only the data the dir tree still references, then updates the dir tree and `.cam` offsets
+	// With reorderForLocality the live data is laid out in dir tree order, otherwise the existing order is kept
+	// Fails if there are unbaked changes
+	bool compactPatchArchive(bool reorderForLocality = true);
+
+	[[nodiscard]] const CompactStats& getLastCompactStats() const noexcept { return this->lastCompactStats; }
+
 	bool renameEntry(const std::string& oldPath_, const std::string& newPath_) override;
 	bool renameDirectory(const std::string& oldDir_, const std::string& newDir_) override;
 	bool removeEntry(const std::string& path_) override;
@@ -81,6 +175,8 @@ class RespawnVPK final : public vpkpp::PackFile {
 
 	// Extra per-entry metadata needed to read Respawn VPK parts
 	std::unordered_map<std::string, MetaEntry> metaEntries;
+	// Estimated size of metaEntries and the PackFile entries, charged to the memory accounting while this is open
+	respawn_vpk::memory::Charge metaEntriesCharge;
 
 	// For unbaked entries, store desired flags inferred from an existing entry or defaults
 	// Key is the cleaned entry path (same case rules as PackFile)
@@ -88,6 +184,39 @@ class RespawnVPK final : public vpkpp::PackFile {
 
 	mutable std::string lastError;
 
+	// Archive paths resolved for getStoredEntry by archive index, since resolving one stats the candidate paths
+	// Cleared whenever the archives may resolve differently (the pack moved or the archive set changed)
+	mutable std::unordered_map<std::uint16_t, std::string> storedArchivePaths;
+	mutable std::mutex storedArchivePathsMutex;
+
+	std::size_t bakeMemoryBudget = 64 * 1024 * 1024;
+	std::size_t bakeThreadCount = 0;
+	bool bakeHardlinkArchives = false;
+	BakeStats lastBakeStats;
+	CompactStats lastCompactStats;
+
+	// One file record of the dir tree, as written by bake
+	struct TreeItem {
+		std::string path;
+		std::string ext;
+		std::string dir;
+		std::string fileStem;
+		MetaEntry meta;
+		bool inPatchArchive = false;
+	};
+
+	[[nodiscard]] static TreeItem makeTreeItem(const std::string& path);
+	// Dir tree order: extension, then directory, then file name
+	static void sortTreeItems(std::vector<TreeItem>& treeItems, std::size_t threadCount);
+	// Sorts treeItems into tree order and writes the header and dir tree to dirVpkPath
+	[[nodiscard]] bool writeDirVpk(const std::string& dirVpkPath, std::vector<TreeItem>& treeItems, const EntryCallback& callback);
+	// Bake path for when there are no unbaked entries: the dir tree is rebuilt from metaEntries, archive data is untouched
+	[[nodiscard]] bool bakeMetadataOnly(const std::string& outputDir, const std::string& outDirVpkPath, const respawn_vpk::BakeLock& bakeLock, const respawn_vpk::Manifest* manifest, const EntryCallback& callback);
+	// Copy (or clone/link) an existing archive file to the bake output directory, recording it in lastBakeStats
+	[[nodiscard]] bool carryOverArchiveFile(const std::string& src, const std::string& dst, bool allowHardlink);
+	static void writeManifestForTree(const std::string& dirVpkPath, const std::vector<TreeItem>& treeItems);
+	void updateMetaEntriesCharge();
+
 	[[nodiscard]] static bool isRespawnVPKDirPath(std::string_view path);
 	[[nodiscard]] static bool readAndValidateHeader(std::ifstream& f, std::uint32_t& treeLength);
 
@@ -98,6 +227,8 @@ class RespawnVPK final : public vpkpp::PackFile {
 	[[nodiscard]] static bool readBytes(std::ifstream& f, std::vector<std::byte>& out, std::size_t n);
 
 	[[nodiscard]] static std::string buildArchivePath(const std::string& dirVpkPath, std::uint16_t archiveIndex);
+	[[nodiscard]] std::string getStoredArchivePath(std::uint16_t archiveIndex) const;
+	void clearStoredArchivePaths();
 	[[nodiscard]] static std::string stripPakLang(const std::string& path);
 	[[nodiscard]] static std::string stripPakLangFilenamePrefix(const std::string& path);
 	[[nodiscard]] static std::string makeArchivePathForWrite(const std::string& dirVpkPath, std::uint16_t archiveIndex);
@@ -0,0 +1,260 @@
+#include "RespawnVPKCompressionCache.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <system_error>
+#include <utility>
+
+namespace respawn_vpk {
+
+namespace {
+
+constexpr std::array<char, 4> CACHE_ENTRY_MAGIC{'R', 'V', 'C', 'C'};
+constexpr std::uint32_t CACHE_ENTRY_VERSION = 1;
+constexpr std::uint32_t CACHE_ENTRY_FLAG_INCOMPRESSIBLE = 1u << 0;
+
+// magic, version, flags, uncompressed size, compressed size, hash of the payload (low, high)
+constexpr std::size_t CACHE_ENTRY_HEADER_LEN = 4 + 4 + 4 + 8 + 8 + 16;
+
+// Temp files older than this are assumed to belong to a process that died mid-write
+constexpr auto STALE_TEMP_FILE_AGE = std::chrono::hours{1};
+
+// Keep this much below the limit after trimming, so every pack does not have to trim again
+constexpr std::uint64_t TRIM_TARGET_PERCENT = 90;
+
+// Versioned, so a layout change starts a new cache instead of misreading the old one
+constexpr std::string_view CACHE_SUBDIRECTORY = "rvpk-cc-v1";
+
+[[nodiscard]] bool isLowerHex(std::string_view s) {
+	return !s.empty() && std::all_of(s.begin(), s.end(), [](char c) {
+		return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+	});
+}
+
+[[nodiscard]] bool isAlnum(std::string_view s) {
+	return !s.empty() && std::all_of(s.begin(), s.end(), [](char c) {
+		return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+	});
+}
+
+enum class CacheFileKind {
+	OTHER,
+	ENTRY,
+	TEMP,
+};
+
+// Entries are `<32 hex>.<codec tag>` in the subdirectory named after their first two hex digits, temp files add
+// makeTempSuffix's `.<16 hex>-<counter>.tmp`
+[[nodiscard]] CacheFileKind getCacheFileKind(std::string_view subdirectory, std::string_view name) {
+	if (name.size() < 34 || !isLowerHex(name.substr(0, 32)) || name[32] != '.' || name.substr(0, 2) != subdirectory) {
+		return CacheFileKind::OTHER;
+	}
+	const auto rest = name.substr(33);
+	const auto dot = rest.find('.');
+	if (dot == std::string_view::npos) {
+		return isAlnum(rest) ? CacheFileKind::ENTRY : CacheFileKind::OTHER;
+	}
+	const auto suffix = rest.substr(dot + 1);
+	if (!isAlnum(rest.substr(0, dot)) || !suffix.ends_with(".tmp") || suffix.size() < 16 + 1 + 1 + 4 || suffix[16] != '-' || !isLowerHex(suffix.substr(0, 16))) {
+		return CacheFileKind::OTHER;
+	}
+	const auto counter = suffix.substr(17, suffix.size() - 17 - 4);
+	const bool digits = !counter.empty() && std::all_of(counter.begin(), counter.end(), [](char c) { return c >= '0' && c <= '9'; });
+	return digits ? CacheFileKind::TEMP : CacheFileKind::OTHER;
+}
+
+void writeLE(std::byte* out, std::uint64_t v, std::size_t n) {
+	for (std::size_t i = 0; i < n; i++) {
+		out[i] = static_cast<std::byte>((v >> (8 * i)) & 0xFFu);
+	}
+}
+
+[[nodiscard]] std::uint64_t readLE(const std::byte* in, std::size_t n) {
+	std::uint64_t v = 0;
+	for (std::size_t i = 0; i < n; i++) {
+		v |= static_cast<std::uint64_t>(in[i]) << (8 * i);
+	}
+	return v;
+}
+
+[[nodiscard]] std::string toHex(std::uint64_t v) {
+	static constexpr char digits[] = "0123456789abcdef";
+	std::string out(16, '0');
+	for (int i = 15; i >= 0; i--) {
+		out[i] = digits[v & 0xFu];
+		v >>= 4;
+	}
+	return out;
+}
+
+// Unique per process and call, so concurrent writers never share a temp file
+[[nodiscard]] std::string makeTempSuffix() {
+	static const std::uint64_t processNonce = [] {
+		std::random_device rd;
+		return (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+	}();
+	static std::atomic_uint64_t counter{0};
+	return '.' + toHex(processNonce) + '-' + std::to_string(counter.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+}
+
+} // namespace
+
+CompressionCache::CompressionCache(const std::filesystem::path& directory_, std::string codecTag_, std::uint64_t maxBytes_)
+		: directory(directory_ / CACHE_SUBDIRECTORY)
+		, codecTag(std::move(codecTag_))
+		, maxBytes(maxBytes_) {}
+
+std::filesystem::path CompressionCache::getEntryPath(const ContentHash& key) const {
+	const auto name = toHex(key.high) + toHex(key.low);
+	return this->directory / name.substr(0, 2) / (name + '.' + this->codecTag);
+}
+
+std::optional<std::vector<std::byte>> CompressionCache::find(const ContentHash& key, std::uint64_t uncompressedSize) {
+	const auto path = this->getEntryPath(key);
+	auto miss = [this]() -> std::optional<std::vector<std::byte>> {
+		this->misses.fetch_add(1, std::memory_order_relaxed);
+		return std::nullopt;
+	};
+
+	std::ifstream f{path, std::ios::binary};
+	if (!f) {
+		return miss();
+	}
+	std::array<std::byte, CACHE_ENTRY_HEADER_LEN> header{};
+	if (!f.read(reinterpret_cast<char*>(header.data()), header.size())) {
+		return miss();
+	}
+	if (std::memcmp(header.data(), CACHE_ENTRY_MAGIC.data(), CACHE_ENTRY_MAGIC.size()) != 0 || readLE(header.data() + 4, 4) != CACHE_ENTRY_VERSION) {
+		return miss();
+	}
+	const auto flags = static_cast<std::uint32_t>(readLE(header.data() + 8, 4));
+	const auto storedUncompressedSize = readLE(header.data() + 12, 8);
+	const auto compressedSize = readLE(header.data() + 20, 8);
+	const ContentHash payloadHash{readLE(header.data() + 28, 8), readLE(header.data() + 36, 8)};
+	if (storedUncompressedSize != uncompressedSize || compressedSize >= uncompressedSize) {
+		return miss();
+	}
+
+	std::vector<std::byte> out;
+	if (!(flags & CACHE_ENTRY_FLAG_INCOMPRESSIBLE)) {
+		out.resize(static_cast<std::size_t>(compressedSize));
+		if (!f.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(out.size()))) {
+			return miss();
+		}
+	}
+	// Guards against truncated or otherwise damaged entries, not against tampering
+	if (computeContentHash(out) != payloadHash) {
+		return miss();
+	}
+	f.close();
+
+	// The modification time doubles as the last access time for eviction
+	std::error_code ec;
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+
+	this->hits.fetch_add(1, std::memory_order_relaxed);
+	return out;
+}
+
+void CompressionCache::store(const ContentHash& key, std::uint64_t uncompressedSize, std::span<const std::byte> compressed) {
+	if (compressed.size() >= uncompressedSize) {
+		return;
+	}
+	const auto path = this->getEntryPath(key);
+
+	std::array<std::byte, CACHE_ENTRY_HEADER_LEN> header{};
+	std::memcpy(header.data(), CACHE_ENTRY_MAGIC.data(), CACHE_ENTRY_MAGIC.size());
+	writeLE(header.data() + 4, CACHE_ENTRY_VERSION, 4);
+	writeLE(header.data() + 8, compressed.empty() ? CACHE_ENTRY_FLAG_INCOMPRESSIBLE : 0, 4);
+	writeLE(header.data() + 12, uncompressedSize, 8);
+	writeLE(header.data() + 20, compressed.size(), 8);
+	const auto payloadHash = computeContentHash(compressed);
+	writeLE(header.data() + 28, payloadHash.low, 8);
+	writeLE(header.data() + 36, payloadHash.high, 8);
+
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	// Readers only ever see complete entries: write a private temp file, then rename it over the real name
+	auto tmpPath = path;
+	tmpPath += makeTempSuffix();
+	{
+		std::ofstream f{tmpPath, std::ios::binary | std::ios::trunc};
+		f.write(reinterpret_cast<const char*>(header.data()), header.size());
+		f.write(reinterpret_cast<const char*>(compressed.data()), static_cast<std::streamsize>(compressed.size()));
+		f.close();
+		if (!f) {
+			std::filesystem::remove(tmpPath, ec);
+			return;
+		}
+	}
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec) {
+		// Most likely another process stored the same entry and it is open for reading, that copy is as good as ours
+		std::filesystem::remove(tmpPath, ec);
+	}
+}
+
+void CompressionCache::trim() {
+	struct CacheFile {
+		std::filesystem::path path;
+		std::filesystem::file_time_type lastUse;
+		std::uint64_t size;
+	};
+	std::vector<CacheFile> files;
+	std::uint64_t totalBytes = 0;
+
+	const auto now = std::filesystem::file_time_type::clock::now();
+	std::error_code ec;
+	for (auto dirIt = std::filesystem::directory_iterator{this->directory, std::filesystem::directory_options::skip_permission_denied, ec};
+	     !ec && dirIt != std::filesystem::directory_iterator{}; dirIt.increment(ec)) {
+		std::error_code dirEc;
+		const auto subdirectory = dirIt->path().filename().string();
+		if (subdirectory.size() != 2 || !isLowerHex(subdirectory) || !dirIt->is_directory(dirEc)) {
+			continue;
+		}
+		for (auto it = std::filesystem::directory_iterator{dirIt->path(), std::filesystem::directory_options::skip_permission_denied, dirEc};
+		     !dirEc && it != std::filesystem::directory_iterator{}; it.increment(dirEc)) {
+			const auto kind = getCacheFileKind(subdirectory, it->path().filename().string());
+			std::error_code fileEc;
+			if (kind == CacheFileKind::OTHER || !it->is_regular_file(fileEc)) {
+				continue;
+			}
+			const auto lastUse = it->last_write_time(fileEc);
+			const auto size = it->file_size(fileEc);
+			if (fileEc) {
+				continue;
+			}
+			if (kind == CacheFileKind::TEMP) {
+				if (now - lastUse > STALE_TEMP_FILE_AGE) {
+					std::filesystem::remove(it->path(), fileEc);
+				}
+				continue;
+			}
+			files.push_back({it->path(), lastUse, size});
+			totalBytes += size;
+		}
+	}
+	if (totalBytes <= this->maxBytes) {
+		return;
+	}
+
+	std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) {
+		return a.lastUse < b.lastUse;
+	});
+	const auto target = this->maxBytes / 100 * TRIM_TARGET_PERCENT;
+	for (const auto& file : files) {
+		if (totalBytes <= target) {
+			break;
+		}
+		// Another process may be trimming too, an entry that is already gone still counts as freed
+		std::filesystem::remove(file.path, ec);
+		totalBytes -= file.size;
+	}
+}
+
+} // namespace respawn_vpk
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "RespawnVPKHash.h"
+
+namespace respawn_vpk {
+
+// On-disk cache of compressed part data, keyed by the hash of the uncompressed bytes and the codec parameters
+// Entries are written to a temp file and renamed into place, so several packer processes can share one cache
+// Each hit refreshes the entry's modification time, trim() evicts the least recently used entries
+// Everything lives under `<directory>/rvpk-cc-v1/`, so pointing the cache at a folder with other files in it is safe
+class CompressionCache {
+public:
+	// codecTag names the codec and its parameters (letters and digits), entries written with a different tag are never
+	// returned
+	CompressionCache(const std::filesystem::path& directory, std::string codecTag, std::uint64_t maxBytes);
+
+	// Compressed bytes for data of this hash and length, or nullopt on a miss
+	// An empty result means the data was stored as not compressible (compressing it did not make it smaller)
+	[[nodiscard]] std::optional<std::vector<std::byte>> find(const ContentHash& key, std::uint64_t uncompressedSize);
+
+	// Store the compressed form of the data; pass an empty span to record that it does not compress
+	// Failures are not reported, a cache that cannot be written just stops saving time
+	void store(const ContentHash& key, std::uint64_t uncompressedSize, std::span<const std::byte> compressed);
+
+	// Evict least recently used entries until the cache fits in maxBytes (with some headroom)
+	// Also removes temp files abandoned by processes that died mid-write
+	// Only files named like cache entries and their temp files are counted or removed, anything else is left alone
+	void trim();
+
+	[[nodiscard]] std::uint64_t getHits() const noexcept { return this->hits.load(std::memory_order_relaxed); }
+	[[nodiscard]] std::uint64_t getMisses() const noexcept { return this->misses.load(std::memory_order_relaxed); }
+
+private:
+	[[nodiscard]] std::filesystem::path getEntryPath(const ContentHash& key) const;
+
+	std::filesystem::path directory;
+	std::string codecTag;
+	std::uint64_t maxBytes;
+
+	std::atomic_uint64_t hits{0};
+	std::atomic_uint64_t misses{0};
+};
+
+} // namespace respawn_vpk
@@ -0,0 +1,192 @@
+#include "RespawnVPKCopy.h"
+
+#include <algorithm>
+#include <system_error>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+
+namespace respawn_vpk {
+
+namespace {
+
+#if defined(__linux__)
+class ScopedFd {
+public:
+	explicit ScopedFd(int fd_) : fd(fd_) {}
+	ScopedFd(const ScopedFd&) = delete;
+	ScopedFd& operator=(const ScopedFd&) = delete;
+	ScopedFd(ScopedFd&&) = delete;
+	ScopedFd& operator=(ScopedFd&& other) noexcept {
+		if (this != &other) {
+			(void) this->close();
+			this->fd = other.fd;
+			other.fd = -1;
+		}
+		return *this;
+	}
+	~ScopedFd() {
+		if (this->fd >= 0) {
+			::close(this->fd);
+		}
+	}
+
+	[[nodiscard]] int get() const {
+		return this->fd;
+	}
+
+	[[nodiscard]] bool close() {
+		const int f = this->fd;
+		this->fd = -1;
+		return f < 0 || ::close(f) == 0;
+	}
+
+private:
+	int fd;
+};
+
+struct FdPair {
+	ScopedFd in{-1};
+	ScopedFd out{-1};
+	std::uint64_t size = 0;
+};
+
+// Open src for reading and create dst (which must not exist) with the same permissions
+[[nodiscard]] bool openFdPair(const std::filesystem::path& src, const std::filesystem::path& dst, FdPair& fds) {
+	fds.in = ScopedFd{::open(src.c_str(), O_RDONLY | O_CLOEXEC)};
+	if (fds.in.get() < 0) {
+		return false;
+	}
+	struct stat st{};
+	if (::fstat(fds.in.get(), &st) != 0) {
+		return false;
+	}
+	fds.size = static_cast<std::uint64_t>(st.st_size);
+	fds.out = ScopedFd{::open(dst.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 0777)};
+	return fds.out.get() >= 0;
+}
+
+[[nodiscard]] bool tryReflink(const std::filesystem::path& src, const std::filesystem::path& dst) {
+	FdPair fds;
+	if (!openFdPair(src, dst, fds)) {
+		return false;
+	}
+	if (::ioctl(fds.out.get(), FICLONE, fds.in.get()) == 0 && fds.out.close()) {
+		return true;
+	}
+	(void) fds.out.close();
+	::unlink(dst.c_str());
+	return false;
+}
+
+[[nodiscard]] bool tryCopyFileRange(const std::filesystem::path& src, const std::filesystem::path& dst) {
+	FdPair fds;
+	if (!openFdPair(src, dst, fds)) {
+		return false;
+	}
+	auto remaining = fds.size;
+	while (remaining > 0) {
+		const auto n = ::copy_file_range(fds.in.get(), nullptr, fds.out.get(), nullptr, static_cast<std::size_t>(std::min<std::uint64_t>(remaining, 1ull << 30)), 0);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			// EXDEV on older kernels, ENOSYS/EOPNOTSUPP on some filesystems; the plain copy handles those
+			(void) fds.out.close();
+			::unlink(dst.c_str());
+			return false;
+		}
+		remaining -= static_cast<std::uint64_t>(n);
+	}
+	if (!fds.out.close()) {
+		::unlink(dst.c_str());
+		return false;
+	}
+	return true;
+}
+#endif
+
+} // namespace
+
+std::string_view carryOverStrategyName(CarryOverStrategy strategy) {
+	switch (strategy) {
+		case CarryOverStrategy::NONE:            return "none";
+		case CarryOverStrategy::SAME_FILE:       return "same file";
+		case CarryOverStrategy::REFLINK:         return "reflink";
+		case CarryOverStrategy::HARDLINK:        return "hardlink";
+		case CarryOverStrategy::COPY_FILE_RANGE: return "copy_file_range";
+		case CarryOverStrategy::COPY:            return "copy";
+	}
+	return "unknown";
+}
+
+std::optional<CarryOverStrategy> carryOverFile(const std::filesystem::path& src, const std::filesystem::path& dst, bool allowHardlink, std::string* outError) {
+	std::error_code ec;
+	if (std::filesystem::equivalent(src, dst, ec) && !ec) {
+		return CarryOverStrategy::SAME_FILE;
+	}
+
+	// Build the copy next to dst and rename it over dst at the end: a failed copy leaves an existing dst untouched,
+	// and if dst is a hard link to some other archive, replacing the name can't write through to that archive
+	auto tmp = dst;
+	tmp += ".carry.tmp";
+	ec.clear();
+	std::filesystem::remove(tmp, ec);
+
+	const auto strategy = [&]() -> std::optional<CarryOverStrategy> {
+#if defined(__linux__)
+		if (tryReflink(src, tmp)) {
+			return CarryOverStrategy::REFLINK;
+		}
+#elif defined(__APPLE__)
+		if (::clonefile(src.c_str(), tmp.c_str(), 0) == 0) {
+			return CarryOverStrategy::REFLINK;
+		}
+#endif
+
+		if (allowHardlink) {
+			ec.clear();
+			std::filesystem::create_hard_link(src, tmp, ec);
+			if (!ec) {
+				return CarryOverStrategy::HARDLINK;
+			}
+		}
+
+#if defined(__linux__)
+		if (tryCopyFileRange(src, tmp)) {
+			return CarryOverStrategy::COPY_FILE_RANGE;
+		}
+#endif
+
+		ec.clear();
+		std::filesystem::copy_file(src, tmp, std::filesystem::copy_options::overwrite_existing, ec);
+		if (ec) {
+			return std::nullopt;
+		}
+		return CarryOverStrategy::COPY;
+	}();
+
+	if (strategy) {
+		ec.clear();
+		std::filesystem::rename(tmp, dst, ec);
+		if (!ec) {
+			return strategy;
+		}
+	}
+	if (outError) {
+		*outError = "failed to copy \"" + src.string() + "\" to \"" + dst.string() + "\": " + ec.message();
+	}
+	std::error_code removeEc;
+	std::filesystem::remove(tmp, removeEc);
+	return std::nullopt;
+}
+
+} // namespace respawn_vpk
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace respawn_vpk {
+
+// How a file was carried over to a new location, ordered from cheapest to most expensive
+enum class CarryOverStrategy : std::uint8_t {
+	NONE,            // nothing was carried over
+	SAME_FILE,       // source and destination are already the same file
+	REFLINK,         // copy-on-write clone (FICLONE on Linux, clonefile on macOS)
+	HARDLINK,        // hard link, only when explicitly allowed
+	COPY_FILE_RANGE, // in-kernel copy, no round trip through user space
+	COPY,            // plain std::filesystem::copy_file
+};
+
+[[nodiscard]] std::string_view carryOverStrategyName(CarryOverStrategy strategy);
+
+// Make `dst` a copy of `src`, trying reflink, hardlink (if allowHardlink), copy_file_range, then a plain copy
+// The copy is made under a temp name and renamed over `dst`: an existing `dst` is replaced, never written through (so a
+// previous hard link to `src` can't clobber it), and stays as it was if the copy fails
+// Hard links share data with the source: only allow them for files that will never be modified in place
+[[nodiscard]] std::optional<CarryOverStrategy> carryOverFile(
+	const std::filesystem::path& src,
+	const std::filesystem::path& dst,
+	bool allowHardlink,
+	std::string* outError = nullptr);
+
+} // namespace respawn_vpk
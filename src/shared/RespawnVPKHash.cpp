@@ -0,0 +1,72 @@
+#include "RespawnVPKHash.h"
+
+#include <array>
+
+// Keep xxHash private to this translation unit
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "RespawnVPKTrace.h"
+
+namespace respawn_vpk {
+
+namespace {
+
+// Reflected CRC-32 polynomial, as used by zlib and the VPK formats
+constexpr std::uint32_t CRC32_POLY = 0xEDB88320u;
+
+// a * b modulo the CRC polynomial, both in reflected bit order
+[[nodiscard]] constexpr std::uint32_t multModP(std::uint32_t a, std::uint32_t b) {
+	std::uint32_t m = 1u << 31;
+	std::uint32_t p = 0;
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0) {
+				break;
+			}
+		}
+		m >>= 1;
+		b = (b & 1) ? (b >> 1) ^ CRC32_POLY : b >> 1;
+	}
+	return p;
+}
+
+// x^(2^n) modulo the CRC polynomial for n = 0..31
+constexpr auto X2N_TABLE = [] {
+	std::array<std::uint32_t, 32> table{};
+	std::uint32_t p = 1u << 30; // x^1
+	table[0] = p;
+	for (std::size_t n = 1; n < table.size(); n++) {
+		table[n] = p = multModP(p, p);
+	}
+	return table;
+}();
+
+// x^(n * 2^k) modulo the CRC polynomial
+[[nodiscard]] std::uint32_t x2nModP(std::uint64_t n, unsigned k) {
+	std::uint32_t p = 1u << 31; // x^0
+	while (n) {
+		if (n & 1) {
+			p = multModP(X2N_TABLE[k & 31], p);
+		}
+		n >>= 1;
+		k++;
+	}
+	return p;
+}
+
+} // namespace
+
+ContentHash computeContentHash(std::span<const std::byte> data) {
+	RESPAWN_VPK_TRACE_SCOPE("hash.content");
+	const auto h = XXH3_128bits(data.data(), data.size());
+	return {h.low64, h.high64};
+}
+
+std::uint32_t combineCRC32(std::uint32_t crcA, std::uint32_t crcB, std::uint64_t lengthB) {
+	// Shift crcA past lengthB zero bytes (x^(8 * lengthB)), then add crcB
+	return multModP(x2nModP(lengthB, 3), crcA) ^ crcB;
+}
+
+} // namespace respawn_vpk
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace respawn_vpk {
+
+// 128-bit content hash (XXH3-128) used as the dedup key for archive data
+// Collisions are not a practical concern at this width, so matching data is never compared byte-for-byte
+struct ContentHash {
+	std::uint64_t low = 0;
+	std::uint64_t high = 0;
+
+	[[nodiscard]] bool operator==(const ContentHash&) const = default;
+};
+
+struct ContentHashHasher {
+	[[nodiscard]] std::size_t operator()(const ContentHash& h) const noexcept {
+		// The hash is already uniformly distributed
+		return static_cast<std::size_t>(h.low);
+	}
+};
+
+[[nodiscard]] ContentHash computeContentHash(std::span<const std::byte> data);
+
+// CRC-32 (IEEE) of A followed by B, given the CRCs of both and the length of B
+// Lets parts of a file be checksummed independently and still produce the CRC of the whole file
+[[nodiscard]] std::uint32_t combineCRC32(std::uint32_t crcA, std::uint32_t crcB, std::uint64_t lengthB);
+
+} // namespace respawn_vpk
@@ -0,0 +1,362 @@
+#include "RespawnVPKJournal.h"
+
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include "RespawnVPKTrace.h"
+
+namespace respawn_vpk {
+
+namespace {
+
+constexpr std::string_view JOURNAL_MAGIC = "RVPK_BAKE_JOURNAL 1";
+
+#ifndef _WIN32
+[[nodiscard]] bool syncPath(const std::string& path, int flags) {
+	const int fd = ::open(path.c_str(), flags | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	const bool ok = ::fsync(fd) == 0;
+	::close(fd);
+	return ok;
+}
+#endif
+
+[[nodiscard]] std::filesystem::path getJournalDirectory(const std::string& journalPath) {
+	std::error_code ec;
+	auto path = std::filesystem::absolute(journalPath, ec);
+	if (ec) {
+		path = journalPath;
+	}
+	return path.lexically_normal().parent_path();
+}
+
+// Written relative to the journal's directory, so recovery works from any working directory
+[[nodiscard]] std::string encodeJournalPath(const std::filesystem::path& journalDir, const std::string& path) {
+	std::error_code ec;
+	auto absolute = std::filesystem::absolute(path, ec);
+	if (ec) {
+		return path;
+	}
+	absolute = absolute.lexically_normal();
+	const auto relative = absolute.lexically_relative(journalDir);
+	if (relative.empty() || *relative.begin() == "..") {
+		return absolute.string();
+	}
+	return relative.string();
+}
+
+[[nodiscard]] std::string decodeJournalPath(const std::filesystem::path& journalDir, const std::string& path) {
+	const std::filesystem::path p{path};
+	return p.is_absolute() ? path : (journalDir / p).string();
+}
+
+} // namespace
+
+std::string getBakeJournalPath(const std::string& dirVpkPath) {
+	return dirVpkPath + ".journal";
+}
+
+std::string getBakeLockPath(const std::string& dirVpkPath) {
+	return dirVpkPath + ".lock";
+}
+
+BakeLock::~BakeLock() {
+	this->unlock();
+}
+
+bool BakeLock::tryLock(const std::string& dirVpkPath_, std::string* outError) {
+	this->unlock();
+	const auto lockPath = getBakeLockPath(dirVpkPath_);
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path{lockPath}.parent_path(), ec);
+#ifdef _WIN32
+	const auto handle_ = ::CreateFileW(std::filesystem::path{lockPath}.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle_ == INVALID_HANDLE_VALUE) {
+		if (outError) {
+			*outError = "failed to open lock file: " + lockPath;
+		}
+		return false;
+	}
+	OVERLAPPED overlapped{};
+	if (!::LockFileEx(handle_, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, MAXDWORD, MAXDWORD, &overlapped)) {
+		::CloseHandle(handle_);
+		if (outError) {
+			*outError = "another bake of \"" + dirVpkPath_ + "\" is in progress";
+		}
+		return false;
+	}
+	this->handle = handle_;
+#else
+	const int fd_ = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd_ < 0) {
+		if (outError) {
+			*outError = "failed to open lock file: " + lockPath;
+		}
+		return false;
+	}
+	int rc;
+	do {
+		rc = ::flock(fd_, LOCK_EX | LOCK_NB);
+	} while (rc != 0 && errno == EINTR);
+	if (rc != 0) {
+		::close(fd_);
+		if (outError) {
+			*outError = "another bake of \"" + dirVpkPath_ + "\" is in progress";
+		}
+		return false;
+	}
+	this->fd = fd_;
+#endif
+	this->dirVpkPath = dirVpkPath_;
+	return true;
+}
+
+void BakeLock::unlock() {
+#ifdef _WIN32
+	if (this->handle) {
+		OVERLAPPED overlapped{};
+		::UnlockFileEx(this->handle, 0, MAXDWORD, MAXDWORD, &overlapped);
+		::CloseHandle(this->handle);
+		this->handle = nullptr;
+	}
+#else
+	if (this->fd >= 0) {
+		// Closing the descriptor releases the flock
+		::close(this->fd);
+		this->fd = -1;
+	}
+#endif
+	this->dirVpkPath.clear();
+}
+
+bool BakeLock::isLocked() const {
+#ifdef _WIN32
+	return this->handle != nullptr;
+#else
+	return this->fd >= 0;
+#endif
+}
+
+bool syncFile(const std::string& path) {
+	RESPAWN_VPK_TRACE_SCOPE("io.sync");
+#ifdef _WIN32
+	const auto handle = ::CreateFileW(std::filesystem::path{path}.wstring().c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	const bool ok = ::FlushFileBuffers(handle) != 0;
+	::CloseHandle(handle);
+	return ok;
+#else
+	return syncPath(path, O_RDONLY);
+#endif
+}
+
+bool syncParentDirectory(const std::string& path) {
+#ifdef _WIN32
+	// NTFS journals metadata itself, directories can't be flushed this way
+	(void) path;
+	return true;
+#else
+	auto parent = std::filesystem::path{path}.parent_path().string();
+	if (parent.empty()) {
+		parent = ".";
+	}
+	return syncPath(parent, O_RDONLY | O_DIRECTORY);
+#endif
+}
+
+bool writeBakeJournal(const std::string& journalPath, const BakeJournal& journal, std::string* outError) {
+	// Paths can't contain newlines or tabs on any platform we care about, so a line-based format is enough
+	const auto journalDir = getJournalDirectory(journalPath);
+	std::ostringstream out;
+	out << JOURNAL_MAGIC << '\n';
+	out << "phase\t" << (journal.phase == BakeJournal::Phase::COMMIT ? "commit" : "prepare") << '\n';
+	for (const auto& [path, length] : journal.appends) {
+		out << "append\t" << length << '\t' << encodeJournalPath(journalDir, path) << '\n';
+	}
+	for (const auto& path : journal.creates) {
+		out << "create\t" << encodeJournalPath(journalDir, path) << '\n';
+	}
+	for (const auto& [from, to] : journal.renames) {
+		out << "rename\t" << encodeJournalPath(journalDir, from) << '\t' << encodeJournalPath(journalDir, to) << '\n';
+	}
+	for (const auto& path : journal.removes) {
+		out << "remove\t" << encodeJournalPath(journalDir, path) << '\n';
+	}
+	out << "end\n";
+
+	const auto tmpPath = journalPath + ".tmp";
+	{
+		std::ofstream f{tmpPath, std::ios::binary | std::ios::trunc};
+		const auto data = out.str();
+		f.write(data.data(), static_cast<std::streamsize>(data.size()));
+		f.close();
+		if (!f) {
+			if (outError) {
+				*outError = "failed to write bake journal: " + tmpPath;
+			}
+			return false;
+		}
+	}
+	std::error_code ec;
+	if (syncFile(tmpPath)) {
+		std::filesystem::rename(tmpPath, journalPath, ec);
+		if (!ec && syncParentDirectory(journalPath)) {
+			return true;
+		}
+	}
+	if (outError) {
+		*outError = "failed to write bake journal: " + journalPath;
+	}
+	return false;
+}
+
+std::optional<BakeJournal> readBakeJournal(const std::string& journalPath) {
+	std::ifstream f{journalPath, std::ios::binary};
+	if (!f) {
+		return std::nullopt;
+	}
+
+	std::string line;
+	if (!std::getline(f, line) || line != JOURNAL_MAGIC) {
+		return std::nullopt;
+	}
+
+	const auto journalDir = getJournalDirectory(journalPath);
+	BakeJournal journal;
+	bool sawEnd = false;
+	while (std::getline(f, line)) {
+		const auto tab = line.find('\t');
+		const auto key = line.substr(0, tab);
+		const auto rest = tab == std::string::npos ? std::string{} : line.substr(tab + 1);
+		if (key == "phase") {
+			journal.phase = rest == "commit" ? BakeJournal::Phase::COMMIT : BakeJournal::Phase::PREPARE;
+		} else if (key == "append") {
+			const auto tab2 = rest.find('\t');
+			std::uint64_t length = 0;
+			if (tab2 == std::string::npos || std::from_chars(rest.data(), rest.data() + tab2, length).ec != std::errc{}) {
+				return std::nullopt;
+			}
+			journal.appends.emplace_back(decodeJournalPath(journalDir, rest.substr(tab2 + 1)), length);
+		} else if (key == "create") {
+			journal.creates.push_back(decodeJournalPath(journalDir, rest));
+		} else if (key == "remove") {
+			journal.removes.push_back(decodeJournalPath(journalDir, rest));
+		} else if (key == "rename") {
+			const auto tab2 = rest.find('\t');
+			if (tab2 == std::string::npos) {
+				return std::nullopt;
+			}
+			journal.renames.emplace_back(decodeJournalPath(journalDir, rest.substr(0, tab2)), decodeJournalPath(journalDir, rest.substr(tab2 + 1)));
+		} else if (key == "end") {
+			sawEnd = true;
+			break;
+		}
+	}
+	// Journals are only ever replaced atomically, but don't act on a truncated one
+	if (!sawEnd) {
+		return std::nullopt;
+	}
+	return journal;
+}
+
+bool commitBake(const std::string& journalPath, BakeJournal& journal, std::string* outError) {
+	RESPAWN_VPK_TRACE_SCOPE("journal.commit");
+	journal.phase = BakeJournal::Phase::COMMIT;
+	if (!writeBakeJournal(journalPath, journal, outError)) {
+		return false;
+	}
+
+	// From here on the bake is durable: if anything below fails, recovery finishes it
+	std::error_code ec;
+	for (const auto& [from, to] : journal.renames) {
+		if (!std::filesystem::exists(from, ec)) {
+			// Already renamed by an earlier (interrupted) commit, or the bake never needed this file
+			continue;
+		}
+		std::filesystem::rename(from, to, ec);
+		if (ec) {
+			if (outError) {
+				*outError = "failed to move \"" + from + "\" into place: " + ec.message();
+			}
+			return false;
+		}
+		(void) syncParentDirectory(to);
+	}
+
+	// Only once the new dir VPK is in place, until then the old one may still reference these
+	for (const auto& path : journal.removes) {
+		std::filesystem::remove(path, ec);
+	}
+
+	std::filesystem::remove(journalPath, ec);
+	return true;
+}
+
+void rollbackBake(const std::string& journalPath, const BakeJournal& journal) {
+	std::error_code ec;
+	for (const auto& [path, length] : journal.appends) {
+		if (std::filesystem::is_regular_file(path, ec) && std::filesystem::file_size(path, ec) > length) {
+			std::filesystem::resize_file(path, length, ec);
+			(void) syncFile(path);
+		}
+	}
+	for (const auto& path : journal.creates) {
+		std::filesystem::remove(path, ec);
+	}
+	for (const auto& [from, to] : journal.renames) {
+		std::filesystem::remove(from, ec);
+	}
+	std::filesystem::remove(journalPath, ec);
+}
+
+bool recoverInterruptedBake(const std::string& dirVpkPath, std::string* outError) {
+	std::error_code ec;
+	if (!std::filesystem::exists(getBakeJournalPath(dirVpkPath), ec)) {
+		return true;
+	}
+	// Held by a bake that is still writing: its journal is not abandoned, and rolling it back would pull its files
+	// out from under it. tryLock also fails in a read-only directory, where nothing could be recovered anyway
+	BakeLock lock;
+	if (!lock.tryLock(dirVpkPath)) {
+		return true;
+	}
+	return recoverInterruptedBake(lock, outError);
+}
+
+bool recoverInterruptedBake(const BakeLock& lock, std::string* outError) {
+	const auto journalPath = getBakeJournalPath(lock.getDirVpkPath());
+	std::error_code ec;
+	if (!std::filesystem::exists(journalPath, ec)) {
+		return true;
+	}
+
+	auto journal = readBakeJournal(journalPath);
+	if (!journal) {
+		// A journal is only renamed into place once complete, so this was never a valid bake
+		std::filesystem::remove(journalPath, ec);
+		return true;
+	}
+	if (journal->phase == BakeJournal::Phase::COMMIT) {
+		return commitBake(journalPath, *journal, outError);
+	}
+	rollbackBake(journalPath, *journal);
+	return true;
+}
+
+} // namespace respawn_vpk
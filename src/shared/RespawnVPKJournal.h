@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace respawn_vpk {
+
+// Crash-safety journal for Respawn VPK bakes, stored next to the dir VPK as `<name>_dir.vpk.journal`
+//
+// A bake writes new files to temp paths and appends to existing archives in place. The journal records
+// the length each appended file had before the bake and which temp files replace which final files.
+// - PREPARE: nothing is visible yet. Recovery truncates appended files back and deletes the temp files
+// - COMMIT: every temp file was synced. Recovery finishes the renames and removals (the bake "resumes" its commit)
+// Paths are written relative to the journal's directory (absolute if they are elsewhere), so any process can recover
+struct BakeJournal {
+	enum class Phase : std::uint8_t {
+		PREPARE,
+		COMMIT,
+	};
+
+	Phase phase = Phase::PREPARE;
+
+	// Files appended to in place, with the length to roll back to
+	std::vector<std::pair<std::string, std::uint64_t>> appends;
+
+	// Files written in place that did not exist before the bake, deleted on rollback
+	std::vector<std::string> creates;
+
+	// Temp file -> final path, applied in order on commit (the dir VPK must come last)
+	std::vector<std::pair<std::string, std::string>> renames;
+
+	// Files the new dir VPK no longer references, deleted on commit once the renames are done
+	std::vector<std::string> removes;
+};
+
+[[nodiscard]] std::string getBakeJournalPath(const std::string& dirVpkPath);
+
+[[nodiscard]] std::string getBakeLockPath(const std::string& dirVpkPath);
+
+// Exclusive lock on `<name>_dir.vpk.lock` (flock / LockFileEx), held by a bake, compaction or pack for as long as it
+// writes to the pack. The lock file itself is left in place, removing it would let two writers lock different files
+class BakeLock {
+public:
+	BakeLock() = default;
+
+	~BakeLock();
+
+	BakeLock(const BakeLock&) = delete;
+	BakeLock& operator=(const BakeLock&) = delete;
+
+	// Fails right away if the lock is held, by another process or another BakeLock in this one
+	[[nodiscard]] bool tryLock(const std::string& dirVpkPath_, std::string* outError = nullptr);
+
+	void unlock();
+
+	[[nodiscard]] bool isLocked() const;
+
+	[[nodiscard]] const std::string& getDirVpkPath() const {
+		return this->dirVpkPath;
+	}
+
+private:
+	std::string dirVpkPath;
+#ifdef _WIN32
+	void* handle = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+// Write the journal atomically (temp file, fsync, rename)
+[[nodiscard]] bool writeBakeJournal(const std::string& journalPath, const BakeJournal& journal, std::string* outError = nullptr);
+
+[[nodiscard]] std::optional<BakeJournal> readBakeJournal(const std::string& journalPath);
+
+// Mark the journal committed, then rename every temp file into place, delete the removed files and remove the journal
+// All temp files and appended files must already be synced
+[[nodiscard]] bool commitBake(const std::string& journalPath, BakeJournal& journal, std::string* outError = nullptr);
+
+// Undo a prepared bake: truncate appended files to their recorded lengths, delete temp files, remove the journal
+void rollbackBake(const std::string& journalPath, const BakeJournal& journal);
+
+// If an interrupted bake left a journal next to this dir VPK, roll it forward or back
+// A journal whose lock is held belongs to a bake that is still running and is left alone
+// Returns false only if a journal exists and could not be applied
+[[nodiscard]] bool recoverInterruptedBake(const std::string& dirVpkPath, std::string* outError = nullptr);
+
+// Same, for a writer that already holds the pack's lock
+[[nodiscard]] bool recoverInterruptedBake(const BakeLock& lock, std::string* outError = nullptr);
+
+// Rolls a prepared bake back unless dismissed, so every early return leaves the pack as it was
+class BakeRollbackGuard {
+public:
+	BakeRollbackGuard(std::string journalPath_, const BakeJournal& journal_)
+			: journalPath(std::move(journalPath_))
+			, journal(journal_) {}
+
+	BakeRollbackGuard(const BakeRollbackGuard&) = delete;
+	BakeRollbackGuard& operator=(const BakeRollbackGuard&) = delete;
+
+	~BakeRollbackGuard() {
+		if (this->armed) {
+			rollbackBake(this->journalPath, this->journal);
+		}
+	}
+
+	void dismiss() {
+		this->armed = false;
+	}
+
+private:
+	std::string journalPath;
+	const BakeJournal& journal;
+	bool armed = true;
+};
+
+// Flush a file's data (and the directory holding it, so a rename is durable) to disk
+[[nodiscard]] bool syncFile(const std::string& path);
+[[nodiscard]] bool syncParentDirectory(const std::string& path);
+
+} // namespace respawn_vpk
@@ -1,17 +1,41 @@
 #include "RespawnVPKManifest.h"
 
 #include <algorithm>
+#include <array>
 #include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <random>
 
 #include <kvpp/KV1.h>
-#include <kvpp/KV1Writer.h>
 #include <sourcepp/FS.h>
 #include <sourcepp/String.h>
 
+#include "RespawnVPKCopy.h"
+#include "RespawnVPKHash.h"
+#include "RespawnVPKStats.h"
+#include "RespawnVPKTrace.h"
+
 namespace respawn_vpk {
 
 namespace {
 
+constexpr std::array<char, 4> MANIFEST_CACHE_MAGIC{'R', 'V', 'M', 'B'};
+constexpr std::uint32_t MANIFEST_CACHE_VERSION = 1;
+
+// magic, version, text file size, text file modification time, payload size, hash of the payload (low, high)
+constexpr std::size_t MANIFEST_CACHE_HEADER_LEN = 4 + 4 + 8 + 8 + 8 + 16;
+
+// entry count, key bytes, then per record: key offset, key length, preloadSize, textureFlags, loadFlags, flags
+constexpr std::size_t MANIFEST_BINARY_HEADER_LEN = 4 + 4;
+constexpr std::size_t MANIFEST_BINARY_RECORD_LEN = 4 + 4 + 2 + 2 + 4 + 1;
+constexpr std::uint8_t MANIFEST_RECORD_USE_COMPRESSION = 1u << 0;
+constexpr std::uint8_t MANIFEST_RECORD_DEDUPLICATE = 1u << 1;
+
+// The text writer hands the file this much at a time
+constexpr std::size_t MANIFEST_TEXT_FLUSH_SIZE = 1024 * 1024;
+
 static constexpr std::string_view LANGS[] = {
 	"english", "french", "german", "italian", "japanese", "korean",
 	"polish", "portugese", "russian", "spanish", "tchinese", "schinese"
@@ -39,21 +63,177 @@ static constexpr std::string_view LANGS[] = {
 	return name;
 }
 
-[[nodiscard]] std::vector<std::filesystem::path> manifestCandidatePaths(const std::filesystem::path& dirVpkPath) {
-	const auto parent = dirVpkPath.parent_path();
-	const auto stem = dirVpkPath.stem().string();
-	const auto strippedStem = stripLocaleTokensFromFilename(stem);
-
-	std::vector<std::filesystem::path> out;
-	out.reserve(3);
+void writeLE(std::byte* out, std::uint64_t v, std::size_t n) {
+	for (std::size_t i = 0; i < n; i++) {
+		out[i] = static_cast<std::byte>((v >> (8 * i)) & 0xFFu);
+	}
+}
 
-	out.push_back(parent / "manifest" / (stem + ".txt"));
-	if (!sourcepp::string::iequals(stem, strippedStem)) {
-		out.push_back(parent / "manifest" / (strippedStem + ".txt"));
+[[nodiscard]] std::uint64_t readLE(const std::byte* in, std::size_t n) {
+	std::uint64_t v = 0;
+	for (std::size_t i = 0; i < n; i++) {
+		v |= static_cast<std::uint64_t>(in[i]) << (8 * i);
 	}
+	return v;
+}
+
+// Readers never see a partial file: write to a private temp path next to it, then rename over the real name
+[[nodiscard]] std::filesystem::path makeTempPath(const std::filesystem::path& path) {
+	auto out = path;
+	out += '.' + std::to_string(std::random_device{}()) + ".tmp";
 	return out;
 }
 
+[[nodiscard]] std::filesystem::path getManifestCachePath(const std::filesystem::path& textPath) {
+	auto out = textPath;
+	out += ".bin";
+	return out;
+}
+
+// What the cache was built from, it is only used while the text file still matches
+struct ManifestTextStamp {
+	std::uint64_t size = 0;
+	std::uint64_t modified = 0;
+};
+
+[[nodiscard]] std::optional<ManifestTextStamp> getManifestTextStamp(const std::filesystem::path& textPath) {
+	std::error_code ec;
+	const auto size = std::filesystem::file_size(textPath, ec);
+	if (ec) {
+		return std::nullopt;
+	}
+	const auto modified = std::filesystem::last_write_time(textPath, ec);
+	if (ec) {
+		return std::nullopt;
+	}
+	return ManifestTextStamp{size, static_cast<std::uint64_t>(modified.time_since_epoch().count())};
+}
+
+[[nodiscard]] std::optional<Manifest> readManifestCache(const std::filesystem::path& textPath, const ManifestTextStamp& stamp) {
+	std::ifstream f{getManifestCachePath(textPath), std::ios::binary};
+	if (!f) {
+		return std::nullopt;
+	}
+	std::array<std::byte, MANIFEST_CACHE_HEADER_LEN> header{};
+	if (!f.read(reinterpret_cast<char*>(header.data()), header.size())) {
+		return std::nullopt;
+	}
+	if (std::memcmp(header.data(), MANIFEST_CACHE_MAGIC.data(), MANIFEST_CACHE_MAGIC.size()) != 0 || readLE(header.data() + 4, 4) != MANIFEST_CACHE_VERSION) {
+		return std::nullopt;
+	}
+	if (readLE(header.data() + 8, 8) != stamp.size || readLE(header.data() + 16, 8) != stamp.modified) {
+		return std::nullopt;
+	}
+	const auto payloadSize = readLE(header.data() + 24, 8);
+	const ContentHash payloadHash{readLE(header.data() + 32, 8), readLE(header.data() + 40, 8)};
+
+	std::vector<std::byte> payload;
+	try {
+		payload.resize(static_cast<std::size_t>(payloadSize));
+	} catch (...) {
+		return std::nullopt;
+	}
+	if (!f.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(payload.size()))) {
+		return std::nullopt;
+	}
+	// Guards against truncated or half-written caches
+	if (computeContentHash(payload) != payloadHash) {
+		return std::nullopt;
+	}
+	return Manifest::deserialize(payload);
+}
+
+// Best effort, a missing cache only costs the next reader a text parse
+// The stamp must be taken before the text is parsed (or right after it is written): if the text changes in between, the
+// cache then carries the old stamp and is ignored instead of passing off the old contents as the new ones
+void writeManifestCache(const std::filesystem::path& textPath, const ManifestTextStamp& stamp, std::span<const std::byte> payload) {
+	std::array<std::byte, MANIFEST_CACHE_HEADER_LEN> header{};
+	std::memcpy(header.data(), MANIFEST_CACHE_MAGIC.data(), MANIFEST_CACHE_MAGIC.size());
+	writeLE(header.data() + 4, MANIFEST_CACHE_VERSION, 4);
+	writeLE(header.data() + 8, stamp.size, 8);
+	writeLE(header.data() + 16, stamp.modified, 8);
+	writeLE(header.data() + 24, payload.size(), 8);
+	const auto payloadHash = computeContentHash(payload);
+	writeLE(header.data() + 32, payloadHash.low, 8);
+	writeLE(header.data() + 40, payloadHash.high, 8);
+
+	const auto cachePath = getManifestCachePath(textPath);
+	const auto tmpPath = makeTempPath(cachePath);
+	std::error_code ec;
+	{
+		std::ofstream f{tmpPath, std::ios::binary | std::ios::trunc};
+		f.write(reinterpret_cast<const char*>(header.data()), header.size());
+		f.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+		f.close();
+		if (!f) {
+			std::filesystem::remove(tmpPath, ec);
+			return;
+		}
+	}
+	std::filesystem::rename(tmpPath, cachePath, ec);
+	if (ec) {
+		std::filesystem::remove(tmpPath, ec);
+	}
+}
+
+// Same layout kvpp::KV1Writer bakes (tab indents, no escape sequences), one entry at a time instead of from a tree
+// Items must already be sorted
+[[nodiscard]] bool writeManifestText(const std::filesystem::path& path, const std::vector<ManifestWriteItem>& items, std::string* outError) {
+	const auto tmpPath = makeTempPath(path);
+	std::ofstream f{tmpPath, std::ios::binary | std::ios::trunc};
+	if (!f) {
+		if (outError) *outError = "failed to open manifest for writing: " + tmpPath.string();
+		return false;
+	}
+
+	std::string buffer;
+	buffer.reserve(MANIFEST_TEXT_FLUSH_SIZE + 512);
+	auto flush = [&] {
+		f.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+		buffer.clear();
+	};
+	auto appendValue = [&buffer](std::string_view key, std::uint64_t value) {
+		std::array<char, 20> digits{};
+		const auto end = std::to_chars(digits.data(), digits.data() + digits.size(), value).ptr;
+		buffer.append("\t\t\"").append(key).append("\" \"").append(digits.data(), end).append("\"\n");
+	};
+
+	buffer.append("\"BuildManifest\"\n{\n");
+	for (const auto& item : items) {
+		buffer.append("\t\"");
+		for (const char c : item.path) {
+			buffer.push_back(c == '/' ? '\\' : c);
+		}
+		buffer.append("\"\n\t{\n");
+		appendValue("preloadSize", item.values.preloadSize);
+		appendValue("loadFlags", item.values.loadFlags);
+		appendValue("textureFlags", item.values.textureFlags);
+		appendValue("useCompression", item.values.useCompression);
+		appendValue("deDuplicate", item.values.deDuplicate);
+		buffer.append("\t}\n");
+		if (buffer.size() >= MANIFEST_TEXT_FLUSH_SIZE) {
+			flush();
+		}
+	}
+	buffer.append("}\n");
+	flush();
+	f.close();
+
+	std::error_code ec;
+	if (!f) {
+		std::filesystem::remove(tmpPath, ec);
+		if (outError) *outError = "failed to write manifest: " + path.string();
+		return false;
+	}
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec) {
+		if (outError) *outError = "failed to replace manifest " + path.string() + ": " + ec.message();
+		std::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+	return true;
+}
+
 [[nodiscard]] std::optional<ManifestEntry> parseEntryKV(const kvpp::KV1ElementReadable<>& kv) {
 	ManifestEntry e{};
 
@@ -83,115 +263,237 @@ static constexpr std::string_view LANGS[] = {
 	return e;
 }
 
-} // namespace
+[[nodiscard]] std::optional<Manifest> parseManifestText(const std::filesystem::path& textPath) {
+	const auto text = sourcepp::fs::readFileText(textPath);
+	if (text.empty()) {
+		return std::nullopt;
+	}
 
-std::string normalizeManifestPath(std::string_view path) {
-	std::string s{path};
-	for (auto& c : s) {
-		if (c == '\\') {
-			c = '/';
+	kvpp::KV1 kv{text, false};
+
+	// Find "BuildManifest" root
+	const kvpp::KV1ElementReadable<>* root = nullptr;
+	for (const auto& e : kv.getChildren()) {
+		if (sourcepp::string::iequals(e.getKey(), "BuildManifest")) {
+			root = &e;
+			break;
 		}
 	}
-	sourcepp::string::normalizeSlashes(s, true, true);
-	if (s.rfind("./", 0) == 0) {
-		s.erase(0, 2);
+	if (!root) {
+		return std::nullopt;
 	}
-	return toLower(s);
-}
 
-std::optional<ManifestMap> readManifestForDirVpkPath(const std::filesystem::path& dirVpkPath) {
-	for (const auto& cand : manifestCandidatePaths(dirVpkPath)) {
-		std::error_code ec;
-		if (!std::filesystem::is_regular_file(cand, ec)) {
+	std::vector<std::pair<std::string, ManifestEntry>> entries;
+	entries.reserve(root->getChildCount());
+	for (const auto& entry : root->getChildren()) {
+		auto key = normalizeManifestPath(entry.getKey());
+		if (key.empty()) {
 			continue;
 		}
+		if (auto parsed = parseEntryKV(entry)) {
+			entries.emplace_back(std::move(key), *parsed);
+		}
+	}
+	return Manifest{std::move(entries)};
+}
+
+[[nodiscard]] std::vector<std::filesystem::path> manifestCandidatePaths(const std::filesystem::path& dirVpkPath) {
+	const auto parent = dirVpkPath.parent_path();
+	const auto stem = dirVpkPath.stem().string();
+	const auto strippedStem = stripLocaleTokensFromFilename(stem);
+
+	std::vector<std::filesystem::path> out;
+	out.reserve(3);
+
+	out.push_back(parent / "manifest" / (stem + ".txt"));
+	if (!sourcepp::string::iequals(stem, strippedStem)) {
+		out.push_back(parent / "manifest" / (strippedStem + ".txt"));
+	}
+	return out;
+}
+
+} // namespace
 
-		const auto text = sourcepp::fs::readFileText(cand);
-		if (text.empty()) {
+Manifest::Manifest(std::vector<std::pair<std::string, ManifestEntry>> entries) {
+	std::stable_sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+		return a.first < b.first;
+	});
+
+	std::size_t keyBytes = 0;
+	for (const auto& [key, values] : entries) {
+		keyBytes += key.size();
+	}
+	this->keys.reserve(keyBytes);
+	this->records.reserve(entries.size());
+	for (const auto& [key, values] : entries) {
+		if (!this->records.empty() && this->getKey(this->records.back()) == key) {
 			continue;
 		}
+		this->records.push_back({static_cast<std::uint32_t>(this->keys.size()), static_cast<std::uint32_t>(key.size()), values});
+		this->keys += key;
+	}
+}
 
-		kvpp::KV1 kv{text, false};
+const ManifestEntry* Manifest::find(std::string_view normalizedPath) const {
+	const auto it = std::lower_bound(this->records.begin(), this->records.end(), normalizedPath, [this](const Record& record, std::string_view path) {
+		return this->getKey(record) < path;
+	});
+	if (it == this->records.end() || this->getKey(*it) != normalizedPath) {
+		return nullptr;
+	}
+	return &it->values;
+}
 
-		// Find "BuildManifest" root
-		const kvpp::KV1ElementReadable<>* root = nullptr;
-		for (const auto& e : kv.getChildren()) {
-			if (sourcepp::string::iequals(e.getKey(), "BuildManifest")) {
-				root = &e;
-				break;
-			}
+std::vector<std::byte> Manifest::serialize() const {
+	std::vector<std::byte> out(MANIFEST_BINARY_HEADER_LEN + this->records.size() * MANIFEST_BINARY_RECORD_LEN + this->keys.size());
+	auto* p = out.data();
+	writeLE(p, this->records.size(), 4);
+	writeLE(p + 4, this->keys.size(), 4);
+	p += MANIFEST_BINARY_HEADER_LEN;
+	for (const auto& record : this->records) {
+		const auto& v = record.values;
+		writeLE(p, record.keyOffset, 4);
+		writeLE(p + 4, record.keyLength, 4);
+		writeLE(p + 8, v.preloadSize, 2);
+		writeLE(p + 10, v.textureFlags, 2);
+		writeLE(p + 12, v.loadFlags, 4);
+		writeLE(p + 16, (v.useCompression ? MANIFEST_RECORD_USE_COMPRESSION : 0) | (v.deDuplicate ? MANIFEST_RECORD_DEDUPLICATE : 0), 1);
+		p += MANIFEST_BINARY_RECORD_LEN;
+	}
+	std::memcpy(p, this->keys.data(), this->keys.size());
+	return out;
+}
+
+std::optional<Manifest> Manifest::deserialize(std::span<const std::byte> data) {
+	if (data.size() < MANIFEST_BINARY_HEADER_LEN) {
+		return std::nullopt;
+	}
+	const auto count = readLE(data.data(), 4);
+	const auto keyBytes = readLE(data.data() + 4, 4);
+	if (data.size() != MANIFEST_BINARY_HEADER_LEN + count * MANIFEST_BINARY_RECORD_LEN + keyBytes) {
+		return std::nullopt;
+	}
+
+	Manifest out;
+	out.records.resize(static_cast<std::size_t>(count));
+	const auto* p = data.data() + MANIFEST_BINARY_HEADER_LEN;
+	for (auto& record : out.records) {
+		record.keyOffset = static_cast<std::uint32_t>(readLE(p, 4));
+		record.keyLength = static_cast<std::uint32_t>(readLE(p + 4, 4));
+		if (static_cast<std::uint64_t>(record.keyOffset) + record.keyLength > keyBytes) {
+			return std::nullopt;
 		}
-		if (!root) {
+		record.values.preloadSize = static_cast<std::uint16_t>(readLE(p + 8, 2));
+		record.values.textureFlags = static_cast<std::uint16_t>(readLE(p + 10, 2));
+		record.values.loadFlags = static_cast<std::uint32_t>(readLE(p + 12, 4));
+		const auto flags = static_cast<std::uint8_t>(readLE(p + 16, 1));
+		record.values.useCompression = flags & MANIFEST_RECORD_USE_COMPRESSION;
+		record.values.deDuplicate = flags & MANIFEST_RECORD_DEDUPLICATE;
+		p += MANIFEST_BINARY_RECORD_LEN;
+	}
+	out.keys.assign(reinterpret_cast<const char*>(p), static_cast<std::size_t>(keyBytes));
+	return out;
+}
+
+std::string normalizeManifestPath(std::string_view path) {
+	// One pass and one allocation: this runs for every entry of every pack and bake
+	std::string s;
+	s.reserve(path.size());
+	for (const char c : path) {
+		s.push_back(c == '\\' ? '/' : static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+	}
+	if (s.starts_with('/')) {
+		s.erase(0, 1);
+	}
+	if (s.ends_with('/')) {
+		s.pop_back();
+	}
+	if (s.starts_with("./")) {
+		s.erase(0, 2);
+	}
+	return s;
+}
+
+std::optional<Manifest> readManifestForDirVpkPath(const std::filesystem::path& dirVpkPath) {
+	RESPAWN_VPK_TRACE_SCOPE("manifest.read");
+	for (const auto& cand : manifestCandidatePaths(dirVpkPath)) {
+		std::error_code ec;
+		if (!std::filesystem::is_regular_file(cand, ec)) {
 			continue;
 		}
 
-		ManifestMap out;
-		out.reserve(root->getChildCount());
-
-		for (const auto& entry : root->getChildren()) {
-			const auto key = normalizeManifestPath(entry.getKey());
-			if (key.empty()) {
-				continue;
+		const auto stamp = getManifestTextStamp(cand);
+		if (stamp) {
+			if (auto cached = readManifestCache(cand, *stamp)) {
+				stats::add(stats::get().manifestCacheHits);
+				return cached;
 			}
-			if (auto parsed = parseEntryKV(entry)) {
-				out.emplace(key, *parsed);
+		}
+		stats::add(stats::get().manifestCacheMisses);
+		if (auto parsed = parseManifestText(cand)) {
+			if (stamp) {
+				writeManifestCache(cand, *stamp, parsed->serialize());
 			}
+			return parsed;
 		}
-
-		return out;
 	}
 
 	return std::nullopt;
 }
 
-bool writeManifestForDirVpkPath(const std::filesystem::path& dirVpkPath, const std::vector<ManifestWriteItem>& items, std::string* outError) {
+bool writeManifestForDirVpkPath(const std::filesystem::path& dirVpkPath, std::size_t itemCount, const std::function<ManifestWriteItem(std::size_t)>& getItem, std::string* outError) {
+	RESPAWN_VPK_TRACE_SCOPE("manifest.write");
 	const auto cands = manifestCandidatePaths(dirVpkPath);
 	if (cands.empty()) {
 		if (outError) *outError = "manifest candidate list was empty";
 		return false;
 	}
 
-	kvpp::KV1Writer<> w{"", false};
-	auto& root = w.addChild("BuildManifest");
-
-	// Deterministic order: sort by path
-	std::vector<ManifestWriteItem> sorted = items;
-	std::sort(sorted.begin(), sorted.end(), [](const ManifestWriteItem& a, const ManifestWriteItem& b) {
+	// Deterministic order: sort by path (callers usually hand them over sorted already, only views get moved)
+	std::vector<ManifestWriteItem> items;
+	items.reserve(itemCount);
+	for (std::size_t i = 0; i < itemCount; i++) {
+		items.push_back(getItem(i));
+	}
+	auto byPath = [](const ManifestWriteItem& a, const ManifestWriteItem& b) {
 		return a.path < b.path;
-	});
-
-	for (const auto& it : sorted) {
-		std::string key = it.path;
-		for (auto& c : key) {
-			if (c == '/') c = '\\';
-		}
-		auto& ent = root.addChild(key);
-		ent("preloadSize") = static_cast<int32_t>(it.values.preloadSize);
-		ent("loadFlags") = static_cast<int64_t>(it.values.loadFlags);
-		ent("textureFlags") = static_cast<int32_t>(it.values.textureFlags);
-		ent("useCompression") = it.values.useCompression;
-		ent("deDuplicate") = it.values.deDuplicate;
+	};
+	if (!std::is_sorted(items.begin(), items.end(), byPath)) {
+		std::sort(items.begin(), items.end(), byPath);
 	}
 
-	std::string baked = w.bake();
-	if (baked.empty()) {
-		if (outError) *outError = "failed to bake manifest KV";
+	std::error_code ec;
+	std::filesystem::create_directories(cands.front().parent_path(), ec);
+	if (!writeManifestText(cands.front(), items, outError)) {
 		return false;
 	}
-
-	// Ensure manifest directory exists and write primary + alias (if present)
-	bool okAny = false;
-	for (std::size_t i = 0; i < cands.size(); i++) {
-		const auto& p = cands[i];
-		std::error_code ec;
-		std::filesystem::create_directories(p.parent_path(), ec);
-		sourcepp::fs::writeFileText(p, baked);
-		okAny = true;
+	// Stamped as soon as each file is in place, see writeManifestCache
+	std::vector<std::optional<ManifestTextStamp>> stamps;
+	stamps.reserve(cands.size());
+	stamps.push_back(getManifestTextStamp(cands.front()));
+	// The alias holds the same text, no need to produce it twice unless it can't be carried over
+	// Other locales of the pack fall back to the alias, so leaving it stale is an error
+	for (std::size_t i = 1; i < cands.size(); i++) {
+		if (!carryOverFile(cands.front(), cands[i], true) && !writeManifestText(cands[i], items, outError)) {
+			return false;
+		}
+		stamps.push_back(getManifestTextStamp(cands[i]));
 	}
 
-	if (!okAny) {
-		if (outError) *outError = "failed to write manifest file(s)";
-		return false;
+	// The same entries a parse of the text would produce, so the next reader can skip parsing it
+	std::vector<std::pair<std::string, ManifestEntry>> parsedEntries;
+	parsedEntries.reserve(items.size());
+	for (const auto& item : items) {
+		auto key = item.normalizedPath.empty() ? normalizeManifestPath(item.path) : std::string{item.normalizedPath};
+		if (!key.empty()) {
+			parsedEntries.emplace_back(std::move(key), item.values);
+		}
+	}
+	const auto payload = Manifest{std::move(parsedEntries)}.serialize();
+	for (std::size_t i = 0; i < cands.size(); i++) {
+		if (stamps[i]) {
+			writeManifestCache(cands[i], *stamps[i], payload);
+		}
 	}
 	return true;
 }
@@ -1,11 +1,14 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace respawn_vpk {
@@ -18,24 +21,61 @@ struct ManifestEntry {
 	bool deDuplicate = true;
 };
 
-using ManifestMap = std::unordered_map<std::string, ManifestEntry>;
+// A build manifest: values per normalized path (see normalizeManifestPath), kept as one flat array sorted by path with
+// all paths in a single buffer, so loading it does not allocate per entry
+class Manifest {
+public:
+	// Paths must already be normalized; a path listed twice keeps the values that come first
+	explicit Manifest(std::vector<std::pair<std::string, ManifestEntry>> entries = {});
 
+	// Values for an already normalized path, nullptr if the manifest does not list it
+	[[nodiscard]] const ManifestEntry* find(std::string_view normalizedPath) const;
+
+	[[nodiscard]] std::size_t size() const noexcept { return this->records.size(); }
+
+	// Compact binary form, used to cache parsed manifests next to their text files
+	[[nodiscard]] std::vector<std::byte> serialize() const;
+	[[nodiscard]] static std::optional<Manifest> deserialize(std::span<const std::byte> data);
+
+private:
+	struct Record {
+		std::uint32_t keyOffset = 0;
+		std::uint32_t keyLength = 0;
+		ManifestEntry values;
+	};
+
+	[[nodiscard]] std::string_view getKey(const Record& record) const {
+		return std::string_view{this->keys}.substr(record.keyOffset, record.keyLength);
+	}
+
+	std::string keys;
+	std::vector<Record> records;
+};
+
+// One entry to write; the views only have to stay valid until the write returns
 struct ManifestWriteItem {
-	std::string path; // normalized to forward slashes (relative path inside vpk)
+	std::string_view path; // relative path inside the vpk, forward slashes
+	std::string_view normalizedPath; // normalizeManifestPath(path) if the caller already has it, else left empty
 	ManifestEntry values;
 };
 
 // Try to locate and parse the build manifest associated with a Respawn *_dir.vpk
 // Looks for `<dirParent>/manifest/<name>.txt` with multiple `<name>` candidates
-[[nodiscard]] std::optional<ManifestMap> readManifestForDirVpkPath(const std::filesystem::path& dirVpkPath);
+// The parsed form is cached in `<name>.txt.bin` and reused while the text file keeps its size and modification time
+[[nodiscard]] std::optional<Manifest> readManifestForDirVpkPath(const std::filesystem::path& dirVpkPath);
 
 // Write a manifest file next to a Respawn *_dir.vpk (in `<dirParent>/manifest/`)
-// Writes to the best name, and also writes an alias name if it differs (to improve interoperability)
+// getItem is called once for each index below itemCount, entries are written sorted by path
+// The text is streamed to the best name; if an alias name differs (to improve interoperability) it becomes a hard
+// link to or copy of that file. The binary cache of each file is written along with it
 [[nodiscard]] bool writeManifestForDirVpkPath(
 	const std::filesystem::path& dirVpkPath,
-	const std::vector<ManifestWriteItem>& items,
+	std::size_t itemCount,
+	const std::function<ManifestWriteItem(std::size_t)>& getItem,
 	std::string* outError = nullptr);
 
+// Lowercase, forward slashes, no leading `/` or `./` and no trailing `/`
+// Callers that look up the same path more than once should keep the result
 [[nodiscard]] std::string normalizeManifestPath(std::string_view path);
 
 } // namespace respawn_vpk
@@ -0,0 +1,136 @@
+#include "RespawnVPKMemory.h"
+
+#include <atomic>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace respawn_vpk::memory {
+
+namespace {
+
+std::atomic_uint64_t budget{0};
+std::atomic_uint64_t charged{0};
+std::atomic_uint64_t chargedPeak{0};
+std::array<std::atomic_uint32_t, OPERATION_COUNT> operationsActive{};
+std::array<std::atomic_uint64_t, OPERATION_COUNT> operationPeaks{};
+
+void raisePeak(std::atomic_uint64_t& peak, std::uint64_t value) {
+	auto current = peak.load(std::memory_order_relaxed);
+	while (current < value && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+void raisePeaks(std::uint64_t value) {
+	raisePeak(chargedPeak, value);
+	for (std::size_t i = 0; i < OPERATION_COUNT; i++) {
+		if (operationsActive[i].load(std::memory_order_relaxed)) {
+			raisePeak(operationPeaks[i], value);
+		}
+	}
+}
+
+[[nodiscard]] std::uint64_t getProcessPeakRss() {
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return 0;
+	}
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage{};
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+#ifdef __APPLE__
+	return static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+	// Linux and the BSDs report kilobytes
+	return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+} // namespace
+
+std::string_view getOperationName(Operation operation) {
+	switch (operation) {
+		case Operation::OPEN: return "open";
+		case Operation::READ: return "read";
+		case Operation::BAKE: return "bake";
+		case Operation::COMPACT: return "compact";
+		case Operation::PACK: return "pack";
+	}
+	return "unknown";
+}
+
+void setBudget(std::uint64_t bytes) {
+	budget.store(bytes, std::memory_order_relaxed);
+}
+
+std::uint64_t getBudget() {
+	return budget.load(std::memory_order_relaxed);
+}
+
+bool fits(std::uint64_t bytes) {
+	const auto limit = getBudget();
+	return !limit || getChargedBytes() + bytes <= limit;
+}
+
+std::uint64_t getChargedBytes() {
+	return charged.load(std::memory_order_relaxed);
+}
+
+Charge::Charge(std::uint64_t bytes)
+		: bytes(0) {
+	this->set(bytes);
+}
+
+Charge::~Charge() {
+	this->set(0);
+}
+
+void Charge::set(std::uint64_t bytes_) {
+	if (bytes_ > this->bytes) {
+		raisePeaks(charged.fetch_add(bytes_ - this->bytes, std::memory_order_relaxed) + (bytes_ - this->bytes));
+	} else if (bytes_ < this->bytes) {
+		charged.fetch_sub(this->bytes - bytes_, std::memory_order_relaxed);
+	}
+	this->bytes = bytes_;
+}
+
+OperationScope::OperationScope(Operation operation_)
+		: operation(operation_) {
+	const auto i = static_cast<std::size_t>(this->operation);
+	operationsActive[i].fetch_add(1, std::memory_order_relaxed);
+	// Whatever is already charged (e.g. the dir tree of the VPK being baked) counts towards this operation too
+	raisePeak(operationPeaks[i], getChargedBytes());
+}
+
+OperationScope::~OperationScope() {
+	operationsActive[static_cast<std::size_t>(this->operation)].fetch_sub(1, std::memory_order_relaxed);
+}
+
+Peaks getPeaks() {
+	Peaks peaks;
+	peaks.charged = chargedPeak.load(std::memory_order_relaxed);
+	for (std::size_t i = 0; i < OPERATION_COUNT; i++) {
+		peaks.operations[i] = operationPeaks[i].load(std::memory_order_relaxed);
+	}
+	peaks.processRss = getProcessPeakRss();
+	return peaks;
+}
+
+void resetPeaks() {
+	const auto current = getChargedBytes();
+	chargedPeak.store(current, std::memory_order_relaxed);
+	for (std::size_t i = 0; i < OPERATION_COUNT; i++) {
+		operationPeaks[i].store(operationsActive[i].load(std::memory_order_relaxed) ? current : 0, std::memory_order_relaxed);
+	}
+}
+
+} // namespace respawn_vpk::memory
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Accounting for the large buffers of the Respawn VPK code (open dir trees, staged patch data, parts in flight while
+// packing), with an optional process-wide budget
+// Only buffers that grow with the input are charged, so the charged bytes are a lower bound of what the process holds;
+// the peak RSS reported next to them covers everything else
+
+namespace respawn_vpk::memory {
+
+enum class Operation : std::uint8_t {
+	OPEN,
+	READ,
+	BAKE,
+	COMPACT,
+	PACK,
+};
+
+constexpr std::size_t OPERATION_COUNT = 5;
+
+[[nodiscard]] std::string_view getOperationName(Operation operation);
+
+// Process-wide limit for the charged bytes, 0 means none
+// Operations that can work in smaller steps check it before growing a buffer, and stream or flush to disk instead
+// An operation always makes progress, a single part or entry larger than the budget is still handled whole
+void setBudget(std::uint64_t bytes);
+
+[[nodiscard]] std::uint64_t getBudget();
+
+// True if charging another `bytes` would stay within the budget (always true without one)
+[[nodiscard]] bool fits(std::uint64_t bytes);
+
+[[nodiscard]] std::uint64_t getChargedBytes();
+
+// Charges its byte count for as long as it lives
+class Charge {
+public:
+	explicit Charge(std::uint64_t bytes = 0);
+
+	~Charge();
+
+	Charge(const Charge&) = delete;
+	Charge& operator=(const Charge&) = delete;
+
+	void set(std::uint64_t bytes_);
+
+	[[nodiscard]] std::uint64_t get() const {
+		return this->bytes;
+	}
+
+private:
+	std::uint64_t bytes;
+};
+
+// Attributes the charged bytes peak to an operation while it lives, scopes may nest (e.g. a pack reading a source VPK)
+class OperationScope {
+public:
+	explicit OperationScope(Operation operation_);
+
+	~OperationScope();
+
+	OperationScope(const OperationScope&) = delete;
+	OperationScope& operator=(const OperationScope&) = delete;
+
+private:
+	Operation operation;
+};
+
+struct Peaks {
+	std::uint64_t charged = 0;
+	std::array<std::uint64_t, OPERATION_COUNT> operations{};
+	// Peak resident set size of the whole process since it started, 0 if the platform does not report it
+	std::uint64_t processRss = 0;
+};
+
+[[nodiscard]] Peaks getPeaks();
+
+// Peaks start over from the bytes charged right now
+void resetPeaks();
+
+} // namespace respawn_vpk::memory
@@ -2,22 +2,36 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <cctype>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <limits>
 #include <mutex>
+#include <numeric>
 #include <span>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
-#include <sourcepp/FS.h>
 #include <sourcepp/String.h>
 #include <sourcepp/crypto/CRC32.h>
 
+#include "RespawnVPK.h"
+#include "RespawnVPKCompressionCache.h"
+#include "RespawnVPKHash.h"
+#include "RespawnVPKJournal.h"
 #include "RespawnVPKManifest.h"
+#include "RespawnVPKMemory.h"
+#include "RespawnVPKParallel.h"
+#include "RespawnVPKScan.h"
+#include "RespawnVPKSort.h"
+#include "RespawnVPKStats.h"
+#include "RespawnVPKTrace.h"
 
 #ifdef VPKEDIT_HAVE_LZHAM
 #include <lzham_bridge.h>
@@ -38,7 +52,8 @@ constexpr std::uint32_t CAM_MAGIC = 3302889984u; // 0xC4DE1A00
 constexpr std::size_t CAM_ENTRY_BYTES = 32;
 
 constexpr std::uint16_t RESPAWN_CHUNK_END_MARKER = 0xFFFFu;
-constexpr std::uint16_t RESPAWN_CHUNK_CONT_MARKER = 0x0000u;
+// Archive names have three digits
+constexpr std::uint16_t MAX_ARCHIVE_INDEX = 999;
 
 enum EPackedLoadFlags : std::uint32_t {
 	LOAD_VISIBLE     = 1u << 0,
@@ -49,12 +64,20 @@ enum EPackedLoadFlags : std::uint32_t {
 constexpr std::uint16_t TEXTURE_DEFAULT = 1u << 3;
 
 struct FilePart {
+	// Assigned when the part is written, parts of one entry can end up in different archives
+	std::uint16_t archiveIndex = 0;
 	std::uint32_t loadFlags = 0;
 	std::uint16_t textureFlags = 0;
 	std::uint64_t entryOffset = 0;
 	std::uint64_t entryLength = 0;
 	std::uint64_t entryLengthUncompressed = 0;
+	// Hash of the stored bytes, used as the dedup key
+	ContentHash dataHash;
+	// CRC of the uncompressed bytes, folded into the entry CRC once every part is encoded
 	std::uint32_t dataCrc32 = 0;
+	// Offset of the stored bytes in DirEntry::reuseArchivePath, for parts copied from a previous pack
+	std::uint64_t reuseOffset = 0;
+	// Released once written to the archive
 	std::vector<std::byte> data;
 };
 
@@ -66,19 +89,52 @@ struct CamEntry {
 	std::uint8_t channels = 0;
 	std::uint32_t sampleCount = 0;
 	std::uint32_t headerSize = 44;
-	std::uint64_t vpkContentOffset = 0;
 	std::string path;
 };
 
+// Recipe for the data of a synthetic entry (see generateSyntheticRespawnVPK), equal recipes generate equal data
+struct SyntheticSource {
+	std::uint64_t seed = 0;
+	// Text-like data that compresses about as well as game scripts and models, otherwise random bytes
+	bool compressible = false;
+};
+
+// Pack file entries are read from when transcoding, instead of from files on disk
+struct PackSource {
+	const vpkpp::PackFile& pack;
+	// PackFile::readEntry is not safe to call from several threads at once for every format
+	std::mutex readMutex;
+};
+
 struct DirEntry {
 	std::string path;
 	std::string extension;
 	std::string directory;
 	std::string fileName;
 
+	// File on disk the entry is read from, and its size when the directory was scanned
+	std::filesystem::path sourcePath;
+	std::uint64_t sourceSize = 0;
+	// Set when the entry is read from a pack file (under `path`) instead of sourcePath
+	PackSource* sourcePack = nullptr;
+	// CRC the source pack stores for the entry, if its format keeps one
+	std::optional<std::uint32_t> sourceCrc32;
+	// .cam record of a .wav carried over from a Respawn source, whose data no longer has its RIFF header
+	std::optional<CamEntry> sourceCam;
+	// Set for entries whose data is generated instead of read, sourceSize is then the generated size
+	std::optional<SyntheticSource> synthetic;
+	// Path as the manifest and load order list it (see normalizeManifestPath)
+	std::string manifestKey;
+	// Manifest values for this path, if the manifest has any
+	const ManifestEntry* manifestValues = nullptr;
+	// Archive of a previous pack holding this file unchanged, its parts are copied instead of compressed. Empty = encode
+	std::string reuseArchivePath;
+
 	std::uint32_t crc32 = 0;
-	std::uint16_t preloadBytes = 0; // always 0 for Respawn packedstore
-	std::uint16_t packFileIndex = 0;
+	// The first bytes of the file can be stored inline in the dir tree instead of in the parts
+	// Only synthetic entries have any, files and pack file entries are stored whole in the parts
+	std::uint16_t preloadBytes = 0;
+	std::vector<std::byte> preloadData;
 
 	std::vector<FilePart> parts;
 };
@@ -212,7 +268,6 @@ struct ReadBuffer {
 	std::string ext, dir, file;
 	std::uint32_t crc = 0;
 	std::uint16_t preloadBytes = 0;
-	std::uint16_t packFileIndex = 0;
 
 	for (;;) {
 		if (!r.readCString(ext)) {
@@ -259,29 +314,32 @@ struct ReadBuffer {
 					if (outError) *outError = "Dir tree parse failed while reading entry header";
 					return false;
 				}
-				if (!r.readU16(packFileIndex)) {
-					if (outError) *outError = "Dir tree parse failed while reading pack file index";
-					return false;
-				}
-				(void)packFileIndex;
-
 				for (;;) {
-					std::uint32_t loadFlags = 0;
-					std::uint16_t textureFlags = 0;
-					std::uint64_t off = 0, len = 0, ulen = 0;
-					std::uint16_t marker = 0;
-					if (!r.readU32(loadFlags) || !r.readU16(textureFlags) || !r.readU64(off) || !r.readU64(len) || !r.readU64(ulen) || !r.readU16(marker)) {
-						if (outError) *outError = "Dir tree parse failed while reading part";
+					std::uint16_t archiveIndex = 0;
+					if (!r.readU16(archiveIndex)) {
+						if (outError) *outError = "Dir tree parse failed while reading pack file index";
 						return false;
 					}
-					if (marker == RESPAWN_CHUNK_END_MARKER) {
+					if (archiveIndex == RESPAWN_CHUNK_END_MARKER) {
 						break;
 					}
-					if (marker != RESPAWN_CHUNK_CONT_MARKER) {
-						if (outError) *outError = "Dir tree corruption detected (invalid chunk marker)";
+					if (archiveIndex > MAX_ARCHIVE_INDEX) {
+						if (outError) *outError = "Dir tree corruption detected (invalid pack file index)";
+						return false;
+					}
+					std::uint32_t loadFlags = 0;
+					std::uint16_t textureFlags = 0;
+					std::uint64_t off = 0, len = 0, ulen = 0;
+					if (!r.readU32(loadFlags) || !r.readU16(textureFlags) || !r.readU64(off) || !r.readU64(len) || !r.readU64(ulen)) {
+						if (outError) *outError = "Dir tree parse failed while reading part";
 						return false;
 					}
 				}
+				if (!r.canRead(preloadBytes)) {
+					if (outError) *outError = "Dir tree parse failed while reading preload bytes";
+					return false;
+				}
+				r.pos += preloadBytes;
 
 				seen.insert(fullPath);
 			}
@@ -359,11 +417,14 @@ struct ReadBuffer {
 	return stripPakLangFilenamePrefix(base);
 }
 
-[[nodiscard]] std::optional<CamEntry> tryMakeCamEntry(const std::vector<std::byte>& wavFile, const std::string& path) {
-	if (wavFile.size() < 44) {
+// Respawn stores .wav data with the RIFF header blanked out, the header itself goes to the .cam file
+constexpr std::size_t WAV_HEADER_SIZE = 44;
+
+[[nodiscard]] std::optional<CamEntry> tryMakeCamEntry(std::span<const std::byte> wavHeader, std::uint64_t wavFileSize, const std::string& path) {
+	if (wavHeader.size() < WAV_HEADER_SIZE || wavFileSize < WAV_HEADER_SIZE) {
 		return std::nullopt;
 	}
-	const auto* b = reinterpret_cast<const std::uint8_t*>(wavFile.data());
+	const auto* b = reinterpret_cast<const std::uint8_t*>(wavHeader.data());
 	if (!(b[0] == 'R' && b[1] == 'I' && b[2] == 'F' && b[3] == 'F')) {
 		return std::nullopt;
 	}
@@ -391,8 +452,8 @@ struct ReadBuffer {
 	const auto sampleCount = dataLength / blockAlign;
 
 	CamEntry out;
-	out.originalSize = static_cast<std::uint32_t>(wavFile.size());
-	out.compressedSize = static_cast<std::uint32_t>(wavFile.size());
+	out.originalSize = static_cast<std::uint32_t>(wavFileSize);
+	out.compressedSize = static_cast<std::uint32_t>(wavFileSize);
 	out.sampleRate = sampleRate;
 	out.channels = static_cast<std::uint8_t>(channels & 0xFF);
 	out.sampleCount = sampleCount;
@@ -401,19 +462,26 @@ struct ReadBuffer {
 	return out;
 }
 
-static void stripWavHeaderInPlace(std::vector<std::byte>& file) {
-	if (file.size() < 44) {
+// The header is at the start of the first part, which is never shorter than the header (see getPartSize)
+static void stripWavHeaderInPlace(std::span<std::byte> firstPart, std::uint64_t wavFileSize) {
+	if (wavFileSize < WAV_HEADER_SIZE || firstPart.size() < WAV_HEADER_SIZE) {
 		return;
 	}
-	auto* b = reinterpret_cast<std::uint8_t*>(file.data());
+	auto* b = reinterpret_cast<std::uint8_t*>(firstPart.data());
 	if (b[0] == 0xCB && b[1] == 0xCB && b[2] == 0xCB && b[3] == 0xCB) {
 		return;
 	}
-	std::fill_n(b, 44, 0xCB);
+	std::fill_n(b, WAV_HEADER_SIZE, 0xCB);
 }
 
+// Names the codec and its settings in compression cache entries, bump it whenever lzham_bridge_compress output changes
+constexpr std::string_view LZHAM_CACHE_CODEC_TAG = "lzham1";
+
 [[nodiscard]] std::vector<std::byte> lzhamCompress(std::span<const std::byte> in) {
+	RESPAWN_VPK_TRACE_SCOPE("lzham.compress");
 #ifdef VPKEDIT_HAVE_LZHAM
+	auto& counters = stats::get();
+	const stats::Timer timer{counters.compressNs};
 	const auto slack = std::min<std::size_t>(std::max<std::size_t>(in.size() / 16, 1024), 64 * 1024);
 	std::vector<std::byte> out(std::max<std::size_t>(in.size() + slack, 1));
 	for (int tries = 0; tries < 6; tries++) {
@@ -424,6 +492,9 @@ static void stripWavHeaderInPlace(std::vector<std::byte>& file) {
 
 		if (rc == 0) {
 			out.resize(outLen);
+			stats::add(counters.partsCompressed);
+			stats::add(counters.compressInputBytes, in.size());
+			stats::add(counters.compressOutputBytes, outLen);
 			return out;
 		}
 		if (rc == 3) {
@@ -452,17 +523,27 @@ static void stripWavHeaderInPlace(std::vector<std::byte>& file) {
 	return toLower(ext);
 }
 
-[[nodiscard]] DirEntry buildDirEntryFromFile(
-	const std::filesystem::path& baseDir,
-	const std::filesystem::path& absPath,
-	const PackOptions& options,
-	const ManifestMap* manifest,
-	std::vector<CamEntry>& camEntries) {
+// Part size used for splitting files, never smaller than a .wav header so the header always sits in the first part
+[[nodiscard]] std::size_t getPartSize(const PackOptions& options) {
+	return std::max<std::size_t>(options.maxPartSize, 64);
+}
 
+// Extension as stored in the tree (lowercase, NUL terminated, " " if there is none) without the decoration
+[[nodiscard]] std::string_view getEntryExtension(const DirEntry& e) {
+	std::string_view ext{e.extension};
+	ext.remove_suffix(1);
+	return ext == " " ? std::string_view{} : ext;
+}
+
+// Names, flags and part layout of an entry, everything that is known before any data is read
+// Data, CRC and compressed sizes are filled in by encodeDirEntryPart
+[[nodiscard]] DirEntry makeDirEntry(ScannedFile&& file, const PackOptions& options, const Manifest* manifest) {
 	DirEntry out;
+	out.sourcePath = std::move(file.path);
+	out.sourceSize = file.size;
+	const auto size = file.size;
 
-	std::error_code ec;
-	auto rel = std::filesystem::relative(absPath, baseDir, ec).string();
+	auto rel = std::move(file.relativePath);
 	sourcepp::string::normalizeSlashes(rel, true, true);
 	out.path = rel;
 
@@ -485,219 +566,580 @@ static void stripWavHeaderInPlace(std::vector<std::byte>& file) {
 		out.directory = dir + '\0';
 	}
 
-	auto file = fs::readFileBuffer(absPath.string());
+	// The manifest's preloadSize is not applied: the whole file goes into the parts, and a preload count without the
+	// preload bytes behind it would make readers skip over the next entry
+	out.preloadBytes = 0;
+	out.manifestKey = normalizeManifestPath(out.path);
+	if (manifest) {
+		out.manifestValues = manifest->find(out.manifestKey);
+	}
 
-	if (extLower == "wav") {
-		if (auto cam = tryMakeCamEntry(file, out.path)) {
-			camEntries.push_back(*cam);
+	const auto partSize = getPartSize(options);
+	out.parts.resize(static_cast<std::size_t>((size + partSize - 1) / partSize));
+	for (std::size_t k = 0; k < out.parts.size(); k++) {
+		auto& part = out.parts[k];
+		part.entryLengthUncompressed = std::min<std::uint64_t>(partSize, size - k * partSize);
+		if (out.manifestValues) {
+			part.loadFlags = out.manifestValues->loadFlags;
+			part.textureFlags = out.manifestValues->textureFlags;
+		} else {
+			part.loadFlags = LOAD_VISIBLE;
+			if (extLower == "wav") {
+				part.loadFlags = static_cast<std::uint32_t>(LOAD_VISIBLE | LOAD_CACHE);
+			} else if (extLower == "acache") {
+				part.loadFlags = static_cast<std::uint32_t>(LOAD_VISIBLE | LOAD_CACHE | LOAD_ACACHE_UNK0);
+			}
+			if (extLower == "vtf") {
+				part.textureFlags = TEXTURE_DEFAULT;
+			}
 		}
-		stripWavHeaderInPlace(file);
 	}
+	return out;
+}
 
-	out.crc32 = crypto::computeCRC32(std::span<const std::byte>{file.data(), file.size()});
-	out.preloadBytes = 0;
-	out.packFileIndex = options.archiveIndex;
+[[nodiscard]] bool shouldCompressPart(const DirEntry& e, std::size_t partLen, const PackOptions& options) {
+	const auto ext = getEntryExtension(e);
+	const bool compressionExcluded = ext == "wav" || ext == "vtf";
+	if (e.manifestValues) {
+		return e.manifestValues->useCompression && !compressionExcluded;
+	}
+	return partLen >= options.compressionThreshold && !compressionExcluded;
+}
 
-	static const std::unordered_set<std::string> compressionExcluded{"wav", "vtf"};
+// True if the stored parts are exactly what this packer would write for the entry, so they can be copied as they are
+// LZHAM settings are fixed by the format (lzham_bridge on both ends), what can differ is how the entry was split into
+// parts and whether each part was compressed
+[[nodiscard]] bool isStoredLayoutCompatible(const DirEntry& e, const RespawnVPK::StoredEntry& stored, const PackOptions& options) {
+	if (stored.preloadBytes != 0 || stored.parts.size() != e.parts.size() || e.parts.empty()) {
+		return false;
+	}
+	for (std::size_t k = 0; k < e.parts.size(); k++) {
+		const auto& storedPart = stored.parts[k];
+		// Only entries kept in one archive are reused; older packers wrote entries whose later parts all claim archive 0
+		if (storedPart.archivePath != stored.parts.front().archivePath) {
+			return false;
+		}
+		if (storedPart.uncompressedLength != e.parts[k].entryLengthUncompressed) {
+			return false;
+		}
+		const bool storedCompressed = storedPart.length != storedPart.uncompressedLength;
+		if (storedCompressed && !shouldCompressPart(e, static_cast<std::size_t>(storedPart.uncompressedLength), options)) {
+			return false;
+		}
+	}
+	return true;
+}
 
-	ManifestEntry values{};
-	bool haveManifestValues = false;
-	if (manifest) {
-		const auto key = normalizeManifestPath(out.path);
-		if (const auto it = manifest->find(key); it != manifest->end()) {
-			values = it->second;
-			haveManifestValues = true;
-			out.preloadBytes = values.preloadSize;
-			out.packFileIndex = options.archiveIndex;
+// Point the entry at stored parts, they are copied instead of encoded and the stored CRC is kept
+void reuseStoredParts(DirEntry& e, const RespawnVPK::StoredEntry& stored) {
+	e.reuseArchivePath = stored.parts.front().archivePath;
+	e.crc32 = stored.crc32;
+	for (std::size_t k = 0; k < e.parts.size(); k++) {
+		e.parts[k].reuseOffset = stored.parts[k].offset;
+		e.parts[k].entryLength = stored.parts[k].length;
+	}
+}
+
+// Incremental packs: if the previous pack stores this file with the same part layout and CRC, point the entry at the
+// stored parts so they are copied instead of compressed. The file is read once to compute its CRC, which is far
+// cheaper than compressing it. Entries read from a pack file are compared by the CRC their source stores instead
+void tryReuseStoredEntry(DirEntry& e, const RespawnVPK::StoredEntry& stored, const PackOptions& options) {
+	if (!isStoredLayoutCompatible(e, stored, options)) {
+		return;
+	}
+
+	if (e.sourcePack) {
+		if (e.sourceCrc32 == stored.crc32) {
+			reuseStoredParts(e, stored);
 		}
+		return;
 	}
 
-	std::size_t offset = 0;
-	while (offset < file.size()) {
-		const auto partLen = std::min<std::size_t>(options.maxPartSize, file.size() - offset);
-		const auto partSpan = std::span<const std::byte>{file.data() + offset, partLen};
+	std::ifstream f{e.sourcePath, std::ios::binary};
+	if (!f) {
+		return;
+	}
+	std::vector<std::byte> buf;
+	std::uint32_t crc = 0;
+	for (std::size_t k = 0; k < e.parts.size(); k++) {
+		const auto& part = e.parts[k];
+		buf.resize(static_cast<std::size_t>(part.entryLengthUncompressed));
+		if (!f.read(reinterpret_cast<char*>(buf.data()), static_cast<std::streamsize>(buf.size()))) {
+			// Reported properly when the entry is encoded instead
+			return;
+		}
+		if (k == 0 && getEntryExtension(e) == "wav") {
+			stripWavHeaderInPlace(buf, e.sourceSize);
+		}
+		const auto partCrc = crypto::computeCRC32(std::span<const std::byte>{buf.data(), buf.size()});
+		crc = k == 0 ? partCrc : combineCRC32(crc, partCrc, part.entryLengthUncompressed);
+	}
+	if (crc == stored.crc32) {
+		reuseStoredParts(e, stored);
+	}
+}
 
-		auto partData = std::vector<std::byte>(partSpan.begin(), partSpan.end());
+// .cam records of a Respawn archive keyed by the offset of their .wav data, empty if it has no .cam file
+[[nodiscard]] std::unordered_map<std::uint64_t, CamEntry> readCamRecords(const std::string& archivePath) {
+	std::unordered_map<std::uint64_t, CamEntry> out;
+	std::ifstream f{archivePath + ".cam", std::ios::binary};
+	std::vector<std::byte> record(CAM_ENTRY_BYTES);
+	while (f.read(reinterpret_cast<char*>(record.data()), static_cast<std::streamsize>(record.size()))) {
+		ReadBuffer r(record);
+		CamEntry cam;
+		std::uint8_t sampleRate[3]{};
+		std::uint64_t dataOffset = 0;
+		if (!r.readU32(cam.magic) || !r.readU32(cam.originalSize) || !r.readU32(cam.compressedSize)
+			|| !r.readU8(sampleRate[0]) || !r.readU8(sampleRate[1]) || !r.readU8(sampleRate[2])
+			|| !r.readU8(cam.channels) || !r.readU32(cam.sampleCount) || !r.readU32(cam.headerSize) || !r.readU64(dataOffset)) {
+			break;
+		}
+		cam.sampleRate = sampleRate[0] | (static_cast<std::uint32_t>(sampleRate[1]) << 8) | (static_cast<std::uint32_t>(sampleRate[2]) << 16);
+		out.emplace(dataOffset, std::move(cam));
+	}
+	return out;
+}
 
-		bool doCompress = partLen >= options.compressionThreshold && !compressionExcluded.contains(extLower);
-		if (haveManifestValues) {
-			doCompress = values.useCompression && !compressionExcluded.contains(extLower);
+// Copy one stored part of a reused entry from the previous archive, nothing is decompressed or recompressed
+[[nodiscard]] bool copyStoredPart(DirEntry& e, std::size_t partIndex, std::vector<CamEntry>& camEntries, std::string& outError) {
+	auto& part = e.parts[partIndex];
+	std::vector<std::byte> stored(static_cast<std::size_t>(part.entryLength));
+	{
+		std::ifstream f{e.reuseArchivePath, std::ios::binary};
+		f.seekg(static_cast<std::streamoff>(part.reuseOffset));
+		if (!f.read(reinterpret_cast<char*>(stored.data()), static_cast<std::streamsize>(stored.size()))) {
+			outError = "Failed to read previous archive: " + e.reuseArchivePath;
+			return false;
 		}
-		if (doCompress) {
-			const auto compressed = lzhamCompress(partSpan);
-			if (compressed.size() < partData.size()) {
-				partData = compressed;
-			} else {
-				doCompress = false;
+		stats::addRead(stored.size(), 3);
+	}
+
+	// The .cam record needs the original header, which the stored data no longer has
+	if (partIndex == 0 && getEntryExtension(e) == "wav" && e.sourceCam) {
+		camEntries.push_back(*e.sourceCam);
+	} else if (partIndex == 0 && getEntryExtension(e) == "wav" && !e.sourcePack) {
+		std::vector<std::byte> header(WAV_HEADER_SIZE);
+		std::ifstream f{e.sourcePath, std::ios::binary};
+		if (f.read(reinterpret_cast<char*>(header.data()), static_cast<std::streamsize>(header.size()))) {
+			if (auto cam = tryMakeCamEntry(header, e.sourceSize, e.path)) {
+				camEntries.push_back(*cam);
 			}
 		}
+	}
 
-		FilePart part;
-		part.textureFlags = 0;
-		part.entryOffset = 0;
-		part.entryLength = static_cast<std::uint64_t>(partData.size());
-		part.entryLengthUncompressed = static_cast<std::uint64_t>(partLen);
-		part.dataCrc32 = crypto::computeCRC32(std::span<const std::byte>{partData.data(), partData.size()});
-		part.data = std::move(partData);
+	part.entryOffset = 0;
+	part.dataHash = computeContentHash(stored);
+	part.data = std::move(stored);
+	return true;
+}
 
-		if (haveManifestValues) {
-			part.loadFlags = values.loadFlags;
-			part.textureFlags = values.textureFlags;
-		} else {
-			part.loadFlags = LOAD_VISIBLE;
-			if (extLower == "wav") {
-				part.loadFlags = static_cast<std::uint32_t>(LOAD_VISIBLE | LOAD_CACHE);
-			} else if (extLower == "acache") {
-				part.loadFlags = static_cast<std::uint32_t>(LOAD_VISIBLE | LOAD_CACHE | LOAD_ACACHE_UNK0);
+// Synthetic data is generated in chunks that each depend only on the seed and their offset, so any part can be
+// generated on its own (and on any thread) and the same recipe always yields the same bytes on every platform
+constexpr std::size_t SYNTHETIC_CHUNK_SIZE = 16;
+
+// Eight bytes each; half of a compressible chunk is one of these, the other half digits
+constexpr std::string_view SYNTHETIC_TOKENS[] = {
+	"vertex  ", "normal  ", "texcoord", "origin  ", "angles  ", "$basetex", "model   ", "weapon_ ",
+	"script  ", "material", "\"name\" \"", "\t\t\t\t\t\t\t\t", "{\n\t\t\t\t\t\t", "}\n\t\t\t\t\t\t", "0.000000", "-1.00000",
+};
+static_assert(std::ranges::all_of(SYNTHETIC_TOKENS, [](std::string_view token) { return token.size() == 8; }));
+
+[[nodiscard]] std::uint64_t splitmix64(std::uint64_t& state) {
+	std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+// In [0, 1), from the top 53 bits
+[[nodiscard]] double uniform01(std::uint64_t& state) {
+	return static_cast<double>(splitmix64(state) >> 11) * 0x1.0p-53;
+}
+
+// Bytes [fileOffset, fileOffset + out.size()) of the synthetic file
+void fillSyntheticBytes(const SyntheticSource& source, std::uint64_t fileOffset, std::span<std::byte> out) {
+	std::array<std::byte, SYNTHETIC_CHUNK_SIZE> chunk{};
+	auto chunkIndex = fileOffset / SYNTHETIC_CHUNK_SIZE;
+	auto skip = static_cast<std::size_t>(fileOffset % SYNTHETIC_CHUNK_SIZE);
+	for (std::size_t i = 0; i < out.size(); chunkIndex++) {
+		std::uint64_t state = source.seed ^ (chunkIndex * 0xD1B54A32D192ED03ull);
+		const auto a = splitmix64(state);
+		const auto b = splitmix64(state);
+		if (source.compressible) {
+			const auto token = SYNTHETIC_TOKENS[a % std::size(SYNTHETIC_TOKENS)];
+			std::memcpy(chunk.data(), token.data(), 8);
+			for (std::size_t j = 0; j < 8; j++) {
+				chunk[8 + j] = static_cast<std::byte>('0' + ((b >> (8 * j)) & 0xFFu) % 10);
 			}
-			if (extLower == "vtf") {
-				part.textureFlags = TEXTURE_DEFAULT;
+		} else {
+			for (std::size_t j = 0; j < 8; j++) {
+				chunk[j] = static_cast<std::byte>((a >> (8 * j)) & 0xFFu);
+				chunk[8 + j] = static_cast<std::byte>((b >> (8 * j)) & 0xFFu);
 			}
 		}
+		const auto n = std::min(SYNTHETIC_CHUNK_SIZE - skip, out.size() - i);
+		std::memcpy(out.data() + i, chunk.data() + skip, n);
+		i += n;
+		skip = 0;
+	}
+}
 
-		out.parts.push_back(std::move(part));
-		offset += partLen;
+// A 16-bit PCM RIFF header for a synthetic .wav of the given size, so the packer builds a .cam record for it
+void writeSyntheticWavHeader(const SyntheticSource& source, std::uint64_t wavFileSize, std::span<std::byte> firstPart) {
+	if (wavFileSize < WAV_HEADER_SIZE || firstPart.size() < WAV_HEADER_SIZE) {
+		return;
 	}
+	static constexpr std::uint32_t SAMPLE_RATES[] = {22050, 44100, 48000};
+	std::uint64_t state = source.seed;
+	const auto pick = splitmix64(state);
+	const std::uint16_t channels = 1 + pick % 2;
+	const auto sampleRate = SAMPLE_RATES[(pick >> 8) % std::size(SAMPLE_RATES)];
+	const std::uint16_t blockAlign = channels * 2;
+
+	WriteBuffer w(WAV_HEADER_SIZE);
+	w.writeBytes(std::as_bytes(std::span{"RIFF", 4}));
+	w.writeU32(static_cast<std::uint32_t>(wavFileSize - 8));
+	w.writeBytes(std::as_bytes(std::span{"WAVEfmt ", 8}));
+	w.writeU32(16);
+	w.writeU16(1); // PCM
+	w.writeU16(channels);
+	w.writeU32(sampleRate);
+	w.writeU32(sampleRate * blockAlign);
+	w.writeU16(blockAlign);
+	w.writeU16(16);
+	w.writeBytes(std::as_bytes(std::span{"data", 4}));
+	w.writeU32(static_cast<std::uint32_t>(wavFileSize - WAV_HEADER_SIZE));
+	std::memcpy(firstPart.data(), w.buf.data(), WAV_HEADER_SIZE);
+}
 
-	return out;
+// Where an entry is read from, for error messages
+[[nodiscard]] std::string describeSource(const DirEntry& e) {
+	if (e.synthetic) {
+		return "synthetic entry " + e.path;
+	}
+	if (e.sourcePack) {
+		return std::string{e.sourcePack->pack.getFilepath()} + ": " + e.path;
+	}
+	return e.sourcePath.string();
 }
 
-[[nodiscard]] bool writeArchiveFile(
-	std::vector<DirEntry>& entries,
-	const ManifestMap* manifest,
-	const std::string& archivePath,
-	std::string* outError) {
-	std::ofstream f{archivePath, std::ios::binary};
-	if (!f) {
-		if (outError) {
-			*outError = "Failed to open for write: " + archivePath;
+// Checksum, compress and hash one part of an entry, given its source bytes
+void encodePartBytes(
+	DirEntry& e,
+	std::size_t partIndex,
+	std::vector<std::byte> partBytes,
+	const PackOptions& options,
+	CompressionCache* compressionCache,
+	std::vector<CamEntry>& camEntries) {
+
+	auto& part = e.parts[partIndex];
+	const auto partLen = partBytes.size();
+
+	const auto ext = getEntryExtension(e);
+	if (ext == "wav" && partIndex == 0) {
+		if (e.sourceCam) {
+			camEntries.push_back(*e.sourceCam);
+		} else if (auto cam = tryMakeCamEntry(partBytes, e.sourceSize, e.path)) {
+			camEntries.push_back(*cam);
+		}
+		stripWavHeaderInPlace(partBytes, e.sourceSize);
+	}
+
+	{
+		RESPAWN_VPK_TRACE_SCOPE("pack.crc32");
+		part.dataCrc32 = crypto::computeCRC32(std::span<const std::byte>{partBytes.data(), partBytes.size()});
+	}
+
+	if (shouldCompressPart(e, partLen, options)) {
+		std::optional<std::vector<std::byte>> cached;
+		ContentHash cacheKey;
+		if (compressionCache) {
+			cacheKey = computeContentHash(partBytes);
+			cached = compressionCache->find(cacheKey, partLen);
+			stats::add(cached ? stats::get().compressionCacheHits : stats::get().compressionCacheMisses);
+		}
+		auto compressed = cached ? std::move(*cached) : lzhamCompress(partBytes);
+		if (compressionCache && !cached) {
+			// Parts that do not shrink are remembered too, they would otherwise be recompressed on every run
+			compressionCache->store(cacheKey, partLen, compressed.size() < partLen ? std::span<const std::byte>{compressed} : std::span<const std::byte>{});
+		}
+		if (!compressed.empty() && compressed.size() < partLen) {
+			partBytes = std::move(compressed);
+		}
+	}
+
+	part.entryOffset = 0;
+	part.entryLength = static_cast<std::uint64_t>(partBytes.size());
+	part.dataHash = computeContentHash(partBytes);
+	part.data = std::move(partBytes);
+}
+
+// Read one part of an entry's file, then checksum, compress and hash it
+// Parts of the same entry are independent of each other and may be encoded on different threads
+[[nodiscard]] bool encodeDirEntryPart(
+	DirEntry& e,
+	std::size_t partIndex,
+	const PackOptions& options,
+	CompressionCache* compressionCache,
+	std::vector<CamEntry>& camEntries,
+	std::string& outError) {
+	RESPAWN_VPK_TRACE_SCOPE("pack.encodePart");
+
+	if (!e.reuseArchivePath.empty()) {
+		return copyStoredPart(e, partIndex, camEntries, outError);
+	}
+
+	const auto partOffset = static_cast<std::uint64_t>(partIndex) * getPartSize(options);
+	const auto partLen = static_cast<std::size_t>(e.parts[partIndex].entryLengthUncompressed);
+
+	std::vector<std::byte> partBytes(partLen);
+	if (e.synthetic) {
+		// Preload bytes come first in the file, the parts hold the rest
+		fillSyntheticBytes(*e.synthetic, e.preloadData.size() + partOffset, partBytes);
+		if (partIndex == 0 && getEntryExtension(e) == "wav") {
+			writeSyntheticWavHeader(*e.synthetic, e.sourceSize, partBytes);
 		}
+		encodePartBytes(e, partIndex, std::move(partBytes), options, compressionCache, camEntries);
+		return true;
+	}
+	{
+		RESPAWN_VPK_TRACE_SCOPE("pack.readFile");
+		std::ifstream f{e.sourcePath, std::ios::binary};
+		f.seekg(static_cast<std::streamoff>(partOffset));
+		f.read(reinterpret_cast<char*>(partBytes.data()), static_cast<std::streamsize>(partLen));
+		if (!f || static_cast<std::size_t>(f.gcount()) != partLen) {
+			outError = "Failed to read (or file changed while packing): " + e.sourcePath.string();
+			return false;
+		}
+		// Open, seek and read
+		stats::addRead(partLen, 3);
+	}
+	encodePartBytes(e, partIndex, std::move(partBytes), options, compressionCache, camEntries);
+	return true;
+}
+
+// Read an entry of a pack file and encode all of its parts
+// Pack files only hand out whole entries, so unlike files on disk the parts of one entry are encoded by one thread
+[[nodiscard]] bool encodePackSourceEntry(
+	DirEntry& e,
+	const PackOptions& options,
+	CompressionCache* compressionCache,
+	std::vector<CamEntry>& camEntries,
+	std::string& outError) {
+	RESPAWN_VPK_TRACE_SCOPE("pack.encodeSourceEntry");
+
+	std::optional<std::vector<std::byte>> data;
+	{
+		RESPAWN_VPK_TRACE_SCOPE("pack.readSourceEntry");
+		std::scoped_lock lock{e.sourcePack->readMutex};
+		data = e.sourcePack->pack.readEntry(e.path);
+	}
+	if (!data || data->size() != e.sourceSize) {
+		outError = "Failed to read (or entry changed while packing): " + describeSource(e);
 		return false;
 	}
 
-	std::vector<char> iobuf(8 * 1024 * 1024);
-	f.rdbuf()->pubsetbuf(iobuf.data(), static_cast<std::streamsize>(iobuf.size()));
+	const auto partSize = getPartSize(options);
+	for (std::size_t k = 0; k < e.parts.size(); k++) {
+		const auto first = data->begin() + static_cast<std::ptrdiff_t>(k * partSize);
+		std::vector<std::byte> partBytes{first, first + static_cast<std::ptrdiff_t>(e.parts[k].entryLengthUncompressed)};
+		encodePartBytes(e, k, std::move(partBytes), options, compressionCache, camEntries);
+	}
+	return true;
+}
 
-	struct DedupRef {
-		std::uint64_t offset = 0;
-		const std::vector<std::byte>* data = nullptr;
+// Appends encoded parts to the archives in the order they are handed over, assigning part archives and offsets
+// Identical parts are stored once (across all archives) unless the entry opts out of dedup
+// With a size limit, a new archive is started before a file (or part) that would push the current one past it
+class ArchiveWriter {
+public:
+	struct Archive {
+		std::uint16_t index;
+		// Where the archive ends up, and where it is written (a temp file for incremental packs)
+		std::string finalPath;
+		std::string writePath;
 	};
-	std::unordered_map<std::uint64_t, std::vector<DedupRef>> dedup;
-	dedup.reserve(entries.size() * 2);
 
-	std::uint64_t writePos = 0;
+	ArchiveWriter(std::string dirVpkPath_, std::uint16_t firstIndex, std::uint64_t maxArchiveBytes_, bool writeToTemp_)
+			: dirVpkPath(std::move(dirVpkPath_))
+			, nextIndex(firstIndex)
+			, maxArchiveBytes(maxArchiveBytes_)
+			, writeToTemp(writeToTemp_) {}
 
-	for (auto& e : entries) {
-		bool allowDedup = true;
-		if (manifest) {
-			const auto key = normalizeManifestPath(e.path);
-			if (const auto it = manifest->find(key); it != manifest->end()) {
-				allowDedup = it->second.deDuplicate;
-			}
+	[[nodiscard]] bool open(std::string* outError) {
+		return this->openNextArchive(outError);
+	}
+
+	// Called before the first part of every entry, so an entry is only split over archives if it is too large for one
+	// The stored size of an entry never exceeds its source size, which makes that a safe estimate
+	[[nodiscard]] bool beginEntry(std::uint64_t sourceSize, std::string* outError) {
+		if (this->needsNewArchive(sourceSize)) {
+			return this->openNextArchive(outError);
 		}
+		return true;
+	}
 
-		for (auto& p : e.parts) {
-			const auto size = static_cast<std::uint64_t>(p.data.size());
-			if (size == 0) {
-				p.entryOffset = writePos;
-				continue;
+	[[nodiscard]] bool writePart(FilePart& p, bool allowDedup, std::string* outError) {
+		RESPAWN_VPK_TRACE_SCOPE("pack.writePart");
+		const auto size = static_cast<std::uint64_t>(p.data.size());
+		if (size == 0) {
+			p.archiveIndex = this->archives.back().index;
+			p.entryOffset = this->writePos;
+			return true;
+		}
+
+		if (allowDedup) {
+			if (const auto it = this->dedup.find(p.dataHash); it != this->dedup.end()) {
+				p.archiveIndex = it->second.first;
+				p.entryOffset = it->second.second;
+				stats::add(stats::get().dedupHits);
+				stats::add(stats::get().dedupBytesSaved, size);
+				p.data = std::vector<std::byte>{};
+				return true;
 			}
+		}
 
-			bool wrote = false;
-			if (allowDedup) {
-				const std::uint64_t h = (static_cast<std::uint64_t>(p.dataCrc32) << 32) | size;
-				if (auto it = dedup.find(h); it != dedup.end()) {
-					for (const auto& cand : it->second) {
-						if (!cand.data || cand.data->size() != p.data.size()) {
-							continue;
-						}
-						if (std::memcmp(cand.data->data(), p.data.data(), p.data.size()) == 0) {
-							p.entryOffset = cand.offset;
-							wrote = true;
-							break;
-						}
-					}
-				}
-				if (!wrote) {
-					p.entryOffset = writePos;
-					f.write(reinterpret_cast<const char*>(p.data.data()), static_cast<std::streamsize>(p.data.size()));
-					if (!f) {
-						if (outError) {
-							*outError = "Failed to write archive: " + archivePath;
-						}
-						return false;
-					}
-					dedup[h].push_back(DedupRef{writePos, &p.data});
-					writePos += size;
-				}
-			} else {
-				p.entryOffset = writePos;
-				f.write(reinterpret_cast<const char*>(p.data.data()), static_cast<std::streamsize>(p.data.size()));
-				if (!f) {
-					if (outError) {
-						*outError = "Failed to write archive: " + archivePath;
-					}
-					return false;
-				}
-				writePos += size;
+		if (this->needsNewArchive(size) && !this->openNextArchive(outError)) {
+			return false;
+		}
+
+		p.archiveIndex = this->archives.back().index;
+		p.entryOffset = this->writePos;
+		this->f.write(reinterpret_cast<const char*>(p.data.data()), static_cast<std::streamsize>(p.data.size()));
+		if (!this->f) {
+			if (outError) {
+				*outError = "Failed to write archive: " + this->archives.back().writePath;
 			}
+			return false;
+		}
+		// Buffered, so this overcounts the write calls that actually reach the OS
+		stats::addWrite(size);
+		if (allowDedup) {
+			this->dedup.emplace(p.dataHash, std::make_pair(p.archiveIndex, this->writePos));
 		}
+		this->writePos += size;
+		// Assigning {} would only clear the buffer and keep its allocation
+		p.data = std::vector<std::byte>{};
+		return true;
 	}
 
-	return true;
-}
+	[[nodiscard]] bool close(std::string* outError) {
+		return this->closeCurrentArchive(outError);
+	}
 
-[[nodiscard]] std::vector<std::byte> buildCam(const std::vector<DirEntry>& entries, std::vector<CamEntry>& cams) {
-	for (const auto& e : entries) {
-		if (!endsWithInsensitive(e.extension, "wav\0")) {
-			continue;
+	// Every archive opened so far, in index order
+	[[nodiscard]] const std::vector<Archive>& getArchives() const {
+		return this->archives;
+	}
+
+private:
+	[[nodiscard]] bool needsNewArchive(std::uint64_t bytes) const {
+		return this->maxArchiveBytes && this->writePos > 0 && this->writePos + bytes > this->maxArchiveBytes;
+	}
+
+	[[nodiscard]] bool closeCurrentArchive(std::string* outError) {
+		if (!this->f.is_open()) {
+			return true;
 		}
-		auto it = std::find_if(cams.begin(), cams.end(), [&](const CamEntry& c) { return c.path == e.path; });
-		if (it == cams.end()) {
-			continue;
+		this->f.close();
+		if (!this->f || (this->writeToTemp && !syncFile(this->archives.back().writePath))) {
+			if (outError) {
+				*outError = "Failed to write archive: " + this->archives.back().writePath;
+			}
+			return false;
+		}
+		return true;
+	}
+
+	[[nodiscard]] bool openNextArchive(std::string* outError) {
+		if (!this->closeCurrentArchive(outError)) {
+			return false;
+		}
+		if (this->nextIndex > MAX_ARCHIVE_INDEX) {
+			if (outError) {
+				*outError = "Too many archives, the archive index would exceed " + std::to_string(MAX_ARCHIVE_INDEX) + " (raise the archive size limit or start at a lower index)";
+			}
+			return false;
 		}
-		if (!e.parts.empty()) {
-			it->vpkContentOffset = e.parts.front().entryOffset;
+
+		Archive archive;
+		archive.index = this->nextIndex++;
+		archive.finalPath = makeArchivePath(this->dirVpkPath, archive.index);
+		archive.writePath = this->writeToTemp ? archive.finalPath + ".tmp" : archive.finalPath;
+
+		if (this->iobuf.empty()) {
+			this->iobuf.resize(8 * 1024 * 1024);
 		}
+		this->f.clear();
+		this->f.rdbuf()->pubsetbuf(this->iobuf.data(), static_cast<std::streamsize>(this->iobuf.size()));
+		this->f.open(archive.writePath, std::ios::binary | std::ios::trunc);
+		if (!this->f) {
+			if (outError) {
+				*outError = "Failed to open for write: " + archive.writePath;
+			}
+			return false;
+		}
+		this->archives.push_back(std::move(archive));
+		this->writePos = 0;
+		return true;
 	}
 
-	WriteBuffer w(cams.size() * CAM_ENTRY_BYTES);
+	std::string dirVpkPath;
+	std::uint16_t nextIndex;
+	std::uint64_t maxArchiveBytes;
+	bool writeToTemp;
+
+	std::vector<Archive> archives;
+	std::vector<char> iobuf;
+	std::ofstream f;
+	// Hash of the stored bytes -> archive index and offset of the first copy
+	std::unordered_map<ContentHash, std::pair<std::uint16_t, std::uint64_t>, ContentHashHasher> dedup;
+	std::uint64_t writePos = 0;
+};
+
+// .cam records of the .wav entries whose data starts in the given archive, empty if there are none
+[[nodiscard]] std::vector<std::byte> buildCam(const std::vector<DirEntry>& entries, const std::unordered_map<std::string_view, const CamEntry*>& camsByPath, std::uint16_t archiveIndex) {
+	WriteBuffer w(camsByPath.size() * CAM_ENTRY_BYTES);
 	for (const auto& e : entries) {
-		if (!endsWithInsensitive(e.extension, "wav\0")) {
+		if (e.parts.empty() || e.parts.front().archiveIndex != archiveIndex || getEntryExtension(e) != "wav") {
 			continue;
 		}
-		const auto it = std::find_if(cams.begin(), cams.end(), [&](const CamEntry& c) { return c.path == e.path; });
-		if (it == cams.end()) {
+		const auto it = camsByPath.find(e.path);
+		if (it == camsByPath.end()) {
 			continue;
 		}
-		w.writeU32(it->magic);
-		w.writeU32(it->originalSize);
-		w.writeU32(it->compressedSize);
-		w.writeU24(it->sampleRate & 0x00FFFFFFu);
-		w.writeU8(it->channels);
-		w.writeU32(it->sampleCount);
-		w.writeU32(it->headerSize);
-		w.writeU64(it->vpkContentOffset);
+		const auto& cam = *it->second;
+		w.writeU32(cam.magic);
+		w.writeU32(cam.originalSize);
+		w.writeU32(cam.compressedSize);
+		w.writeU24(cam.sampleRate & 0x00FFFFFFu);
+		w.writeU8(cam.channels);
+		w.writeU32(cam.sampleCount);
+		w.writeU32(cam.headerSize);
+		w.writeU64(e.parts.front().entryOffset);
 	}
 	return std::move(w.buf);
 }
 
-[[nodiscard]] std::vector<std::byte> buildDirTree(const std::vector<DirEntry>& entries, std::uint16_t archiveIndex) {
+[[nodiscard]] std::vector<std::byte> buildDirTree(const std::vector<DirEntry>& entries) {
+	RESPAWN_VPK_TRACE_SCOPE("pack.buildDirTree");
 	std::size_t est = 0;
 	for (const auto& e : entries) {
 		est += e.extension.size() + e.directory.size() + e.fileName.size();
 		est += e.parts.size() * 32;
+		est += e.preloadData.size();
 		est += 12;
 	}
 	WriteBuffer w(est);
 
-	std::string lastExt;
-	std::string lastDir;
+	// Views into entries, which outlive the loop
+	std::string_view lastExt;
+	std::string_view lastDir;
 
 	for (const auto& e : entries) {
 		if (e.extension != lastExt && !lastExt.empty()) {
 			w.writeU16(0);
-			lastDir.clear();
+			lastDir = {};
 		} else if (e.directory != lastDir && !lastDir.empty()) {
 			w.writeU8(0);
 		}
@@ -715,23 +1157,54 @@ static void stripWavHeaderInPlace(std::vector<std::byte>& file) {
 
 		w.writeU32(e.crc32);
 		w.writeU16(e.preloadBytes);
-		w.writeU16(e.packFileIndex ? e.packFileIndex : archiveIndex);
 
-		for (std::size_t i = 0; i < e.parts.size(); i++) {
-			const auto& p = e.parts[i];
+		// Every part starts with the index of its archive, the list ends with an end marker (also when it is empty)
+		for (const auto& p : e.parts) {
+			w.writeU16(p.archiveIndex);
 			w.writeU32(p.loadFlags);
 			w.writeU16(p.textureFlags);
 			w.writeU64(p.entryOffset);
 			w.writeU64(p.entryLength);
 			w.writeU64(p.entryLengthUncompressed);
-			w.writeU16((i + 1 == e.parts.size()) ? RESPAWN_CHUNK_END_MARKER : RESPAWN_CHUNK_CONT_MARKER);
 		}
+		w.writeU16(RESPAWN_CHUNK_END_MARKER);
+		w.writeBytes(e.preloadData);
 	}
 
 	w.writeU24(0);
 	return std::move(w.buf);
 }
 
+// Order entries (given in tree order) are written to the archives in, see PackPlacement and PackOptions::loadOrder
+[[nodiscard]] std::vector<std::size_t> makeWriteOrder(const std::vector<DirEntry>& entries, const PackOptions& options) {
+	std::vector<std::size_t> order(entries.size());
+	std::iota(order.begin(), order.end(), std::size_t{0});
+	if (options.placement == PackPlacement::DIRECTORY) {
+		sortByPackedKey(order, [&entries](std::string& key, std::size_t i) {
+			key.append(entries[i].directory).append(entries[i].extension).append(entries[i].fileName);
+		}, options.threadCount);
+	}
+
+	if (!options.loadOrder.empty()) {
+		std::unordered_map<std::string, std::size_t> loadRanks;
+		loadRanks.reserve(options.loadOrder.size());
+		for (std::size_t i = 0; i < options.loadOrder.size(); i++) {
+			// A path listed twice keeps its first position
+			loadRanks.emplace(normalizeManifestPath(options.loadOrder[i]), i);
+		}
+		std::vector<std::size_t> ranks(entries.size(), std::numeric_limits<std::size_t>::max());
+		for (std::size_t i = 0; i < entries.size(); i++) {
+			if (const auto it = loadRanks.find(entries[i].manifestKey); it != loadRanks.end()) {
+				ranks[i] = it->second;
+			}
+		}
+		std::stable_sort(order.begin(), order.end(), [&ranks](std::size_t a, std::size_t b) {
+			return ranks[a] < ranks[b];
+		});
+	}
+	return order;
+}
+
 [[nodiscard]] std::vector<std::byte> buildHeader(std::uint32_t treeLength) {
 	WriteBuffer w(RESPAWN_VPK_HEADER_LEN);
 	w.writeU32(RESPAWN_VPK_SIGNATURE);
@@ -757,112 +1230,221 @@ static void stripWavHeaderInPlace(std::vector<std::byte>& file) {
 		}
 		return false;
 	}
+	stats::addWrite(data.size(), 2);
 	return true;
 }
 
-} // namespace
+// Rough size of the entry list, it stays in memory for the whole pack
+[[nodiscard]] std::uint64_t estimateEntriesBytes(const std::vector<DirEntry>& entries) {
+	std::uint64_t bytes = entries.capacity() * sizeof(DirEntry);
+	for (const auto& e : entries) {
+		bytes += e.path.capacity() + e.extension.capacity() + e.directory.capacity() + e.fileName.capacity() + e.manifestKey.capacity();
+		bytes += e.parts.capacity() * sizeof(FilePart) + e.preloadData.capacity();
+	}
+	return bytes;
+}
 
-std::uint16_t inferArchiveIndexFromDirVpkPath(std::string_view outputDirVpkPath, std::uint16_t fallback) {
-	const auto p = std::filesystem::path{std::string{outputDirVpkPath}};
-	const auto nameLower = toLower(p.filename().string());
+// Everything after the entries are known is shared by all sources: encode, write the archives, the dir VPK, .cam
+// files and the manifest. Entries are taken in any order and sorted here
+[[nodiscard]] bool packEntries(std::vector<DirEntry>& entries, const std::string& outputDirVpkPath, const PackOptions& options, std::string* outError, PackStats* outStats) {
+	RESPAWN_VPK_TRACE_SCOPE("pack");
+	const memory::OperationScope memoryScope{memory::Operation::PACK};
+	const memory::Charge entriesCharge{estimateEntriesBytes(entries)};
+	std::error_code ec;
+	std::vector<CamEntry> camEntries;
 
-	const auto pos = nameLower.rfind("pak");
-	if (pos == std::string::npos || pos + 6 > nameLower.size()) {
-		return fallback;
+	std::optional<CompressionCache> compressionCache;
+#ifdef VPKEDIT_HAVE_LZHAM
+	if (!options.compressionCacheDir.empty()) {
+		compressionCache.emplace(options.compressionCacheDir, std::string{LZHAM_CACHE_CODEC_TAG}, options.compressionCacheMaxBytes);
 	}
+#endif
 
-	const auto d0 = nameLower[pos + 3];
-	const auto d1 = nameLower[pos + 4];
-	const auto d2 = nameLower[pos + 5];
-	if (!std::isdigit(static_cast<unsigned char>(d0)) ||
-		!std::isdigit(static_cast<unsigned char>(d1)) ||
-		!std::isdigit(static_cast<unsigned char>(d2))) {
-		return fallback;
+	// Tree order only depends on the names, so it is also the order data is written in (and the output is deterministic)
+	// The stored names already carry their NUL terminators, so they concatenate straight into the packed key
+	sortByPackedKey(entries, [](std::string& key, const DirEntry& e) {
+		key.append(e.extension).append(e.directory).append(e.fileName);
+	}, options.threadCount);
+
+	// Held for the whole pack: a reader opening the previous output must not recover (or roll back) this pack's journal
+	BakeLock packLock;
+	if (!packLock.tryLock(outputDirVpkPath, outError) || !recoverInterruptedBake(packLock, outError)) {
+		return false;
 	}
 
-	const auto idx = static_cast<unsigned>((d0 - '0') * 100 + (d1 - '0') * 10 + (d2 - '0'));
-	if (idx > 999) {
-		return fallback;
+	// Incremental packs match files against the previous output, which is only needed until the entries are marked
+	std::uint64_t reusedEntries = 0;
+	std::uint64_t reusedBytes = 0;
+	const bool incremental = options.incremental && std::filesystem::is_regular_file(outputDirVpkPath, ec);
+	if (incremental) {
+		RESPAWN_VPK_TRACE_SCOPE("pack.matchPrevious");
+		auto previousPackFile = RespawnVPK::open(outputDirVpkPath);
+		const auto* previous = dynamic_cast<const RespawnVPK*>(previousPackFile.get());
+		if (!previous) {
+			if (outError) {
+				*outError = "Failed to open the previous pack for an incremental pack: " + outputDirVpkPath;
+			}
+			return false;
+		}
+		// Entries already copied from a Respawn source are left alone
+		std::vector<char> reused(entries.size(), 0);
+		if (!parallelFor(entries.size(), options.threadCount, [&](std::size_t i, std::string&) {
+			if (!entries[i].reuseArchivePath.empty()) {
+				return true;
+			}
+			if (const auto stored = previous->getStoredEntry(entries[i].path)) {
+				tryReuseStoredEntry(entries[i], *stored, options);
+				reused[i] = !entries[i].reuseArchivePath.empty();
+			}
+			return true;
+		}, outError)) {
+			return false;
+		}
+		for (std::size_t i = 0; i < entries.size(); i++) {
+			if (reused[i]) {
+				reusedEntries++;
+				for (const auto& part : entries[i].parts) {
+					reusedBytes += part.entryLength;
+				}
+			}
+		}
 	}
-	return static_cast<std::uint16_t>(idx);
-}
 
-bool packDirectoryToRespawnVPK(const std::string& inputDir, const std::string& outputDirVpkPath, const PackOptions& options, std::string* outError) {
-	if (!endsWithInsensitive(outputDirVpkPath, "_dir.vpk")) {
-		if (outError) {
-			*outError = "Output path must end with _dir.vpk";
+	// An incremental pack reads the previous archives while it writes the new ones, so the archives, .cam files and
+	// dir VPK are written to temp files and swapped in through a bake journal (see RespawnVPKJournal.h) once complete
+	const auto getCamWritePath = [incremental](const ArchiveWriter::Archive& archive) {
+		return archive.finalPath + (incremental ? ".cam.tmp" : ".cam");
+	};
+	const auto dirVpkWritePath = incremental ? outputDirVpkPath + ".tmp" : outputDirVpkPath;
+	const auto journalPath = getBakeJournalPath(outputDirVpkPath);
+	BakeJournal journal;
+	std::optional<BakeRollbackGuard> rollbackGuard;
+	if (incremental) {
+		// The dir VPK goes last, it is what makes the new data reachable; archives are added in front of it as they open
+		journal.renames.emplace_back(dirVpkWritePath, outputDirVpkPath);
+		std::filesystem::remove(dirVpkWritePath, ec);
+		if (!writeBakeJournal(journalPath, journal, outError)) {
+			return false;
 		}
-		return false;
+		rollbackGuard.emplace(journalPath, journal);
 	}
 
-	std::error_code ec;
-	if (!std::filesystem::exists(inputDir, ec) || !std::filesystem::is_directory(inputDir, ec)) {
-		if (outError) {
-			*outError = "Input path is not a directory: " + inputDir;
+	ArchiveWriter archiveWriter{outputDirVpkPath, options.archiveIndex, options.maxArchiveBytes, incremental};
+	std::size_t journaledArchives = 0;
+	const auto journalNewArchives = [&](std::string* err) -> bool {
+		const auto& archives = archiveWriter.getArchives();
+		if (!incremental || journaledArchives == archives.size()) {
+			return true;
+		}
+		for (; journaledArchives < archives.size(); journaledArchives++) {
+			const auto& archive = archives[journaledArchives];
+			journal.renames.insert(journal.renames.end() - 1, {archive.writePath, archive.finalPath});
+			journal.renames.insert(journal.renames.end() - 1, {getCamWritePath(archive), archive.finalPath + ".cam"});
 		}
+		return writeBakeJournal(journalPath, journal, err);
+	};
+	if (!archiveWriter.open(outError) || !journalNewArchives(outError)) {
 		return false;
 	}
 
-	std::vector<DirEntry> entries;
-	std::vector<CamEntry> camEntries;
-
-	const auto manifestOpt = readManifestForDirVpkPath(std::filesystem::path{outputDirVpkPath});
-	const ManifestMap* manifest = manifestOpt ? &*manifestOpt : nullptr;
-
-	std::vector<std::filesystem::path> filePaths;
-	for (const auto& it : std::filesystem::recursive_directory_iterator{inputDir, std::filesystem::directory_options::skip_permission_denied, ec}) {
-		if (ec) {
-			ec.clear();
+	// Pipeline: every part of every entry is a task, in placement order. Workers claim the next unclaimed task, so the
+	// parts of a large file are spread over all workers instead of one worker compressing it alone. This thread appends
+	// finished parts to the archives in task order, frees their data and folds their CRCs into the entry CRC
+	// Entries that have to be read whole from a source pack file are a single task covering all of their parts
+	// A task is only claimed while the estimated memory of all claimed-but-unwritten parts stays within
+	// maxInflightBytes and the memory budget (one task is always allowed); a part is charged for its raw and its
+	// compressed bytes
+	struct PartTask {
+		std::size_t entryIndex;
+		std::size_t partIndex;
+		std::size_t partCount;
+	};
+	std::vector<PartTask> tasks;
+	for (const auto i : makeWriteOrder(entries, options)) {
+		const auto& e = entries[i];
+		if (e.sourcePack && e.reuseArchivePath.empty()) {
+			if (!e.parts.empty()) {
+				tasks.push_back({i, 0, e.parts.size()});
+			}
 			continue;
 		}
-		if (!it.is_regular_file(ec)) {
-			ec.clear();
-			continue;
+		for (std::size_t k = 0; k < e.parts.size(); k++) {
+			tasks.push_back({i, k, 1});
 		}
-		ec.clear();
-		filePaths.push_back(it.path());
 	}
+	auto inflightCost = [&](const PartTask& t) {
+		std::uint64_t cost = 0;
+		for (std::size_t k = t.partIndex; k < t.partIndex + t.partCount; k++) {
+			cost += entries[t.entryIndex].parts[k].entryLengthUncompressed * 2;
+		}
+		return cost;
+	};
 
-	entries.resize(filePaths.size());
-
-	std::mutex camMutex;
-	std::mutex errMutex;
+	std::mutex pipelineMutex;
+	std::condition_variable budgetFreed;
+	std::condition_variable partReady;
+	std::size_t nextToClaim = 0;
+	std::uint64_t inflightBytes = 0;
+	memory::Charge inflightCharge;
+	std::vector<char> ready(tasks.size(), 0);
+	bool failed = false;
 	std::string firstError;
 
-	std::atomic_size_t nextIndex{0};
-	std::atomic_bool failed{false};
+	// Must be called with pipelineMutex held
+	auto failLocked = [&](std::string err) {
+		if (!failed) {
+			failed = true;
+			firstError = std::move(err);
+		}
+		budgetFreed.notify_all();
+		partReady.notify_all();
+	};
 
+	std::mutex camMutex;
 	auto workerFn = [&]() {
 		std::vector<CamEntry> localCams;
 		for (;;) {
-			if (failed.load(std::memory_order_relaxed)) {
-				break;
-			}
-			const auto i = nextIndex.fetch_add(1, std::memory_order_relaxed);
-			if (i >= filePaths.size()) {
-				break;
+			std::size_t t = 0;
+			{
+				RESPAWN_VPK_TRACE_SCOPE("pack.waitForBudget");
+				std::unique_lock lock{pipelineMutex};
+				budgetFreed.wait(lock, [&] {
+					if (failed || nextToClaim >= tasks.size() || inflightBytes == 0) {
+						return true;
+					}
+					const auto cost = inflightCost(tasks[nextToClaim]);
+					return inflightBytes + cost <= options.maxInflightBytes && memory::fits(cost);
+				});
+				if (failed || nextToClaim >= tasks.size()) {
+					break;
+				}
+				t = nextToClaim++;
+				inflightBytes += inflightCost(tasks[t]);
+				inflightCharge.set(inflightBytes);
 			}
+
+			auto& e = entries[tasks[t].entryIndex];
+			auto* cache = compressionCache ? &*compressionCache : nullptr;
+			std::string err;
 			try {
-				entries[i] = buildDirEntryFromFile(std::filesystem::path{inputDir}, filePaths[i], options, manifest, localCams);
-			} catch (const std::exception& e) {
-				{
-					std::scoped_lock lock(errMutex);
-					if (firstError.empty()) {
-						firstError = std::string{"Exception while reading/compressing: "} + filePaths[i].string() + "\n" + e.what();
-					}
+				if (e.sourcePack && e.reuseArchivePath.empty()) {
+					(void)encodePackSourceEntry(e, options, cache, localCams, err);
+				} else {
+					(void)encodeDirEntryPart(e, tasks[t].partIndex, options, cache, localCams, err);
 				}
-				failed.store(true, std::memory_order_relaxed);
-				break;
+			} catch (const std::exception& ex) {
+				err = std::string{"Exception while reading/compressing: "} + describeSource(e) + "\n" + ex.what();
 			} catch (...) {
-				{
-					std::scoped_lock lock(errMutex);
-					if (firstError.empty()) {
-						firstError = std::string{"Unknown exception while reading/compressing: "} + filePaths[i].string();
-					}
-				}
-				failed.store(true, std::memory_order_relaxed);
+				err = std::string{"Unknown exception while reading/compressing: "} + describeSource(e);
+			}
+
+			std::scoped_lock lock{pipelineMutex};
+			if (!err.empty()) {
+				failLocked(std::move(err));
 				break;
 			}
+			ready[t] = 1;
+			partReady.notify_all();
 		}
 		if (!localCams.empty()) {
 			std::scoped_lock lock(camMutex);
@@ -870,36 +1452,68 @@ bool packDirectoryToRespawnVPK(const std::string& inputDir, const std::string& o
 		}
 	};
 
-	std::size_t threadCount = options.threadCount;
-	if (threadCount == 0) {
-		threadCount = std::max<std::size_t>(1, std::thread::hardware_concurrency());
-		threadCount = std::min<std::size_t>(threadCount, std::max<std::size_t>(1, filePaths.size()));
-		threadCount = std::min<std::size_t>(threadCount, 16);
-	}
-	threadCount = std::max<std::size_t>(1, std::min<std::size_t>(threadCount, std::max<std::size_t>(1, filePaths.size())));
-
+	const auto threadCount = resolveThreadCount(options.threadCount, tasks.size());
 	std::vector<std::thread> workers;
 	workers.reserve(threadCount);
 	for (std::size_t i = 0; i < threadCount; i++) {
 		workers.emplace_back(workerFn);
 	}
+
+	for (std::size_t t = 0; t < tasks.size(); t++) {
+		{
+			RESPAWN_VPK_TRACE_SCOPE("pack.waitForPart");
+			std::unique_lock lock{pipelineMutex};
+			partReady.wait(lock, [&] { return failed || ready[t]; });
+			if (failed) {
+				break;
+			}
+		}
+
+		auto& e = entries[tasks[t].entryIndex];
+		const bool allowDedup = !e.manifestValues || e.manifestValues->deDuplicate;
+		std::string err;
+		bool ok = tasks[t].partIndex != 0 || archiveWriter.beginEntry(e.sourceSize, &err);
+		for (std::size_t k = tasks[t].partIndex; ok && k < tasks[t].partIndex + tasks[t].partCount; k++) {
+			auto& part = e.parts[k];
+			// Copied entries keep the CRC that was stored with them
+			if (e.reuseArchivePath.empty()) {
+				if (k == 0 && e.preloadData.empty()) {
+					e.crc32 = part.dataCrc32;
+				} else if (k == 0) {
+					e.crc32 = combineCRC32(crypto::computeCRC32(std::span<const std::byte>{e.preloadData}), part.dataCrc32, part.entryLengthUncompressed);
+				} else {
+					e.crc32 = combineCRC32(e.crc32, part.dataCrc32, part.entryLengthUncompressed);
+				}
+			}
+			ok = archiveWriter.writePart(part, allowDedup, &err) && journalNewArchives(&err);
+		}
+
+		std::scoped_lock lock{pipelineMutex};
+		if (!ok) {
+			failLocked(std::move(err));
+			break;
+		}
+		inflightBytes -= inflightCost(tasks[t]);
+		inflightCharge.set(inflightBytes);
+		budgetFreed.notify_all();
+	}
+
 	for (auto& t : workers) {
 		t.join();
 	}
 
-	if (failed.load(std::memory_order_relaxed)) {
+	if (failed) {
 		if (outError) {
-			std::scoped_lock lock(errMutex);
 			*outError = !firstError.empty() ? firstError : "Failed to pack due to an unknown error while reading/compressing files.";
 		}
 		return false;
 	}
+	if (!archiveWriter.close(outError)) {
+		return false;
+	}
 
-	std::sort(entries.begin(), entries.end(), [](const DirEntry& a, const DirEntry& b) {
-		return (a.extension + a.directory + a.fileName) < (b.extension + b.directory + b.fileName);
-	});
-
-	const auto dirTree = buildDirTree(entries, options.archiveIndex);
+	const auto dirTree = buildDirTree(entries);
+	const memory::Charge dirTreeCharge{dirTree.size()};
 	const auto header = buildHeader(static_cast<std::uint32_t>(dirTree.size()));
 
 	if (!validateDirTreeAgainstInput(dirTree, entries, outError)) {
@@ -911,29 +1525,80 @@ bool packDirectoryToRespawnVPK(const std::string& inputDir, const std::string& o
 		dirVpk.reserve(header.size() + dirTree.size());
 		dirVpk.insert(dirVpk.end(), header.begin(), header.end());
 		dirVpk.insert(dirVpk.end(), dirTree.begin(), dirTree.end());
-		if (!writeFileBinary(outputDirVpkPath, dirVpk, outError)) {
+		if (!writeFileBinary(dirVpkWritePath, dirVpk, outError)) {
 			return false;
 		}
 	}
 
-	const auto archivePath = makeArchivePath(outputDirVpkPath, options.archiveIndex);
-	if (!writeArchiveFile(entries, manifest, archivePath, outError)) {
-		return false;
+	// Each archive gets the .cam records of the .wav entries that start in it
+	std::unordered_map<std::string_view, const CamEntry*> camsByPath;
+	camsByPath.reserve(camEntries.size());
+	for (const auto& cam : camEntries) {
+		camsByPath.emplace(cam.path, &cam);
+	}
+	// Files an earlier pack left that the new dir VPK doesn't reference: a .cam would describe data that is no longer
+	// there, and archives past the last one written (the pack shrank) are dead weight
+	std::vector<std::string> stalePaths;
+	for (const auto& archive : archiveWriter.getArchives()) {
+		const auto cam = buildCam(entries, camsByPath, archive.index);
+		if (cam.empty()) {
+			if (std::filesystem::exists(archive.finalPath + ".cam", ec)) {
+				stalePaths.push_back(archive.finalPath + ".cam");
+			}
+			continue;
+		}
+		const auto camWritePath = getCamWritePath(archive);
+		if (!writeFileBinary(camWritePath, cam, outError)) {
+			return false;
+		}
+		if (incremental && !syncFile(camWritePath)) {
+			if (outError) {
+				*outError = "Failed to write: " + camWritePath;
+			}
+			return false;
+		}
 	}
 
-	if (!camEntries.empty()) {
-		auto cam = buildCam(entries, camEntries);
-		if (!writeFileBinary(archivePath + ".cam", cam, outError)) {
+	for (auto index = static_cast<std::uint16_t>(archiveWriter.getArchives().back().index + 1); index <= MAX_ARCHIVE_INDEX; index++) {
+		const auto archivePath = makeArchivePath(outputDirVpkPath, index);
+		if (!std::filesystem::exists(archivePath, ec)) {
+			break;
+		}
+		stalePaths.push_back(archivePath);
+		if (std::filesystem::exists(archivePath + ".cam", ec)) {
+			stalePaths.push_back(archivePath + ".cam");
+		}
+	}
+
+	if (incremental) {
+		if (!syncFile(dirVpkWritePath)) {
+			if (outError) {
+				*outError = "Failed to write: " + dirVpkWritePath;
+			}
+			return false;
+		}
+		// Deleted by the commit, so an interrupted commit still finishes the job
+		journal.removes = std::move(stalePaths);
+		rollbackGuard->dismiss();
+		if (!commitBake(journalPath, journal, outError)) {
+			std::string recoverError;
+			(void) recoverInterruptedBake(packLock, &recoverError);
 			return false;
 		}
+	} else {
+		// The dir VPK was written in place, nothing references these any more
+		for (const auto& path : stalePaths) {
+			std::filesystem::remove(path, ec);
+		}
 	}
 
 	{
-		std::vector<ManifestWriteItem> mani;
-		mani.reserve(entries.size());
-		for (const auto& e : entries) {
+		std::string err;
+		(void)writeManifestForDirVpkPath(std::filesystem::path{outputDirVpkPath}, entries.size(), [&entries](std::size_t i) {
+			const auto& e = entries[i];
 			ManifestWriteItem m;
 			m.path = e.path;
+			m.normalizedPath = e.manifestKey;
 			m.values.preloadSize = e.preloadBytes;
 			if (!e.parts.empty()) {
 				m.values.loadFlags = e.parts.front().loadFlags;
@@ -941,13 +1606,297 @@ bool packDirectoryToRespawnVPK(const std::string& inputDir, const std::string& o
 				m.values.useCompression = (e.parts.front().entryLength != e.parts.front().entryLengthUncompressed);
 			}
 			m.values.deDuplicate = true;
-			mani.push_back(std::move(m));
+			return m;
+		}, &err);
+	}
+
+	if (outStats) {
+		outStats->incrementalReusedEntries = reusedEntries;
+		outStats->incrementalReusedBytes = reusedBytes;
+	}
+
+	if (compressionCache) {
+		compressionCache->trim();
+		if (outStats) {
+			outStats->compressionCacheHits = compressionCache->getHits();
+			outStats->compressionCacheMisses = compressionCache->getMisses();
 		}
-		std::string err;
-		(void)writeManifestForDirVpkPath(std::filesystem::path{outputDirVpkPath}, mani, &err);
 	}
 
 	return true;
 }
 
+} // namespace
+
+std::uint16_t inferArchiveIndexFromDirVpkPath(std::string_view outputDirVpkPath, std::uint16_t fallback) {
+	const auto p = std::filesystem::path{std::string{outputDirVpkPath}};
+	const auto nameLower = toLower(p.filename().string());
+
+	const auto pos = nameLower.rfind("pak");
+	if (pos == std::string::npos || pos + 6 > nameLower.size()) {
+		return fallback;
+	}
+
+	const auto d0 = nameLower[pos + 3];
+	const auto d1 = nameLower[pos + 4];
+	const auto d2 = nameLower[pos + 5];
+	if (!std::isdigit(static_cast<unsigned char>(d0)) ||
+		!std::isdigit(static_cast<unsigned char>(d1)) ||
+		!std::isdigit(static_cast<unsigned char>(d2))) {
+		return fallback;
+	}
+
+	const auto idx = static_cast<unsigned>((d0 - '0') * 100 + (d1 - '0') * 10 + (d2 - '0'));
+	if (idx > 999) {
+		return fallback;
+	}
+	return static_cast<std::uint16_t>(idx);
+}
+
+bool packDirectoryToRespawnVPK(const std::string& inputDir, const std::string& outputDirVpkPath, const PackOptions& options, std::string* outError, PackStats* outStats) {
+	if (!endsWithInsensitive(outputDirVpkPath, "_dir.vpk")) {
+		if (outError) {
+			*outError = "Output path must end with _dir.vpk";
+		}
+		return false;
+	}
+
+	std::error_code ec;
+	if (!std::filesystem::exists(inputDir, ec) || !std::filesystem::is_directory(inputDir, ec)) {
+		if (outError) {
+			*outError = "Input path is not a directory: " + inputDir;
+		}
+		return false;
+	}
+
+	const auto manifestOpt = readManifestForDirVpkPath(std::filesystem::path{outputDirVpkPath});
+	const Manifest* manifest = manifestOpt ? &*manifestOpt : nullptr;
+
+	std::vector<DirEntry> entries;
+	{
+		auto files = scanDirectory(std::filesystem::path{inputDir}, options.threadCount);
+		RESPAWN_VPK_TRACE_SCOPE("pack.makeDirEntries");
+		entries.reserve(files.size());
+		for (auto& file : files) {
+			entries.push_back(makeDirEntry(std::move(file), options, manifest));
+		}
+	}
+	return packEntries(entries, outputDirVpkPath, options, outError, outStats);
+}
+
+std::string findCollidingSourceArchive(const vpkpp::PackFile& source, const std::string& outputDirVpkPath, const PackOptions& options) {
+	const auto* respawnSource = dynamic_cast<const RespawnVPK*>(&source);
+	if (!respawnSource) {
+		return {};
+	}
+	std::error_code ec;
+	const std::string sourcePath{source.getFilepath()};
+	if (options.incremental && std::filesystem::equivalent(sourcePath, outputDirVpkPath, ec)) {
+		return {};
+	}
+	// Archive names only differ in the index, and the pack writes (or removes as stale) indices from archiveIndex up
+	for (const auto& [index, archivePath] : respawnSource->getStoredArchivePaths()) {
+		ec.clear();
+		if (index >= options.archiveIndex && std::filesystem::equivalent(makeArchivePath(outputDirVpkPath, index), archivePath, ec)) {
+			return archivePath;
+		}
+	}
+	return {};
+}
+
+bool packPackFileToRespawnVPK(const vpkpp::PackFile& source, const std::string& outputDirVpkPath, const PackOptions& options, std::string* outError, PackStats* outStats) {
+	if (!endsWithInsensitive(outputDirVpkPath, "_dir.vpk")) {
+		if (outError) {
+			*outError = "Output path must end with _dir.vpk";
+		}
+		return false;
+	}
+
+	// Only an incremental pack leaves the old archives in place until the new ones are complete
+	std::error_code ec;
+	const std::string sourcePath{source.getFilepath()};
+	if (!options.incremental && std::filesystem::equivalent(sourcePath, outputDirVpkPath, ec)) {
+		if (outError) {
+			*outError = "Output path is the source pack file, write to a different path or pack incrementally: " + outputDirVpkPath;
+		}
+		return false;
+	}
+
+	if (const auto collision = findCollidingSourceArchive(source, outputDirVpkPath, options); !collision.empty()) {
+		if (outError) {
+			*outError = "Output archives would overwrite an archive of the source pack file, write to a different path: " + collision;
+		}
+		return false;
+	}
+
+	// A re-laid-out Respawn VPK keeps its flags unless the output has a manifest of its own
+	const auto* respawnSource = dynamic_cast<const RespawnVPK*>(&source);
+	auto manifestOpt = readManifestForDirVpkPath(std::filesystem::path{outputDirVpkPath});
+	if (!manifestOpt && respawnSource) {
+		manifestOpt = readManifestForDirVpkPath(std::filesystem::path{sourcePath});
+	}
+	const Manifest* manifest = manifestOpt ? &*manifestOpt : nullptr;
+
+	PackSource packSource{source, {}};
+	const bool sourceHasCrc32 = static_cast<bool>(source.getSupportedEntryAttributes() & vpkpp::Attribute::CRC32);
+	std::vector<DirEntry> entries;
+	entries.reserve(source.getEntryCount());
+	source.runForAllEntries([&](const std::string& path, const vpkpp::Entry& entry) {
+		auto e = makeDirEntry(ScannedFile{{}, path, entry.length}, options, manifest);
+		e.sourcePack = &packSource;
+		if (sourceHasCrc32) {
+			e.sourceCrc32 = entry.crc32;
+		}
+		entries.push_back(std::move(e));
+	});
+
+	// Parts a Respawn source already stores the way they would be written now are copied without decompressing them
+	// Its .wav data has lost the RIFF header, so their .cam records are carried over from the source's .cam files
+	std::uint64_t copiedEntries = 0;
+	std::uint64_t copiedBytes = 0;
+	if (respawnSource) {
+		std::unordered_map<std::string, std::unordered_map<std::uint64_t, CamEntry>> camRecordsByArchive;
+		for (auto& e : entries) {
+			const auto stored = respawnSource->getStoredEntry(e.path);
+			if (!stored || stored->parts.empty()) {
+				continue;
+			}
+			if (getEntryExtension(e) == "wav") {
+				auto [records, inserted] = camRecordsByArchive.try_emplace(stored->parts.front().archivePath);
+				if (inserted) {
+					records->second = readCamRecords(records->first);
+				}
+				if (const auto cam = records->second.find(stored->parts.front().offset); cam != records->second.end()) {
+					e.sourceCam = cam->second;
+					e.sourceCam->path = e.path;
+				}
+			}
+			if (!isStoredLayoutCompatible(e, *stored, options)) {
+				continue;
+			}
+			reuseStoredParts(e, *stored);
+			copiedEntries++;
+			for (const auto& part : e.parts) {
+				copiedBytes += part.entryLength;
+			}
+		}
+	}
+
+	if (!packEntries(entries, outputDirVpkPath, options, outError, outStats)) {
+		return false;
+	}
+	if (outStats) {
+		outStats->sourceCopiedEntries = copiedEntries;
+		outStats->sourceCopiedBytes = copiedBytes;
+	}
+	return true;
+}
+
+bool generateSyntheticRespawnVPK(const std::string& outputDirVpkPath, const SyntheticPackOptions& options, const PackOptions& packOptions, std::string* outError, PackStats* outStats) {
+	if (!endsWithInsensitive(outputDirVpkPath, "_dir.vpk")) {
+		if (outError) {
+			*outError = "Output path must end with _dir.vpk";
+		}
+		return false;
+	}
+	if (options.entryCount == 0 || options.meanFileSize == 0 || options.maxFileSize == 0) {
+		if (outError) {
+			*outError = "A synthetic pack needs at least one entry and a non-zero file size";
+		}
+		return false;
+	}
+
+	static constexpr std::string_view NAMES[] = {
+		"models", "materials", "sound", "scripts", "maps", "resource", "props", "weapons",
+		"characters", "vehicles", "ui", "effects", "common", "dev", "titans", "pilots",
+	};
+	static constexpr std::string_view EXTENSIONS[] = {
+		"mdl", "vtx", "vvd", "phy", "vmt", "vtf", "nut", "txt", "cfg", "rson", "bsp_lump", "ani",
+	};
+	// Files per directory on average, and how many of the newest directories a new one is likely to nest in
+	constexpr std::uint64_t FILES_PER_DIRECTORY = 32;
+	constexpr std::size_t RECENT_DIRECTORIES = 16;
+	// Lognormal shape, large enough that a few files are hundreds of times the mean
+	constexpr double SIZE_SIGMA = 1.5;
+
+	std::uint64_t rng = options.seed;
+
+	// Directories mostly nest in recently added ones, which grows a few deep branches next to many shallow ones
+	std::vector<std::string> directories;
+	std::vector<std::uint32_t> depths;
+	const auto directoryCount = std::max<std::uint64_t>(options.entryCount / FILES_PER_DIRECTORY, 1);
+	directories.reserve(static_cast<std::size_t>(directoryCount));
+	depths.reserve(static_cast<std::size_t>(directoryCount));
+	for (std::uint64_t i = 0; i < directoryCount; i++) {
+		auto name = std::string{NAMES[splitmix64(rng) % std::size(NAMES)]} + '_' + std::to_string(i);
+		if (!directories.empty() && splitmix64(rng) % 4 != 0) {
+			const auto recent = std::min(directories.size(), RECENT_DIRECTORIES);
+			const auto parent = directories.size() - 1 - static_cast<std::size_t>(splitmix64(rng) % recent);
+			if (depths[parent] < options.maxDirectoryDepth) {
+				directories.push_back(directories[parent] + '/' + name);
+				depths.push_back(depths[parent] + 1);
+				continue;
+			}
+		}
+		directories.push_back(std::move(name));
+		depths.push_back(1);
+	}
+
+	// What a file holds, duplicates copy it from an earlier file
+	struct Recipe {
+		std::string_view extension;
+		std::uint64_t size;
+		std::uint16_t preloadBytes;
+		SyntheticSource source;
+	};
+	std::vector<Recipe> recipes;
+	recipes.reserve(static_cast<std::size_t>(options.entryCount));
+
+	const double mu = std::log(static_cast<double>(options.meanFileSize)) - SIZE_SIGMA * SIZE_SIGMA / 2.0;
+	std::vector<DirEntry> entries;
+	entries.reserve(static_cast<std::size_t>(options.entryCount));
+	for (std::uint64_t i = 0; i < options.entryCount; i++) {
+		Recipe recipe;
+		if (!recipes.empty() && uniform01(rng) < options.duplicateRatio) {
+			recipe = recipes[static_cast<std::size_t>(splitmix64(rng) % recipes.size())];
+		} else {
+			const bool wav = uniform01(rng) < options.wavRatio;
+			recipe.extension = wav ? "wav" : EXTENSIONS[splitmix64(rng) % std::size(EXTENSIONS)];
+
+			// Box-Muller, std::lognormal_distribution is not guaranteed to give the same values everywhere
+			const double normal = std::sqrt(-2.0 * std::log(1.0 - uniform01(rng))) * std::cos(2.0 * 3.14159265358979323846 * uniform01(rng));
+			recipe.size = std::clamp<std::uint64_t>(static_cast<std::uint64_t>(std::exp(mu + SIZE_SIGMA * normal)), 1, options.maxFileSize);
+			if (wav) {
+				// Room for the RIFF header and at least one sample
+				recipe.size = std::max<std::uint64_t>(recipe.size, WAV_HEADER_SIZE + 4);
+			}
+
+			recipe.preloadBytes = 0;
+			if (!wav && recipe.size > 1 && options.maxPreloadBytes && uniform01(rng) < options.preloadRatio) {
+				const auto maxPreload = std::min<std::uint64_t>(options.maxPreloadBytes, recipe.size - 1);
+				recipe.preloadBytes = static_cast<std::uint16_t>(1 + splitmix64(rng) % maxPreload);
+			}
+			recipe.source.seed = splitmix64(rng);
+			recipe.source.compressible = !wav && uniform01(rng) < options.compressibleRatio;
+			recipes.push_back(recipe);
+		}
+
+		auto path = directories[static_cast<std::size_t>(splitmix64(rng) % directories.size())];
+		path.append(1, '/').append(NAMES[splitmix64(rng) % std::size(NAMES)]).append("_file_").append(std::to_string(i));
+		path.append(1, '.').append(recipe.extension);
+
+		auto e = makeDirEntry(ScannedFile{{}, std::move(path), recipe.size - recipe.preloadBytes}, packOptions, nullptr);
+		e.synthetic = recipe.source;
+		e.preloadBytes = recipe.preloadBytes;
+		e.preloadData.resize(recipe.preloadBytes);
+		fillSyntheticBytes(recipe.source, 0, e.preloadData);
+		entries.push_back(std::move(e));
+	}
+
+	// There are no files on disk an incremental pack could compare against
+	auto effectiveOptions = packOptions;
+	effectiveOptions.incremental = false;
+	return packEntries(entries, outputDirVpkPath, effectiveOptions, outError, outStats);
+}
+
 } // namespace respawn_vpk
@@ -7,31 +7,135 @@
 #include <string_view>
 #include <vector>
 
+namespace vpkpp {
+class PackFile;
+} // namespace vpkpp
+
 namespace respawn_vpk {
 
+// Order file data is laid out in across the archives (the dir tree itself is always sorted by extension)
+enum class PackPlacement : std::uint8_t {
+	// Same order as the dir tree: by extension, then directory, then file name
+	EXTENSION,
+	// By directory, then extension, then file name, so files that are loaded together sit next to each other
+	DIRECTORY,
+};
+
 struct PackOptions {
 	// Archive suffix index. Respawn mod/patch vpks commonly use 999
+	// With maxArchiveBytes the archives are numbered upward from here, so use 0 for `_000`, `_001`, ...
 	std::uint16_t archiveIndex = 999;
 
-	// Split each input file into parts of at most this many bytes (uncompressed)
+	// Start a new archive instead of growing the current one past this many bytes (0 = a single archive)
+	// New archives are started between files where possible; a single part larger than this gets an archive of its own
+	std::uint64_t maxArchiveBytes = 0;
+
+	// Order files are written to the archives in
+	PackPlacement placement = PackPlacement::EXTENSION;
+
+	// Paths (relative to the input directory) in the order the game or tool loads them
+	// Listed files are written first and in this order, the rest follow in placement order
+	std::vector<std::string> loadOrder;
+
+	// Split each input file into parts of at most this many bytes (uncompressed), at least 64
+	// Parts are also the unit of work, a large file is compressed by several threads at once
 	std::size_t maxPartSize = 1024 * 1024;
 
 	// Compress file parts >= threshold (bytes), excluding some file types
 	std::size_t compressionThreshold = 4096;
 
-	// Number of worker threads used while building entries from disk
+	// Number of worker threads used while reading and compressing parts (0 = one per hardware thread)
 	std::size_t threadCount = 0;
+
+	// Parts are read, compressed and written to the archive as a pipeline, this caps the memory held by parts
+	// that have been picked up but not written yet. A single part larger than this is still processed on its own
+	// A process-wide budget (respawn_vpk::memory::setBudget) can hold parts back further
+	std::uint64_t maxInflightBytes = 512ull * 1024 * 1024;
+
+	// Directory of an on-disk cache of compressed parts, reused across runs and shared between processes
+	// Unchanged parts are then read back instead of recompressed. Entries go in a `rvpk-cc-v1` subdirectory. Empty = no cache
+	std::string compressionCacheDir;
+
+	// Size limit of the compression cache, least recently used parts are evicted once packing finishes
+	std::uint64_t compressionCacheMaxBytes = 4ull * 1024 * 1024 * 1024;
+
+	// If the output dir VPK already exists, copy the stored parts of files that did not change (same path, size and
+	// CRC) from its archives instead of compressing them again. The new files replace the old ones only once complete
+	bool incremental = false;
+};
+
+struct PackStats {
+	// Compressible parts whose compressed form came from the compression cache, and those that had to be compressed
+	std::uint64_t compressionCacheHits = 0;
+	std::uint64_t compressionCacheMisses = 0;
+	// Incremental packs: files copied from the previous pack, and the stored bytes that were copied for them
+	std::uint64_t incrementalReusedEntries = 0;
+	std::uint64_t incrementalReusedBytes = 0;
+	// Pack file sources: entries whose stored parts were copied from a Respawn source as they are, and their bytes
+	std::uint64_t sourceCopiedEntries = 0;
+	std::uint64_t sourceCopiedBytes = 0;
 };
 
 // Packs a directory into a Respawn VPK:
 // - Writes `outputDirVpkPath` (must end with `_dir.vpk`)
-// - Writes archive vpk next to it with `_XYZ.vpk` where XYZ = options.archiveIndex
-// - Writes optional `.cam` file next to the archive vpk (if any .wav were added)
+// - Writes archive vpks next to it with `_XYZ.vpk` where XYZ = options.archiveIndex (and up, see maxArchiveBytes)
+// - Writes optional `.cam` files next to the archive vpks that hold .wav data
 [[nodiscard]] bool packDirectoryToRespawnVPK(
 	const std::string& inputDir,
 	const std::string& outputDirVpkPath,
 	const PackOptions& options = {},
-	std::string* outError = nullptr);
+	std::string* outError = nullptr,
+	PackStats* outStats = nullptr);
+
+// Packs the entries of an open pack file (Valve VPK, ZIP, another Respawn VPK, ...) into a Respawn VPK, writing the
+// same files as packDirectoryToRespawnVPK without extracting anything to disk first
+// Entries of a Respawn source whose stored parts already match what would be written (same part layout and compression
+// choice) are copied without being decompressed; paths in options.loadOrder are relative to the source's root
+[[nodiscard]] bool packPackFileToRespawnVPK(
+	const vpkpp::PackFile& source,
+	const std::string& outputDirVpkPath,
+	const PackOptions& options = {},
+	std::string* outError = nullptr,
+	PackStats* outStats = nullptr);
+
+// Archive of a Respawn source that packing it to outputDirVpkPath would overwrite or delete, empty if there is none
+// Archive names drop the language prefix, so e.g. `englishclient_X_dir.vpk` and `frenchclient_X_dir.vpk` share them
+// Packing a source over itself incrementally is not a collision, the old archives stay until the new ones are complete
+[[nodiscard]] std::string findCollidingSourceArchive(
+	const vpkpp::PackFile& source,
+	const std::string& outputDirVpkPath,
+	const PackOptions& options = {});
+
+struct SyntheticPackOptions {
+	// Everything is derived from the seed: the same seed and options always generate the same pack
+	std::uint64_t seed = 1;
+	std::uint64_t entryCount = 10000;
+	// Directories nest up to this many levels deep, about 32 files share a directory
+	std::uint32_t maxDirectoryDepth = 8;
+	// File sizes follow a lognormal distribution (many small files, a long tail of large ones) with this mean, clamped
+	// to maxFileSize. Files larger than PackOptions::maxPartSize are split into several parts as usual
+	std::uint64_t meanFileSize = 16 * 1024;
+	std::uint64_t maxFileSize = 64ull * 1024 * 1024;
+	// Fraction of files with text-like data that compresses, the rest get random bytes that do not
+	double compressibleRatio = 0.7;
+	// Fraction of files that repeat the contents of an earlier file, so dedup has something to find
+	double duplicateRatio = 0.05;
+	// Fraction of files that are .wav sounds (with a RIFF header), which get .cam records
+	double wavRatio = 0.02;
+	// Fraction of files that keep up to maxPreloadBytes of their data inline in the dir tree
+	double preloadRatio = 0.05;
+	std::uint16_t maxPreloadBytes = 1024;
+};
+
+// Writes a Respawn VPK with made-up contents, for tests and benchmarks that can't ship game files
+// The entries go through the same pipeline as packDirectoryToRespawnVPK, so packOptions control the archive layout
+// (archive index, maxArchiveBytes, placement, part size), compression and threads; incremental is ignored
+[[nodiscard]] bool generateSyntheticRespawnVPK(
+	const std::string& outputDirVpkPath,
+	const SyntheticPackOptions& options,
+	const PackOptions& packOptions = {},
+	std::string* outError = nullptr,
+	PackStats* outStats = nullptr);
 
 // helper for repacking:
 // Respawn archives are commonly named like `...pak000_000.vpk` while the dir vpk is `...pak000_dir.vpk`
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace respawn_vpk {
+
+// Resolve a requested worker count (0 = one per hardware thread), never more than there is work for
+[[nodiscard]] inline std::size_t resolveThreadCount(std::size_t requested, std::size_t workItems) {
+	std::size_t threadCount = requested;
+	if (threadCount == 0) {
+		threadCount = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+	}
+	return std::max<std::size_t>(1, std::min<std::size_t>(threadCount, std::max<std::size_t>(1, workItems)));
+}
+
+// Run fn(i) for every i in [0, count) on up to threadCount workers
+// Stops handing out work after the first failure; returns false and fills outError if fn returned false or threw
+// fn must write its own error message through the provided string when it returns false
+template<typename Fn>
+[[nodiscard]] bool parallelFor(std::size_t count, std::size_t threadCount, Fn&& fn, std::string* outError = nullptr) {
+	std::atomic_size_t nextIndex{0};
+	std::atomic_bool failed{false};
+	std::mutex errMutex;
+	std::string firstError;
+
+	auto fail = [&](std::string err) {
+		{
+			std::scoped_lock lock(errMutex);
+			if (firstError.empty()) {
+				firstError = std::move(err);
+			}
+		}
+		failed.store(true, std::memory_order_relaxed);
+	};
+
+	auto workerFn = [&] {
+		for (;;) {
+			if (failed.load(std::memory_order_relaxed)) {
+				break;
+			}
+			const auto i = nextIndex.fetch_add(1, std::memory_order_relaxed);
+			if (i >= count) {
+				break;
+			}
+			try {
+				std::string err;
+				if (!fn(i, err)) {
+					fail(std::move(err));
+					break;
+				}
+			} catch (const std::exception& e) {
+				fail(e.what());
+				break;
+			} catch (...) {
+				fail("unknown exception in worker thread");
+				break;
+			}
+		}
+	};
+
+	threadCount = resolveThreadCount(threadCount, count);
+	if (threadCount == 1) {
+		workerFn();
+	} else {
+		std::vector<std::thread> workers;
+		workers.reserve(threadCount);
+		for (std::size_t i = 0; i < threadCount; i++) {
+			workers.emplace_back(workerFn);
+		}
+		for (auto& t : workers) {
+			t.join();
+		}
+	}
+
+	if (failed.load(std::memory_order_relaxed)) {
+		if (outError) {
+			*outError = firstError;
+		}
+		return false;
+	}
+	return true;
+}
+
+// Sort [first, last) on up to threadCount workers (0 = one per hardware thread)
+// Chunks are sorted independently and then merged pairwise, small ranges are sorted on the calling thread
+// comp must not throw; use a total order if the result has to be independent of the thread count
+template<typename It, typename Compare>
+void parallelSort(It first, It last, Compare comp, std::size_t threadCount = 0) {
+	constexpr std::size_t MIN_ITEMS_PER_THREAD = 32 * 1024;
+
+	const auto count = static_cast<std::size_t>(last - first);
+	threadCount = resolveThreadCount(threadCount, count / MIN_ITEMS_PER_THREAD);
+	if (threadCount == 1) {
+		std::sort(first, last, comp);
+		return;
+	}
+
+	std::vector<std::size_t> bounds(threadCount + 1);
+	for (std::size_t i = 0; i <= threadCount; i++) {
+		bounds[i] = count * i / threadCount;
+	}
+
+	std::vector<std::thread> workers;
+	workers.reserve(threadCount);
+	for (std::size_t i = 0; i < threadCount; i++) {
+		workers.emplace_back([&, i] {
+			std::sort(first + bounds[i], first + bounds[i + 1], comp);
+		});
+	}
+	for (auto& t : workers) {
+		t.join();
+	}
+
+	for (std::size_t width = 1; width < threadCount; width *= 2) {
+		workers.clear();
+		for (std::size_t i = 0; i + width < threadCount; i += 2 * width) {
+			const auto lo = bounds[i];
+			const auto mid = bounds[i + width];
+			const auto hi = bounds[std::min(i + 2 * width, threadCount)];
+			workers.emplace_back([=, &comp] {
+				std::inplace_merge(first + lo, first + mid, first + hi, comp);
+			});
+		}
+		for (auto& t : workers) {
+			t.join();
+		}
+	}
+}
+
+} // namespace respawn_vpk
@@ -0,0 +1,229 @@
+#include "RespawnVPKScan.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "RespawnVPKTrace.h"
+
+namespace respawn_vpk {
+
+namespace {
+
+// A scan mostly waits on the file system, so even machines with few cores benefit from several requests in flight
+constexpr std::size_t MIN_DEFAULT_SCAN_THREADS = 8;
+
+struct PendingDirectory {
+	std::filesystem::path path;
+	// Empty for the root
+	std::string relativePath;
+};
+
+[[nodiscard]] std::string joinRelativePath(const std::string& dir, std::string_view name) {
+	if (dir.empty()) {
+		return std::string{name};
+	}
+	std::string out;
+	out.reserve(dir.size() + 1 + name.size());
+	out.append(dir).append(1, '/').append(name);
+	return out;
+}
+
+#if defined(__linux__) && defined(STATX_SIZE)
+
+// Layout of the records returned by getdents64: u64 inode, s64 offset, u16 record length, u8 type, then the name
+constexpr std::size_t DIRENT64_RECLEN_OFFSET = 16;
+constexpr std::size_t DIRENT64_TYPE_OFFSET = 18;
+constexpr std::size_t DIRENT64_NAME_OFFSET = 19;
+constexpr std::size_t DIRENT64_BUFFER_SIZE = 64 * 1024;
+
+// Closes the directory on every return path
+struct DirectoryFd {
+	int fd;
+	~DirectoryFd() {
+		if (this->fd >= 0) {
+			::close(this->fd);
+		}
+	}
+};
+
+// Stat a directory entry relative to its open directory; AT_STATX_DONT_SYNC lets network file systems answer from cache
+[[nodiscard]] bool statEntry(int dirFd, const char* name, bool followSymlink, struct statx& out) {
+	const int flags = AT_STATX_DONT_SYNC | (followSymlink ? 0 : AT_SYMLINK_NOFOLLOW);
+	return ::statx(dirFd, name, flags, STATX_TYPE | STATX_SIZE, &out) == 0;
+}
+
+void listDirectory(const PendingDirectory& dir, std::vector<PendingDirectory>& outDirs, std::vector<ScannedFile>& outFiles, std::vector<char>& buffer) {
+	RESPAWN_VPK_TRACE_SCOPE("scan.listDirectory");
+	const DirectoryFd dirFd{::open(dir.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+	if (dirFd.fd < 0) {
+		return;
+	}
+	buffer.resize(DIRENT64_BUFFER_SIZE);
+
+	auto addFile = [&](std::string_view name, std::uint64_t size) {
+		outFiles.push_back({dir.path / name, joinRelativePath(dir.relativePath, name), size});
+	};
+	auto addDirectory = [&](std::string_view name) {
+		outDirs.push_back({dir.path / name, joinRelativePath(dir.relativePath, name)});
+	};
+
+	for (;;) {
+		const auto bytesRead = ::syscall(SYS_getdents64, dirFd.fd, buffer.data(), buffer.size());
+		if (bytesRead <= 0) {
+			break;
+		}
+		for (long offset = 0; offset < bytesRead; ) {
+			const char* record = buffer.data() + offset;
+			std::uint16_t recordLength = 0;
+			std::memcpy(&recordLength, record + DIRENT64_RECLEN_OFFSET, sizeof(recordLength));
+			const auto type = static_cast<unsigned char>(record[DIRENT64_TYPE_OFFSET]);
+			const char* name = record + DIRENT64_NAME_OFFSET;
+			offset += recordLength;
+
+			const std::string_view nameView{name};
+			if (nameView == "." || nameView == "..") {
+				continue;
+			}
+
+			struct statx stx{};
+			switch (type) {
+				case DT_DIR:
+					addDirectory(nameView);
+					break;
+				case DT_REG:
+					if (statEntry(dirFd.fd, name, false, stx)) {
+						addFile(nameView, stx.stx_size);
+					}
+					break;
+				case DT_LNK:
+					// Symlinked files are listed, symlinked directories are not followed
+					if (statEntry(dirFd.fd, name, true, stx) && S_ISREG(stx.stx_mode)) {
+						addFile(nameView, stx.stx_size);
+					}
+					break;
+				case DT_UNKNOWN:
+					// Some file systems do not report types in the listing
+					if (!statEntry(dirFd.fd, name, false, stx)) {
+						break;
+					}
+					if (S_ISDIR(stx.stx_mode)) {
+						addDirectory(nameView);
+					} else if (S_ISREG(stx.stx_mode)) {
+						addFile(nameView, stx.stx_size);
+					} else if (S_ISLNK(stx.stx_mode) && statEntry(dirFd.fd, name, true, stx) && S_ISREG(stx.stx_mode)) {
+						addFile(nameView, stx.stx_size);
+					}
+					break;
+				default:
+					break;
+			}
+		}
+	}
+}
+
+#else
+
+// directory_entry caches what the listing returned (on Windows that includes the size), so this is still one pass
+void listDirectory(const PendingDirectory& dir, std::vector<PendingDirectory>& outDirs, std::vector<ScannedFile>& outFiles, std::vector<char>&) {
+	RESPAWN_VPK_TRACE_SCOPE("scan.listDirectory");
+	std::error_code ec;
+	for (std::filesystem::directory_iterator it{dir.path, std::filesystem::directory_options::skip_permission_denied, ec};
+	     !ec && it != std::filesystem::directory_iterator{}; it.increment(ec)) {
+		std::error_code entryEc;
+		const auto name = it->path().filename().string();
+		if (it->is_directory(entryEc) && !it->is_symlink(entryEc)) {
+			outDirs.push_back({it->path(), joinRelativePath(dir.relativePath, name)});
+		} else if (it->is_regular_file(entryEc)) {
+			const auto size = it->file_size(entryEc);
+			if (!entryEc) {
+				outFiles.push_back({it->path(), joinRelativePath(dir.relativePath, name), size});
+			}
+		}
+	}
+}
+
+#endif
+
+} // namespace
+
+std::vector<ScannedFile> scanDirectory(const std::filesystem::path& root, std::size_t threadCount) {
+	RESPAWN_VPK_TRACE_SCOPE("scan");
+	if (threadCount == 0) {
+		threadCount = std::max<std::size_t>(MIN_DEFAULT_SCAN_THREADS, std::thread::hardware_concurrency());
+	}
+
+	// Workers take a directory, list it without holding the lock, then queue its subdirectories
+	// The scan is done once nothing is queued and no worker is still listing (and so could queue more)
+	std::mutex queueMutex;
+	std::condition_variable queueChanged;
+	std::vector<PendingDirectory> pending{{root, {}}};
+	std::size_t busyWorkers = 0;
+	std::vector<std::vector<ScannedFile>> filesPerWorker(threadCount);
+
+	auto workerFn = [&](std::size_t worker) {
+		std::vector<PendingDirectory> found;
+		std::vector<char> buffer;
+		std::unique_lock lock{queueMutex};
+		for (;;) {
+			queueChanged.wait(lock, [&] { return !pending.empty() || busyWorkers == 0; });
+			if (pending.empty()) {
+				break;
+			}
+			// Depth first keeps the queue short
+			const auto dir = std::move(pending.back());
+			pending.pop_back();
+			busyWorkers++;
+			lock.unlock();
+
+			found.clear();
+			listDirectory(dir, found, filesPerWorker[worker], buffer);
+
+			lock.lock();
+			busyWorkers--;
+			for (auto& subdir : found) {
+				pending.push_back(std::move(subdir));
+			}
+			if (!found.empty() || busyWorkers == 0) {
+				queueChanged.notify_all();
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(threadCount - 1);
+	for (std::size_t i = 1; i < threadCount; i++) {
+		workers.emplace_back(workerFn, i);
+	}
+	workerFn(0);
+	for (auto& t : workers) {
+		t.join();
+	}
+
+	std::size_t total = 0;
+	for (const auto& files : filesPerWorker) {
+		total += files.size();
+	}
+	std::vector<ScannedFile> out;
+	out.reserve(total);
+	for (auto& files : filesPerWorker) {
+		std::move(files.begin(), files.end(), std::back_inserter(out));
+	}
+	return out;
+}
+
+} // namespace respawn_vpk
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace respawn_vpk {
+
+struct ScannedFile {
+	// Full path of the file (the scanned root joined with relativePath)
+	std::filesystem::path path;
+	// Relative to the scanned root, always with '/' separators
+	std::string relativePath;
+	std::uint64_t size = 0;
+};
+
+// Recursively list the regular files under root, with their sizes, in one pass
+// Directories are handed out to up to threadCount workers (0 = pick a default suited to slow file systems), since on
+// network drives the scan waits on round trips far more than on the CPU. On Linux each directory is read with
+// getdents64 and its files are stat'ed relative to the open directory with statx, without forcing a sync
+// Like recursive_directory_iterator with skip_permission_denied: unreadable directories are skipped and directory
+// symlinks are not followed, file symlinks are listed as the file they point to
+// The order of the result is unspecified
+[[nodiscard]] std::vector<ScannedFile> scanDirectory(const std::filesystem::path& root, std::size_t threadCount = 0);
+
+} // namespace respawn_vpk
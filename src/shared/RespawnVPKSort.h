@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "RespawnVPKParallel.h"
+#include "RespawnVPKTrace.h"
+
+namespace respawn_vpk {
+
+// Sort items into dir tree order (extension, then directory, then file name)
+// appendKey(key, item) appends the item's packed key to key: "ext\0dir\0stem\0", names never contain NUL,
+// so comparing packed keys bytewise is the same as comparing the three fields in turn
+// All keys share one buffer and only small (offset, length, index) records are sorted, the items are moved once
+// Ties keep their input order, so the result does not depend on threadCount
+template<typename T, typename AppendKey>
+void sortByPackedKey(std::vector<T>& items, AppendKey&& appendKey, std::size_t threadCount = 0) {
+	RESPAWN_VPK_TRACE_SCOPE("sort");
+	struct KeyRef {
+		std::size_t offset;
+		std::uint32_t length;
+		std::uint32_t index;
+	};
+
+	std::string keyBuffer;
+	keyBuffer.reserve(items.size() * 32);
+	std::vector<KeyRef> keys;
+	keys.reserve(items.size());
+	for (std::size_t i = 0; i < items.size(); i++) {
+		const auto offset = keyBuffer.size();
+		appendKey(keyBuffer, items[i]);
+		keys.push_back({offset, static_cast<std::uint32_t>(keyBuffer.size() - offset), static_cast<std::uint32_t>(i)});
+	}
+
+	const char* base = keyBuffer.data();
+	parallelSort(keys.begin(), keys.end(), [base](const KeyRef& a, const KeyRef& b) {
+		const std::string_view ka{base + a.offset, a.length};
+		const std::string_view kb{base + b.offset, b.length};
+		if (const auto c = ka.compare(kb); c != 0) {
+			return c < 0;
+		}
+		return a.index < b.index;
+	}, threadCount);
+
+	std::vector<T> sorted;
+	sorted.reserve(items.size());
+	for (const auto& k : keys) {
+		sorted.push_back(std::move(items[k.index]));
+	}
+	items = std::move(sorted);
+}
+
+} // namespace respawn_vpk
@@ -0,0 +1,142 @@
+#include "RespawnVPKStats.h"
+
+#include <cstdio>
+#include <string_view>
+
+namespace respawn_vpk::stats {
+
+namespace {
+
+[[nodiscard]] std::uint64_t load(const std::atomic_uint64_t& counter) {
+	return counter.load(std::memory_order_relaxed);
+}
+
+[[nodiscard]] std::string formatBytes(std::uint64_t bytes) {
+	static constexpr const char* UNITS[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+	auto value = static_cast<double>(bytes);
+	std::size_t unit = 0;
+	while (value >= 1024.0 && unit + 1 < std::size(UNITS)) {
+		value /= 1024.0;
+		unit++;
+	}
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), unit == 0 ? "%.0f %s" : "%.2f %s", value, UNITS[unit]);
+	return buf;
+}
+
+[[nodiscard]] std::string formatSeconds(std::uint64_t ns) {
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%.3f s", static_cast<double>(ns) / 1e9);
+	return buf;
+}
+
+[[nodiscard]] std::string formatRatio(std::uint64_t part, std::uint64_t whole) {
+	if (!whole) {
+		return "-";
+	}
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%.1f%%", 100.0 * static_cast<double>(part) / static_cast<double>(whole));
+	return buf;
+}
+
+} // namespace
+
+Counters& get() {
+	static Counters counters;
+	return counters;
+}
+
+Snapshot snapshot() {
+	const auto& c = get();
+	Snapshot s;
+	s.bytesRead = load(c.bytesRead);
+	s.bytesWritten = load(c.bytesWritten);
+	s.ioCalls = load(c.ioCalls);
+	for (std::size_t i = 0; i < c.archiveBytesRead.size(); i++) {
+		if (const auto bytes = load(c.archiveBytesRead[i])) {
+			s.archiveBytesRead.emplace_back(static_cast<std::uint16_t>(i), bytes);
+		}
+	}
+	s.partsCompressed = load(c.partsCompressed);
+	s.compressInputBytes = load(c.compressInputBytes);
+	s.compressOutputBytes = load(c.compressOutputBytes);
+	s.compressNs = load(c.compressNs);
+	s.partsDecompressed = load(c.partsDecompressed);
+	s.decompressInputBytes = load(c.decompressInputBytes);
+	s.decompressOutputBytes = load(c.decompressOutputBytes);
+	s.decompressNs = load(c.decompressNs);
+	s.compressionCacheHits = load(c.compressionCacheHits);
+	s.compressionCacheMisses = load(c.compressionCacheMisses);
+	s.manifestCacheHits = load(c.manifestCacheHits);
+	s.manifestCacheMisses = load(c.manifestCacheMisses);
+	s.dedupHits = load(c.dedupHits);
+	s.dedupBytesSaved = load(c.dedupBytesSaved);
+	s.memoryPeaks = memory::getPeaks();
+	s.memoryBudget = memory::getBudget();
+	return s;
+}
+
+void reset() {
+	auto& c = get();
+	for (auto* counter : {
+		&c.bytesRead, &c.bytesWritten, &c.ioCalls,
+		&c.partsCompressed, &c.compressInputBytes, &c.compressOutputBytes, &c.compressNs,
+		&c.partsDecompressed, &c.decompressInputBytes, &c.decompressOutputBytes, &c.decompressNs,
+		&c.compressionCacheHits, &c.compressionCacheMisses, &c.manifestCacheHits, &c.manifestCacheMisses,
+		&c.dedupHits, &c.dedupBytesSaved,
+	}) {
+		counter->store(0, std::memory_order_relaxed);
+	}
+	for (auto& counter : c.archiveBytesRead) {
+		counter.store(0, std::memory_order_relaxed);
+	}
+	memory::resetPeaks();
+}
+
+std::string formatReport(const Snapshot& s) {
+	std::string out;
+	auto line = [&out](std::string_view label, const std::string& value) {
+		out.append(label).append(value).append(1, '\n');
+	};
+
+	line("I/O:               ", formatBytes(s.bytesRead) + " read, " + formatBytes(s.bytesWritten) + " written, "
+		+ std::to_string(s.ioCalls) + " calls");
+	if (!s.archiveBytesRead.empty()) {
+		std::string archives;
+		char name[16];
+		for (const auto& [index, bytes] : s.archiveBytesRead) {
+			if (index == DIR_VPK_INDEX) {
+				std::snprintf(name, sizeof(name), "dir");
+			} else {
+				std::snprintf(name, sizeof(name), "%03u", static_cast<unsigned>(index));
+			}
+			archives.append(archives.empty() ? "" : ", ").append(name).append(": ").append(formatBytes(bytes));
+		}
+		line("Read per archive:  ", archives);
+	}
+	// LZHAM times are summed over all threads, so they can exceed the wall clock time
+	line("LZHAM compress:    ", std::to_string(s.partsCompressed) + " parts, " + formatBytes(s.compressInputBytes) + " -> "
+		+ formatBytes(s.compressOutputBytes) + " (" + formatRatio(s.compressOutputBytes, s.compressInputBytes) + "), "
+		+ formatSeconds(s.compressNs) + " thread time");
+	line("LZHAM decompress:  ", std::to_string(s.partsDecompressed) + " parts, " + formatBytes(s.decompressInputBytes) + " -> "
+		+ formatBytes(s.decompressOutputBytes) + ", " + formatSeconds(s.decompressNs) + " thread time");
+	line("Compression cache: ", std::to_string(s.compressionCacheHits) + " hits, " + std::to_string(s.compressionCacheMisses)
+		+ " misses (" + formatRatio(s.compressionCacheHits, s.compressionCacheHits + s.compressionCacheMisses) + " hit rate)");
+	line("Manifest cache:    ", std::to_string(s.manifestCacheHits) + " hits, " + std::to_string(s.manifestCacheMisses) + " misses");
+	line("Dedup:             ", std::to_string(s.dedupHits) + " hits, " + formatBytes(s.dedupBytesSaved) + " not written");
+
+	std::string memoryPeaks = formatBytes(s.memoryPeaks.charged) + " charged";
+	for (std::size_t i = 0; i < memory::OPERATION_COUNT; i++) {
+		if (s.memoryPeaks.operations[i]) {
+			memoryPeaks.append(", ").append(memory::getOperationName(static_cast<memory::Operation>(i))).append(": ").append(formatBytes(s.memoryPeaks.operations[i]));
+		}
+	}
+	if (s.memoryPeaks.processRss) {
+		memoryPeaks.append(", process RSS ").append(formatBytes(s.memoryPeaks.processRss));
+	}
+	line("Memory peak:       ", memoryPeaks);
+	line("Memory budget:     ", s.memoryBudget ? formatBytes(s.memoryBudget) : std::string{"none"});
+	return out;
+}
+
+} // namespace respawn_vpk::stats
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "RespawnVPKMemory.h"
+
+// Process-wide counters for the Respawn VPK read and write paths, always on
+// Every update is a relaxed atomic add, so they are cheap enough to leave in hot loops; they are meant for tuning
+// thread counts and cache sizes, not for exact accounting while operations are still running
+
+namespace respawn_vpk::stats {
+
+// Archive indices are 0 to 999, the dir VPK's own data (preload bytes) is counted under DIR_VPK_INDEX
+constexpr std::size_t DIR_VPK_INDEX = 1000;
+
+struct Counters {
+	// Data read from and written to disk, and the file opens, seeks, reads and writes it took
+	std::atomic_uint64_t bytesRead{0};
+	std::atomic_uint64_t bytesWritten{0};
+	std::atomic_uint64_t ioCalls{0};
+	std::array<std::atomic_uint64_t, DIR_VPK_INDEX + 1> archiveBytesRead{};
+
+	std::atomic_uint64_t partsCompressed{0};
+	std::atomic_uint64_t compressInputBytes{0};
+	std::atomic_uint64_t compressOutputBytes{0};
+	std::atomic_uint64_t compressNs{0};
+
+	std::atomic_uint64_t partsDecompressed{0};
+	std::atomic_uint64_t decompressInputBytes{0};
+	std::atomic_uint64_t decompressOutputBytes{0};
+	std::atomic_uint64_t decompressNs{0};
+
+	std::atomic_uint64_t compressionCacheHits{0};
+	std::atomic_uint64_t compressionCacheMisses{0};
+	std::atomic_uint64_t manifestCacheHits{0};
+	std::atomic_uint64_t manifestCacheMisses{0};
+
+	// Parts (or whole entries, when a bake reuses data that is already stored) that were not written again
+	std::atomic_uint64_t dedupHits{0};
+	std::atomic_uint64_t dedupBytesSaved{0};
+};
+
+[[nodiscard]] Counters& get();
+
+inline void add(std::atomic_uint64_t& counter, std::uint64_t value = 1) {
+	counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+inline void addRead(std::uint64_t bytes, std::uint64_t calls = 1) {
+	auto& counters = get();
+	add(counters.bytesRead, bytes);
+	add(counters.ioCalls, calls);
+}
+
+inline void addWrite(std::uint64_t bytes, std::uint64_t calls = 1) {
+	auto& counters = get();
+	add(counters.bytesWritten, bytes);
+	add(counters.ioCalls, calls);
+}
+
+// On top of addRead, for data that came out of a VPK archive
+inline void addArchiveRead(std::size_t archiveIndex, std::uint64_t bytes) {
+	auto& counters = get();
+	add(counters.archiveBytesRead[archiveIndex < DIR_VPK_INDEX ? archiveIndex : DIR_VPK_INDEX], bytes);
+}
+
+// Adds the time from construction to destruction to a nanosecond counter
+class Timer {
+public:
+	explicit Timer(std::atomic_uint64_t& counter)
+			: counter(counter)
+			, start(std::chrono::steady_clock::now()) {}
+
+	~Timer() {
+		add(this->counter, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start).count()));
+	}
+
+	Timer(const Timer&) = delete;
+	Timer& operator=(const Timer&) = delete;
+
+private:
+	std::atomic_uint64_t& counter;
+	std::chrono::steady_clock::time_point start;
+};
+
+// Plain copy of the counters at one point in time
+struct Snapshot {
+	std::uint64_t bytesRead = 0;
+	std::uint64_t bytesWritten = 0;
+	std::uint64_t ioCalls = 0;
+	// (archive index or DIR_VPK_INDEX, bytes), only archives that were read from
+	std::vector<std::pair<std::uint16_t, std::uint64_t>> archiveBytesRead;
+
+	std::uint64_t partsCompressed = 0;
+	std::uint64_t compressInputBytes = 0;
+	std::uint64_t compressOutputBytes = 0;
+	std::uint64_t compressNs = 0;
+
+	std::uint64_t partsDecompressed = 0;
+	std::uint64_t decompressInputBytes = 0;
+	std::uint64_t decompressOutputBytes = 0;
+	std::uint64_t decompressNs = 0;
+
+	std::uint64_t compressionCacheHits = 0;
+	std::uint64_t compressionCacheMisses = 0;
+	std::uint64_t manifestCacheHits = 0;
+	std::uint64_t manifestCacheMisses = 0;
+
+	std::uint64_t dedupHits = 0;
+	std::uint64_t dedupBytesSaved = 0;
+
+	memory::Peaks memoryPeaks;
+	std::uint64_t memoryBudget = 0;
+};
+
+[[nodiscard]] Snapshot snapshot();
+
+// Also restarts the memory peaks, the process peak RSS cannot be reset
+void reset();
+
+// Multi-line human readable summary, as printed by the CLI's --stats and shown in the GUI
+[[nodiscard]] std::string formatReport(const Snapshot& s);
+
+} // namespace respawn_vpk::stats
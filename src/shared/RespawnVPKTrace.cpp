@@ -0,0 +1,207 @@
+#include "RespawnVPKTrace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace respawn_vpk::trace {
+
+#ifdef VPKEDIT_HAVE_TRACING
+
+namespace {
+
+struct Event {
+	const char* name;
+	std::int64_t startNs;
+	std::int64_t durationNs;
+};
+
+// Only its own thread appends, the lock is contended only while a session starts or stops
+struct ThreadBuffer {
+	std::mutex mutex;
+	std::vector<Event> events;
+	std::uint32_t threadId = 0;
+	// Set once the thread exited; the buffer is kept until the next session starts so its events still get written
+	bool retired = false;
+};
+
+struct Registry {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+	std::uint32_t nextThreadId = 1;
+	std::uint32_t startThreadId = 0;
+	std::int64_t sessionStartNs = 0;
+};
+
+std::atomic_bool active{false};
+
+[[nodiscard]] Registry& getRegistry() {
+	static Registry registry;
+	return registry;
+}
+
+struct ThreadBufferHandle {
+	ThreadBuffer* buffer = nullptr;
+
+	~ThreadBufferHandle() {
+		if (this->buffer) {
+			auto& registry = getRegistry();
+			std::scoped_lock lock{registry.mutex};
+			this->buffer->retired = true;
+		}
+	}
+};
+
+thread_local ThreadBufferHandle threadBuffer;
+
+[[nodiscard]] ThreadBuffer& getThreadBuffer() {
+	if (!threadBuffer.buffer) {
+		auto& registry = getRegistry();
+		std::scoped_lock lock{registry.mutex};
+		auto& buffer = registry.buffers.emplace_back(std::make_unique<ThreadBuffer>());
+		buffer->threadId = registry.nextThreadId++;
+		threadBuffer.buffer = buffer.get();
+	}
+	return *threadBuffer.buffer;
+}
+
+[[nodiscard]] std::int64_t nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void writeJsonString(std::ostream& out, std::string_view s) {
+	out << '"';
+	for (const char c : s) {
+		if (c == '"' || c == '\\') {
+			out << '\\';
+		}
+		out << c;
+	}
+	out << '"';
+}
+
+} // namespace
+
+Scope::Scope(const char* name)
+		: name(name)
+		, startNs(active.load(std::memory_order_relaxed) ? nowNs() : -1) {}
+
+Scope::~Scope() {
+	if (this->startNs < 0) {
+		return;
+	}
+	const auto endNs = nowNs();
+	auto& buffer = getThreadBuffer();
+	std::scoped_lock lock{buffer.mutex};
+	buffer.events.push_back({this->name, this->startNs, endNs - this->startNs});
+}
+
+bool start() {
+	auto& registry = getRegistry();
+	const auto startThreadId = getThreadBuffer().threadId;
+	std::scoped_lock lock{registry.mutex};
+	std::erase_if(registry.buffers, [](const std::unique_ptr<ThreadBuffer>& buffer) {
+		return buffer->retired;
+	});
+	for (const auto& buffer : registry.buffers) {
+		std::scoped_lock bufferLock{buffer->mutex};
+		buffer->events.clear();
+	}
+	registry.startThreadId = startThreadId;
+	registry.sessionStartNs = nowNs();
+	active.store(true, std::memory_order_relaxed);
+	return true;
+}
+
+bool stop(const std::string& outputPath, std::string* outError) {
+	active.store(false, std::memory_order_relaxed);
+
+	std::ofstream out{outputPath, std::ios::binary | std::ios::trunc};
+	if (!out) {
+		if (outError) {
+			*outError = "Failed to open trace output: " + outputPath;
+		}
+		return false;
+	}
+
+	// Complete ("X") events with microsecond timestamps relative to the session start, one track per thread
+	auto& registry = getRegistry();
+	std::scoped_lock lock{registry.mutex};
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << R"({"name":"process_name","ph":"M","pid":1,"tid":0,"args":{"name":"respawn_vpk"}})";
+	char number[32];
+	for (const auto& buffer : registry.buffers) {
+		std::scoped_lock bufferLock{buffer->mutex};
+		if (buffer->events.empty()) {
+			continue;
+		}
+		const auto threadName = buffer->threadId == registry.startThreadId ? std::string{"main"} : "worker " + std::to_string(buffer->threadId);
+		out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+		writeJsonString(out, threadName);
+		out << "}}";
+		for (const auto& event : buffer->events) {
+			// Scopes that were already open when the session started
+			if (event.startNs < registry.sessionStartNs) {
+				continue;
+			}
+			out << ",\n{\"name\":";
+			writeJsonString(out, event.name);
+			std::snprintf(number, sizeof(number), "%.3f", static_cast<double>(event.startNs - registry.sessionStartNs) / 1000.0);
+			out << ",\"cat\":\"respawn_vpk\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << number;
+			std::snprintf(number, sizeof(number), "%.3f", static_cast<double>(event.durationNs) / 1000.0);
+			out << ",\"dur\":" << number << '}';
+		}
+		buffer->events.clear();
+	}
+	out << "\n]}\n";
+
+	if (!out.flush()) {
+		if (outError) {
+			*outError = "Failed to write trace output: " + outputPath;
+		}
+		return false;
+	}
+	return true;
+}
+
+void cancel() {
+	active.store(false, std::memory_order_relaxed);
+	auto& registry = getRegistry();
+	std::scoped_lock lock{registry.mutex};
+	for (const auto& buffer : registry.buffers) {
+		std::scoped_lock bufferLock{buffer->mutex};
+		buffer->events.clear();
+	}
+}
+
+bool isActive() {
+	return active.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool start() {
+	return false;
+}
+
+bool stop(const std::string& outputPath, std::string* outError) {
+	if (outError) {
+		*outError = "Tracing is not available in this build, cannot write " + outputPath;
+	}
+	return false;
+}
+
+void cancel() {}
+
+bool isActive() {
+	return false;
+}
+
+#endif
+
+} // namespace respawn_vpk::trace
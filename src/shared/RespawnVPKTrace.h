@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Scoped trace points for the Respawn VPK code, written out as a Chrome trace (chrome://tracing, ui.perfetto.dev)
+// Builds without VPKEDIT_HAVE_TRACING compile every trace point away; with it, a trace point costs one relaxed atomic
+// load until a session is started, then two clock reads and an append to a buffer owned by the calling thread
+//
+//   RESPAWN_VPK_TRACE_SCOPE("pack.encode");
+//
+// Names must be string literals (or otherwise outlive the session), they are stored as pointers
+
+namespace respawn_vpk::trace {
+
+// Start collecting events, dropping whatever an earlier session left behind
+// Returns false if tracing was compiled out
+bool start();
+
+// Stop collecting and write every thread's events to a Chrome trace JSON file
+[[nodiscard]] bool stop(const std::string& outputPath, std::string* outError = nullptr);
+
+// Stop collecting and drop the events
+void cancel();
+
+// True between start and stop
+[[nodiscard]] bool isActive();
+
+// True if this build has trace points at all
+[[nodiscard]] constexpr bool isAvailable() {
+#ifdef VPKEDIT_HAVE_TRACING
+	return true;
+#else
+	return false;
+#endif
+}
+
+#ifdef VPKEDIT_HAVE_TRACING
+
+// Records the time from construction to destruction as one event on the calling thread
+class Scope {
+public:
+	explicit Scope(const char* name);
+
+	~Scope();
+
+	Scope(const Scope&) = delete;
+	Scope& operator=(const Scope&) = delete;
+
+private:
+	const char* name;
+	// Negative when no session was active at construction
+	std::int64_t startNs;
+};
+
+#define RESPAWN_VPK_TRACE_CONCAT_INNER(a, b) a##b
+#define RESPAWN_VPK_TRACE_CONCAT(a, b) RESPAWN_VPK_TRACE_CONCAT_INNER(a, b)
+#define RESPAWN_VPK_TRACE_SCOPE(name) const ::respawn_vpk::trace::Scope RESPAWN_VPK_TRACE_CONCAT(respawnVpkTraceScope_, __LINE__){name}
+
+#else
+
+#define RESPAWN_VPK_TRACE_SCOPE(name) static_cast<void>(0)
+
+#endif
+
+} // namespace respawn_vpk::trace